@@ -213,6 +213,7 @@ void STKConfig::init_defaults()
     m_solver_iterations          = -100;
     m_solver_set_flags           = 0;
     m_solver_reset_flags         = 0;
+    m_broadphase                 = "axis-sweep";
     m_network_steering_reduction = -100;
     m_title_music                = NULL;
     m_default_music              = NULL;
@@ -325,6 +326,7 @@ void STKConfig::getAllData(const XMLNode * root)
         physics_node->get("solver-split-impulse",   &m_solver_split_impulse  );
         physics_node->get("solver-split-impulse-threshold",
                                                &m_solver_split_impulse_thresh);
+        physics_node->get("broadphase",             &m_broadphase            );
         std::vector<std::string> solver_modes;
         physics_node->get("solver-mode",            &solver_modes            );
         m_solver_set_flags=0, m_solver_reset_flags = 0;
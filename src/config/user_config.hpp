@@ -465,6 +465,12 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam          m_karts_powerup_gui
             PARAM_DEFAULT(  BoolUserConfigParam(false, "karts-powerup-gui",
             &m_race_setup_group, "Show other karts' held powerups in race gui.") );
+    PARAM_PREFIX IntUserConfigParam          m_kart_update_threads
+            PARAM_DEFAULT(  IntUserConfigParam(-1, "kart-update-threads",
+            &m_race_setup_group, "Number of additional threads used to "
+            "prepare the update of the karts in a race, -1 to use one less "
+            "than the number of cores, 0 to update in the main thread "
+            "only.") );
 
     // ---- Wiimote data
     PARAM_PREFIX GroupUserConfigParam        m_wiimote_group
@@ -705,6 +711,12 @@ namespace UserConfigParams
     /** If gamepad debugging is enabled. */
     PARAM_PREFIX bool m_unit_testing PARAM_DEFAULT(false);
 
+    /** If micro benchmarks should be run. */
+    PARAM_PREFIX bool m_micro_benchmark PARAM_DEFAULT(false);
+
+    /** If the time spent in each phase of the startup should be printed. */
+    PARAM_PREFIX bool m_benchmark_startup PARAM_DEFAULT(false);
+
     /** If gamepad debugging is enabled. */
     PARAM_PREFIX bool m_gamepad_debug PARAM_DEFAULT( false );
 
@@ -829,6 +841,11 @@ namespace UserConfigParams
         PARAM_DEFAULT(IntUserConfigParam(0, "default-ip-type",
         &m_network_group, "Default IP type of this machine, "
         "0 detect every time, 1 IPv4, 2 IPv6, 3 IPv6 NAT64, 4 Dual stack."));
+    PARAM_PREFIX BoolUserConfigParam m_partial_rewind
+        PARAM_DEFAULT(BoolUserConfigParam(false, "partial-rewind",
+        &m_network_group, "Only rewind karts and projectiles whose state "
+        "differs from the local prediction (and the ones close to them) when "
+        "a state is received from server."));
 
     // ---- Gamemode setup
     PARAM_PREFIX UIntToUIntUserConfigParam m_num_karts_per_gamemode
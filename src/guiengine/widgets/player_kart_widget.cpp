@@ -156,12 +156,12 @@ PlayerKartWidget::PlayerKartWidget(KartSelectionScreen* parent,
     const KartProperties* props =
         kart_properties_manager->getKart(default_kart);
 
-    if(!props)
+    if(!props || !props->loadModels())
     {
         // If the default kart can't be found (e.g. previously a addon
-        // kart was used, but the addon package was removed), use the
-        // first kart as a default. This way we don't have to hardcode
-        // any kart names.
+        // kart was used, but the addon package was removed) or its model
+        // can't be loaded, use the first kart as a default. This way we
+        // don't have to hardcode any kart names.
         int id = kart_properties_manager->getKartByGroup(kart_group, 0);
         if (id == -1)
         {
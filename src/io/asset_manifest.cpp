@@ -0,0 +1,403 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "io/asset_manifest.hpp"
+
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <IFileList.h>
+#include <IFileSystem.h>
+
+#include <cstring>
+
+#ifdef WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+/** Increase if the format of the cache file changes. */
+static const uint32_t MANIFEST_VERSION = 1;
+
+// ----------------------------------------------------------------------------
+AssetManifest::AssetManifest(irr::io::IFileSystem *file_system)
+{
+    m_file_system = file_system;
+    m_modified    = false;
+}   // AssetManifest
+
+// ----------------------------------------------------------------------------
+/** Returns the path with '/' as separator, without repeated separators and
+ *  without a '/' at the end, which is used as key for a directory.
+ */
+std::string AssetManifest::normalise(const std::string &path)
+{
+    std::string result;
+    result.reserve(path.size());
+    for (char c : path)
+    {
+        if (c == '\\')
+            c = '/';
+        if (c == '/' && !result.empty() && result.back() == '/')
+            continue;
+        result.push_back(c);
+    }
+    if (result.size() > 1 && result.back() == '/')
+        result.pop_back();
+    return result;
+}   // normalise
+
+// ----------------------------------------------------------------------------
+/** Returns the key of a file name in the index of a directory. On systems
+ *  with case insensitive file names this is the lower case name.
+ */
+std::string AssetManifest::getKey(const std::string &name)
+{
+#if defined(WIN32) || defined(__APPLE__)
+    return StringUtils::toLowerCase(name);
+#else
+    return name;
+#endif
+}   // getKey
+
+// ----------------------------------------------------------------------------
+/** Returns true if the (normalised) directory is a root directory or below
+ *  a root directory.
+ */
+bool AssetManifest::isBelowRoot(const std::string &dir) const
+{
+    const std::string d = dir + "/";
+    for (const std::string &root : m_roots)
+    {
+        if (d.compare(0, root.size(), root) == 0)
+            return true;
+    }
+    return false;
+}   // isBelowRoot
+
+// ----------------------------------------------------------------------------
+/** Adds a directory whose contents (including all subdirectories) are
+ *  handled by the manifest.
+ */
+void AssetManifest::addRoot(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_roots.push_back(normalise(dir) + "/");
+}   // addRoot
+
+// ----------------------------------------------------------------------------
+/** Removes all root directories, so no paths are handled anymore. */
+void AssetManifest::clearRoots()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_roots.clear();
+}   // clearRoots
+
+// ----------------------------------------------------------------------------
+/** Marks the directory, all its subdirectories and all parent directories
+ *  of a path as unchecked, so that the file system is used for them again.
+ *  Must be called when stk changes a file or directory below a root.
+ *  \param path The path that was changed, or "" for all directories.
+ */
+void AssetManifest::invalidate(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::string p = normalise(path);
+    for (auto &it : m_directories)
+    {
+        const std::string &d = it.first;
+        if (p.empty() || d == p ||
+            p.compare(0, d.size() + 1, d + "/") == 0 ||
+            d.compare(0, p.size() + 1, p + "/") == 0)
+            it.second.m_validated = false;
+    }
+}   // invalidate
+
+// ----------------------------------------------------------------------------
+/** Returns the contents of a directory, which are listed again if the
+ *  modification time of the directory changed. Returns NULL if the directory
+ *  does not exist. m_mutex must be locked.
+ *  \param dir The normalised directory.
+ */
+const AssetManifest::Directory*
+                             AssetManifest::getDirectory(const std::string &dir)
+{
+    auto it = m_directories.find(dir);
+    if (it != m_directories.end() && it->second.m_validated)
+        return &it->second;
+
+    struct stat buf;
+    if (FileUtils::statU8Path(dir, &buf) != 0 || (buf.st_mode & S_IFDIR) == 0)
+    {
+        if (it != m_directories.end())
+        {
+            m_directories.erase(it);
+            m_modified = true;
+        }
+        return NULL;
+    }
+    Directory &directory = m_directories[dir];
+    if (it == m_directories.end() || directory.m_mtime != buf.st_mtime)
+        listDirectory(dir, buf.st_mtime, &directory);
+    directory.m_validated = true;
+    return &directory;
+}   // getDirectory
+
+// ----------------------------------------------------------------------------
+/** Lists the contents of a directory using the file system.
+ *  \param dir The normalised directory.
+ *  \param mtime The modification time of the directory.
+ *  \param directory The object to store the contents in.
+ */
+void AssetManifest::listDirectory(const std::string &dir, int64_t mtime,
+                                  Directory *directory)
+{
+    // A change in the same second would not change the modification time,
+    // so in this case the directory is listed again in the next run.
+    directory->m_mtime =
+        (int64_t)StkTime::getTimeSinceEpoch() - mtime < 2 ? -1 : mtime;
+    directory->m_entries.clear();
+    directory->m_index.clear();
+
+    irr::io::IFileList *files = m_file_system->createFileList(dir.c_str());
+    for (unsigned int n = 0; n < files->getFileCount(); n++)
+    {
+        Entry entry;
+        entry.m_name         = files->getFileName(n).c_str();
+        entry.m_is_directory = files->isDirectory(n);
+        entry.m_size         = 0;
+        entry.m_mtime        = 0;
+        struct stat buf;
+        if (entry.m_name != "." && entry.m_name != ".." &&
+            FileUtils::statU8Path(dir + "/" + entry.m_name, &buf) == 0)
+        {
+            entry.m_size  = buf.st_size;
+            entry.m_mtime = buf.st_mtime;
+        }
+        directory->m_index[getKey(entry.m_name)] =
+            (unsigned)directory->m_entries.size();
+        directory->m_entries.push_back(entry);
+    }
+    files->drop();
+    m_modified = true;
+}   // listDirectory
+
+// ----------------------------------------------------------------------------
+/** Checks if a file or directory exists.
+ *  \param path The path to check.
+ *  \param exists On return true if the path exists.
+ *  \return False if the path is not handled by the manifest, in which case
+ *          exists is not set.
+ */
+bool AssetManifest::fileExists(const std::string &path, bool *exists)
+{
+    const std::string p = normalise(path);
+    const size_t pos = p.find_last_of('/');
+    if (pos == std::string::npos || pos == 0)
+        return false;
+    const std::string name = p.substr(pos + 1);
+    if (name == "." || name == "..")
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::string dir = p.substr(0, pos);
+    if (!isBelowRoot(dir))
+        return false;
+    const Directory *directory = getDirectory(dir);
+    *exists = directory && directory->m_index.count(getKey(name)) > 0;
+    return true;
+}   // fileExists
+
+// ----------------------------------------------------------------------------
+/** Returns the names of all files and directories in a directory, in the
+ *  same way as FileManager::listFiles.
+ *  \param dir The directory to list.
+ *  \param result On return the names of all entries (the set is cleared).
+ *  \return False if the directory is not handled by the manifest.
+ */
+bool AssetManifest::listFiles(const std::string &dir,
+                              std::set<std::string> *result)
+{
+    const std::string d = normalise(dir);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isBelowRoot(d))
+        return false;
+    result->clear();
+    const Directory *directory = getDirectory(d);
+    if (directory)
+    {
+        for (const Entry &entry : directory->m_entries)
+            result->insert(entry.m_name);
+    }
+    return true;
+}   // listFiles
+
+// ----------------------------------------------------------------------------
+/** Loads the manifest from a cache file. If the file does not exist or has
+ *  a different version the manifest starts empty.
+ *  \param filename Name of the cache file, which is also used by save.
+ */
+void AssetManifest::load(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_filename = filename;
+    m_directories.clear();
+    m_modified = false;
+
+    FILE *fp = FileUtils::fopenU8Path(filename, "rb");
+    if (!fp)
+        return;
+    std::string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        content.append(buffer, n);
+    fclose(fp);
+
+    size_t offset = 0;
+    bool valid = true;
+    auto read = [&content, &offset, &valid](void *data, size_t size)
+    {
+        if (!valid || offset + size > content.size())
+        {
+            valid = false;
+            return;
+        }
+        memcpy(data, content.data() + offset, size);
+        offset += size;
+    };
+    auto read_string = [&content, &offset, &valid, &read](std::string *s)
+    {
+        uint32_t length = 0;
+        read(&length, 4);
+        if (!valid || offset + length > content.size())
+        {
+            valid = false;
+            return;
+        }
+        s->assign(content.data() + offset, length);
+        offset += length;
+    };
+
+    uint32_t version = 0, num_directories = 0;
+    read(&version, 4);
+    read(&num_directories, 4);
+    if (version != MANIFEST_VERSION)
+        valid = false;
+    for (uint32_t i = 0; valid && i < num_directories; i++)
+    {
+        std::string path;
+        Directory directory;
+        uint32_t num_entries = 0;
+        read_string(&path);
+        read(&directory.m_mtime, 8);
+        read(&num_entries, 4);
+        for (uint32_t j = 0; valid && j < num_entries; j++)
+        {
+            Entry entry;
+            uint8_t is_directory = 0;
+            read_string(&entry.m_name);
+            read(&entry.m_size, 8);
+            read(&entry.m_mtime, 8);
+            read(&is_directory, 1);
+            entry.m_is_directory = is_directory != 0;
+            directory.m_index[getKey(entry.m_name)] = j;
+            directory.m_entries.push_back(entry);
+        }
+        directory.m_validated = false;
+        m_directories[path] = std::move(directory);
+    }
+    if (!valid)
+    {
+        Log::info("AssetManifest", "Ignoring outdated manifest '%s'.",
+                  filename.c_str());
+        m_directories.clear();
+    }
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Saves the manifest to the cache file if any directory was listed again.
+ *  A temporary file is renamed at the end, so other processes never see a
+ *  partial file.
+ */
+void AssetManifest::save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_modified || m_filename.empty())
+        return;
+
+    std::string content;
+    auto write = [&content](const void *data, size_t size)
+    {
+        content.append((const char*)data, size);
+    };
+    auto write_string = [&write](const std::string &s)
+    {
+        const uint32_t length = (uint32_t)s.size();
+        write(&length, 4);
+        write(s.data(), length);
+    };
+    const uint32_t num_directories = (uint32_t)m_directories.size();
+    write(&MANIFEST_VERSION, 4);
+    write(&num_directories, 4);
+    for (const auto &it : m_directories)
+    {
+        const Directory &directory = it.second;
+        const uint32_t num_entries = (uint32_t)directory.m_entries.size();
+        write_string(it.first);
+        write(&directory.m_mtime, 8);
+        write(&num_entries, 4);
+        for (const Entry &entry : directory.m_entries)
+        {
+            const uint8_t is_directory = entry.m_is_directory ? 1 : 0;
+            write_string(entry.m_name);
+            write(&entry.m_size, 8);
+            write(&entry.m_mtime, 8);
+            write(&is_directory, 1);
+        }
+    }
+
+    // Several processes (e.g. server rooms) might write the same file
+#ifdef WIN32
+    const int pid = _getpid();
+#else
+    const int pid = getpid();
+#endif
+    const std::string tmp_file = m_filename + "." +
+                                 StringUtils::toString(pid) + ".tmp";
+    FILE *fp = FileUtils::fopenU8Path(tmp_file, "wb");
+    if (!fp)
+    {
+        Log::warn("AssetManifest", "Can not write manifest '%s'.",
+                  tmp_file.c_str());
+        return;
+    }
+    bool ok = fwrite(content.data(), 1, content.size(), fp) == content.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || FileUtils::renameU8Path(tmp_file, m_filename) != 0)
+    {
+        Log::warn("AssetManifest", "Can not write manifest '%s'.",
+                  m_filename.c_str());
+        remove(FileUtils::getPortableWritingPath(tmp_file).c_str());
+        return;
+    }
+    m_modified = false;
+}   // save
@@ -0,0 +1,109 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ASSET_MANIFEST_HPP
+#define HEADER_ASSET_MANIFEST_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace irr { namespace io { class IFileSystem; } }
+
+/** A list of the contents of all asset directories (name, size and
+ *  modification time of each file), which is saved in a cache file between
+ *  runs of stk. Each directory is only listed again if its modification time
+ *  changed, and is then checked only once per process. This allows to
+ *  answer whether a file exists and to list directories with a hash map
+ *  lookup instead of accessing the file system each time.
+ *  Only directories below the added root directories are handled, for all
+ *  other paths the caller must use the file system.
+ *  \ingroup io
+ */
+class AssetManifest : public NoCopy
+{
+public:
+    /** A file or directory in a listed directory. */
+    struct Entry
+    {
+        std::string m_name;
+        uint64_t    m_size;
+        int64_t     m_mtime;
+        bool        m_is_directory;
+    };
+
+private:
+    /** The contents of a directory. */
+    struct Directory
+    {
+        /** Modification time of the directory when it was listed, or -1
+         *  if the listing must not be used in the next run. */
+        int64_t m_mtime;
+
+        /** True if the modification time was checked in this process. */
+        bool m_validated;
+
+        /** All entries in the order returned by the file system. */
+        std::vector<Entry> m_entries;
+
+        /** Maps the (lower case on case insensitive systems) name of an
+         *  entry to its index in m_entries. */
+        std::unordered_map<std::string, unsigned> m_index;
+    };
+
+    /** All known directories, indexed by their normalised path. */
+    std::unordered_map<std::string, Directory> m_directories;
+
+    /** All root directories (normalised, with a '/' at the end). */
+    std::vector<std::string> m_roots;
+
+    /** Name of the cache file. */
+    std::string m_filename;
+
+    /** True if a directory was listed again since the cache was loaded. */
+    bool m_modified;
+
+    std::mutex m_mutex;
+
+    irr::io::IFileSystem *m_file_system;
+
+    static std::string normalise(const std::string &path);
+    bool isBelowRoot(const std::string &dir) const;
+    const Directory *getDirectory(const std::string &dir);
+    void listDirectory(const std::string &dir, int64_t mtime,
+                       Directory *directory);
+
+public:
+    AssetManifest(irr::io::IFileSystem *file_system);
+    static std::string getKey(const std::string &name);
+    void load(const std::string &filename);
+    void save();
+    void addRoot(const std::string &dir);
+    void clearRoots();
+    void invalidate(const std::string &path);
+    bool fileExists(const std::string &path, bool *exists);
+    bool listFiles(const std::string &dir, std::set<std::string> *result);
+
+};   // class AssetManifest
+
+#endif
@@ -25,6 +25,7 @@
 #include "graphics/material_manager.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/skin.hpp"
+#include "io/asset_manifest.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
@@ -32,6 +33,7 @@
 #include "utils/file_utils.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/thread_pool.hpp"
 
 #ifdef ANDROID
 #include "io/assets_android.hpp"
@@ -62,6 +64,7 @@ namespace irr {
 #else
 #  define WIN32_LEAN_AND_MEAN
 #  include <direct.h>
+#  include <process.h>
 #  include <windows.h>
 #  include <stdio.h>
 #  if !defined(__MINGW32__)
@@ -148,6 +151,8 @@ FileManager::FileManager()
 #endif
 
     m_file_system = irr::io::createFileSystem();
+    m_asset_manifest = NULL;
+    m_file_system_probes = 0;
 
 #ifdef ANDROID
     AssetsAndroid android_assets(this);
@@ -252,6 +257,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedDataDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -405,6 +411,14 @@ void FileManager::discoverPaths()
 void FileManager::init()
 {
     discoverPaths();
+    // Artists change files while stk is running, so always use the file
+    // system in this case
+    if (!UserConfigParams::m_artist_debug_mode)
+    {
+        m_asset_manifest = new AssetManifest(m_file_system);
+        m_asset_manifest->load(getCachedDataDir() + "asset-manifest.cache");
+        addAssetManifestRoots();
+    }
     addAssetsSearchPath();
     m_cert_bundle_location = m_file_system->getAbsolutePath(
         getAsset("cacert.pem").c_str()).c_str();
@@ -489,7 +503,14 @@ void FileManager::reinitAfterDownloadAssets()
     m_texture_search_path.clear();
     m_model_search_path.clear();
     m_music_search_path.clear();
+    m_search_path_index.clear();
     discoverPaths();
+    if (m_asset_manifest)
+    {
+        m_asset_manifest->clearRoots();
+        m_asset_manifest->invalidate("");
+        addAssetManifestRoots();
+    }
     addAssetsSearchPath();
     // Add back addons search path
     KartPropertiesManager::addKartSearchDir(
@@ -498,6 +519,43 @@ void FileManager::reinitAfterDownloadAssets()
                  file_manager->getAddonsFile("tracks/"));
 }   // reinitAfterDownloadAssets
 
+//-----------------------------------------------------------------------------
+/** Adds all directories with assets which are not changed by stk to the
+ *  asset manifest. The addons directory itself is not added, since e.g. the
+ *  news and icons in it are changed frequently.
+ */
+void FileManager::addAssetManifestRoots()
+{
+    for (const std::string &root : m_root_dirs)
+        m_asset_manifest->addRoot(root);
+    if (!m_stk_assets_download_dir.empty())
+        m_asset_manifest->addRoot(m_stk_assets_download_dir);
+    m_asset_manifest->addRoot(getAddonsFile("karts/"));
+    m_asset_manifest->addRoot(getAddonsFile("tracks/"));
+}   // addAssetManifestRoots
+
+//-----------------------------------------------------------------------------
+/** Must be called when stk changes a file or directory, so that the asset
+ *  manifest lists the affected directories again.
+ *  \param path The file or directory that was changed.
+ */
+void FileManager::invalidateAssetManifest(const std::string &path) const
+{
+    if (m_asset_manifest)
+        m_asset_manifest->invalidate(path);
+}   // invalidateAssetManifest
+
+//-----------------------------------------------------------------------------
+/** Saves the asset manifest, so that the next start of stk does not need to
+ *  list the asset directories again. Nothing is written if no directory
+ *  changed.
+ */
+void FileManager::saveAssetManifest()
+{
+    if (m_asset_manifest)
+        m_asset_manifest->save();
+}   // saveAssetManifest
+
 //-----------------------------------------------------------------------------
 FileManager::~FileManager()
 {
@@ -507,6 +565,9 @@ FileManager::~FileManager()
     popModelSearchPath();
     popTextureSearchPath();
     popTextureSearchPath();
+    saveAssetManifest();
+    delete m_asset_manifest;
+    m_asset_manifest = NULL;
     m_file_system->drop();
     m_file_system = NULL;
 }   // ~FileManager
@@ -517,6 +578,10 @@ FileManager::~FileManager()
 bool FileManager::fileExists(const std::string& path) const
 {
     std::lock_guard<std::mutex> lock(m_file_system_lock);
+    bool manifest_exists;
+    if (m_asset_manifest && m_asset_manifest->fileExists(path,
+                                                         &manifest_exists))
+        return manifest_exists;
 #ifdef DEBUG
     bool exists = m_file_system->existFile(path.c_str());
     if(exists) return true;
@@ -602,6 +667,54 @@ XMLNode *FileManager::createXMLTreeFromString(const std::string & content)
     }
 }   // createXMLTreeFromString
 
+//-----------------------------------------------------------------------------
+/** Reads in several XML files in parallel and converts them into XMLNode
+ *  trees. The files are read directly from disk instead of through the file
+ *  archives of the irrlicht file system. The workers only use the file
+ *  system to wrap the content in a memory file and to create the XML
+ *  reader, which creates new objects without using the search paths, so
+ *  this can be used while other threads use the file manager. Files that
+ *  can not be read this way (e.g. assets in an archive) get a NULL tree,
+ *  they can still be loaded with createXMLTree.
+ *  \param filenames Names of the XML files to read.
+ *  \param trees On return the tree for each file. The caller must delete
+ *         the trees.
+ */
+void FileManager::createXMLTrees(const std::vector<std::string> &filenames,
+                                 std::vector<XMLNode*> *trees)
+{
+    trees->assign(filenames.size(), NULL);
+    ThreadPool::getShared()->parallelFor((unsigned)filenames.size(),
+                     [this, &filenames, trees](unsigned i)
+    {
+        FILE *fp = FileUtils::fopenU8Path(filenames[i], "rb");
+        if (!fp)
+            return;
+        fseek(fp, 0, SEEK_END);
+        const long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        char *content = size > 0 ? new char[size] : NULL;
+        const bool ok = content && fread(content, 1, size, fp) == (size_t)size;
+        fclose(fp);
+        if (!ok)
+        {
+            delete [] content;
+            return;
+        }
+        // The memory file takes ownership of the content
+        io::IReadFile *file =
+            m_file_system->createMemoryReadFile(content, (int)size,
+                                                filenames[i].c_str(), true);
+        io::IXMLReader *reader = m_file_system->createXMLReader(file);
+        if (reader)
+        {
+            (*trees)[i] = new XMLNode(reader, filenames[i]);
+            reader->drop();
+        }
+        file->drop();
+    });
+}   // createXMLTrees
+
 //-----------------------------------------------------------------------------
 /** In order to add and later remove paths we have to specify the absolute
  *  filename (and replace '\' with '/' on windows).
@@ -619,6 +732,7 @@ io::path FileManager::createAbsoluteFilename(const std::string &f)
  */
 void FileManager::pushModelSearchPath(const std::string& path)
 {
+    addSearchPathIndex(path);
     std::lock_guard<std::mutex> lock(m_file_system_lock);
 
     m_model_search_path.push_back(path);
@@ -648,6 +762,7 @@ void FileManager::pushModelSearchPath(const std::string& path)
  */
 void FileManager::pushTextureSearchPath(const std::string& path, const std::string& container_id)
 {
+    addSearchPathIndex(path);
     std::lock_guard<std::mutex> lock(m_file_system_lock);
 
     m_texture_search_path.push_back(TextureSearchPath(path, container_id));
@@ -682,6 +797,7 @@ void FileManager::popTextureSearchPath()
         std::lock_guard<std::mutex> lock(m_file_system_lock);
         TextureSearchPath dir = m_texture_search_path.back();
         m_texture_search_path.pop_back();
+        removeSearchPathIndex(dir.m_texture_search_path);
         m_file_system->removeFileArchive(createAbsoluteFilename(dir.m_texture_search_path));
     }
 }   // popTextureSearchPath
@@ -696,6 +812,7 @@ void FileManager::popModelSearchPath()
         std::lock_guard<std::mutex> lock(m_file_system_lock);
         std::string dir = m_model_search_path.back();
         m_model_search_path.pop_back();
+        removeSearchPathIndex(dir);
         m_file_system->removeFileArchive(createAbsoluteFilename(dir));
     }
 }   // popModelSearchPath
@@ -711,6 +828,74 @@ void FileManager::popMusicSearchPath()
     }
 }
 
+//-----------------------------------------------------------------------------
+/** Creates the index of a directory which is added to the texture or model
+ *  search path, or increases its reference count if it already exists.
+ *  Only directories ending with a '/' can be indexed.
+ *  \param dir The directory added to the search path.
+ */
+void FileManager::addSearchPathIndex(const std::string &dir)
+{
+    if (dir.empty() || (dir.back() != '/' && dir.back() != '\\'))
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_file_system_lock);
+        auto it = m_search_path_index.find(dir);
+        if (it != m_search_path_index.end())
+        {
+            it->second.m_ref_count++;
+            return;
+        }
+    }
+    // listFiles locks m_file_system_lock itself
+    std::set<std::string> names;
+    listFiles(names, dir);
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
+    SearchPathIndex &index = m_search_path_index[dir];
+    if (index.m_ref_count++ == 0)
+    {
+        for (const std::string &name : names)
+            index.m_names.insert(AssetManifest::getKey(name));
+    }
+}   // addSearchPathIndex
+
+//-----------------------------------------------------------------------------
+/** Decreases the reference count of the index of a directory which is
+ *  removed from the texture or model search path, and removes the index
+ *  once it is not used anymore. m_file_system_lock must be locked.
+ *  \param dir The directory removed from the search path.
+ */
+void FileManager::removeSearchPathIndex(const std::string &dir)
+{
+    auto it = m_search_path_index.find(dir);
+    if (it != m_search_path_index.end() && --it->second.m_ref_count == 0)
+        m_search_path_index.erase(it);
+}   // removeSearchPathIndex
+
+//-----------------------------------------------------------------------------
+/** Checks if a file exists in a directory of a search path. The index of
+ *  the directory is used if possible, otherwise the file system is accessed.
+ *  m_file_system_lock must be locked.
+ *  \param dir The directory of the search path.
+ *  \param file_name The name of the file to look for.
+ */
+bool FileManager::existsInSearchPath(const std::string &dir,
+                                     const std::string &file_name) const
+{
+    // The index only contains the names of the entries of the directory
+    if (file_name.find_first_of("/\\") == std::string::npos)
+    {
+        auto it = m_search_path_index.find(dir);
+        if (it != m_search_path_index.end())
+        {
+            return it->second.m_names.count(AssetManifest::getKey(file_name))
+                   > 0;
+        }
+    }
+    m_file_system_probes++;
+    return m_file_system->existFile((dir + file_name).c_str());
+}   // existsInSearchPath
+
 //-----------------------------------------------------------------------------
 /** Tries to find the specified file in any of the given search paths.
  *  \param full_path On return contains the full path of the file, or
@@ -723,12 +908,16 @@ bool FileManager::findFile(std::string& full_path,
                       const std::string& file_name,
                       const std::vector<std::string>& search_path) const
 {
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
     for(std::vector<std::string>::const_reverse_iterator
         i = search_path.rbegin();
         i != search_path.rend(); ++i)
     {
-        full_path = *i + file_name;
-        if(m_file_system->existFile(full_path.c_str())) return true;
+        if (existsInSearchPath(*i, file_name))
+        {
+            full_path = *i + file_name;
+            return true;
+        }
     }
     full_path="";
     return false;
@@ -746,12 +935,16 @@ bool FileManager::findFile(std::string& full_path,
     const std::string& file_name,
     const std::vector<TextureSearchPath>& search_path) const
 {
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
     for (std::vector<TextureSearchPath>::const_reverse_iterator
         i = search_path.rbegin();
         i != search_path.rend(); ++i)
     {
-        full_path = i->m_texture_search_path + file_name;
-        if (m_file_system->existFile(full_path.c_str())) return true;
+        if (existsInSearchPath(i->m_texture_search_path, file_name))
+        {
+            full_path = i->m_texture_search_path + file_name;
+            return true;
+        }
     }
     full_path = "";
     return false;
@@ -833,6 +1026,62 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which data computed from assets is cached.
+*/
+std::string FileManager::getCachedDataDir() const
+{
+    return m_cached_data_dir;
+}   // getCachedDataDir
+
+//-----------------------------------------------------------------------------
+/** Changes the directory in which data computed from assets is cached. This
+ *  is used by unit tests, so that they do not leave files in the cache of
+ *  the user.
+ *  \param dir The new directory, which must end with a '/'.
+ */
+void FileManager::setCachedDataDir(const std::string &dir)
+{
+    m_cached_data_dir = dir;
+}   // setCachedDataDir
+
+//-----------------------------------------------------------------------------
+/** Creates a new, empty directory in the temporary directory of the system.
+ *  The caller must delete it again with removeDirectory.
+ *  \param prefix Start of the name of the directory.
+ *  \return The name of the directory (ending with a '/'), or an empty
+ *          string if it could not be created.
+ */
+std::string FileManager::createTempDirectory(const std::string &prefix)
+{
+#if defined(WIN32)
+    const char *tmp = getenv("TEMP");
+    const int pid = _getpid();
+#else
+    const char *tmp = getenv("TMPDIR");
+    const int pid = getpid();
+#endif
+    std::string base = tmp && tmp[0] ? tmp : "/tmp";
+    if (base.back() != '/' && base.back() != '\\')
+        base += "/";
+
+    // Add a counter, in case that a directory of this process was not removed
+    for (unsigned int i = 0; i < 100; i++)
+    {
+        const std::string dir = base + prefix + "-" +
+                                StringUtils::toString(pid) + "-" +
+                                StringUtils::toString(i);
+        if (m_file_system->existFile(io::path(dir.c_str())))
+            continue;
+        if (!checkAndCreateDirectory(dir))
+            break;
+        return dir + "/";
+    }
+    Log::error("FileManager", "Cannot create a temporary directory in '%s'.",
+               base.c_str());
+    return "";
+}   // createTempDirectory
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -863,19 +1112,17 @@ std::string FileManager::searchTexture(const std::string& file_name) const
 bool FileManager::searchTextureContainerId(std::string& container_id,
     const std::string& file_name) const
 {
-    std::string full_path;
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
     for (std::vector<TextureSearchPath>::const_reverse_iterator
         i = m_texture_search_path.rbegin();
         i != m_texture_search_path.rend(); ++i)
     {
-        full_path = i->m_texture_search_path + file_name;
-        if (m_file_system->existFile(full_path.c_str()))
+        if (existsInSearchPath(i->m_texture_search_path, file_name))
         {
             container_id = i->m_container_id;
             return true;
         }
     }
-    full_path = "";
     return false;
 }   // findFile
 
@@ -903,6 +1150,7 @@ bool FileManager::checkAndCreateDirectory(const std::string &path)
         return true;
 
     Log::info("FileManager", "Creating directory '%s'.", path.c_str());
+    invalidateAssetManifest(path);
 
     // Otherwise try to create the directory:
 #if defined(WIN32)
@@ -1175,6 +1423,31 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directories for cached data. This will set m_cached_data_dir
+*  with the appropriate path.
+*/
+void FileManager::checkAndCreateCachedDataDir()
+{
+#if defined(WIN32)
+    m_cached_data_dir = m_user_config_dir + "cached-data/";
+#elif defined(__APPLE__)
+    m_cached_data_dir = getenv("HOME");
+    m_cached_data_dir += "/Library/Application Support/SuperTuxKart/CachedData/";
+#else
+    m_cached_data_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_data_dir += "cached-data/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_data_dir))
+    {
+        Log::error("FileManager", "Can not create cached data directory '%s', "
+            "falling back to '.'.", m_cached_data_dir.c_str());
+        m_cached_data_dir = "./";
+    }
+
+}   // checkAndCreateCachedDataDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -1443,6 +1716,17 @@ void FileManager::listFiles(std::set<std::string>& result,
 {
     result.clear();
 
+    // createFileList changes the current directory, and the asset manifest
+    // might need to call it, too.
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
+    std::set<std::string> names;
+    if (m_asset_manifest && m_asset_manifest->listFiles(dir, &names))
+    {
+        for (const std::string &name : names)
+            result.insert(make_full_path ? dir + "/" + name : name);
+        return;
+    }
+
     if (!isDirectory(dir))
         return;
 
@@ -1467,6 +1751,7 @@ void FileManager::checkAndCreateDirForAddons(const std::string &dir)
 {
     // Tries to create directory recursively
     bool success = checkAndCreateDirectoryP(dir);
+    invalidateAssetManifest(dir);
     if(!success)
     {
         Log::warn("FileManager", "There is a problem with the addons dir.");
@@ -1489,6 +1774,7 @@ bool FileManager::removeFile(const std::string &name) const
     if(FileUtils::statU8Path(name, &mystat) < 0) return false;
     if( S_ISREG(mystat.st_mode))
     {
+        invalidateAssetManifest(name);
 #if defined(WIN32)
         return _wremove(StringUtils::utf8ToWide(name).c_str()) == 0;
 #else
@@ -1541,6 +1827,7 @@ bool FileManager::removeDirectory(const std::string &name) const
         }
     }
 
+    invalidateAssetManifest(name);
 #if defined(WIN32)
     return RemoveDirectory(StringUtils::utf8ToWide(name).c_str())==TRUE;
 #else
@@ -1565,6 +1852,7 @@ bool FileManager::copyFile(const std::string &source, const std::string &dest)
         fclose(f_source);
         return false;
     }
+    invalidateAssetManifest(dest);
 
     const int BUFFER_SIZE=32768;
     char *buffer = new char[BUFFER_SIZE];
@@ -1629,6 +1917,8 @@ bool FileManager::moveDirectoryInto(std::string source, std::string target)
     if (isDirectory(target))
         return false;
 
+    invalidateAssetManifest(source);
+    invalidateAssetManifest(target);
 #if defined(WIN32)
     return MoveFileExW(StringUtils::utf8ToWide(source).c_str(),
         StringUtils::utf8ToWide(target).c_str(),
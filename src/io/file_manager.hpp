@@ -25,15 +25,20 @@
  * Contains generic utility classes for file I/O (especially XML handling).
  */
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <irrString.h>
 #include <IFileSystem.h>
 namespace irr { class IrrlichtDevice; }
 using namespace irr;
+class AssetManifest;
 
 #include "io/xml_node.hpp"
 #include "utils/no_copy.hpp"
@@ -74,6 +79,10 @@ private:
     /** Handle to irrlicht's file systems. */
     io::IFileSystem  *m_file_system;
 
+    /** Cached contents of the asset directories, or NULL if the file system
+     *  must be used for all paths (e.g. in artist debug mode). */
+    AssetManifest    *m_asset_manifest;
+
     /** Directory where user config files are stored. */
     std::string       m_user_config_dir;
 
@@ -98,6 +107,10 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where data computed from assets (e.g. shortest paths of
+     *  arenas) is cached. */
+    std::string       m_cached_data_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -112,6 +125,29 @@ private:
     std::vector<std::string>
                       m_model_search_path,
                       m_music_search_path;
+
+    /** The names of all files in a directory of the texture or model search
+     *  path, so that files can be found without accessing the file system. */
+    struct SearchPathIndex
+    {
+        /** Number of texture and model search paths using this index. */
+        unsigned m_ref_count;
+        std::unordered_set<std::string> m_names;
+        SearchPathIndex() : m_ref_count(0) {}
+    };
+
+    /** The index of each directory in the texture and model search paths.
+     *  Protected by m_file_system_lock. */
+    std::unordered_map<std::string, SearchPathIndex> m_search_path_index;
+
+    /** Number of times the file system was accessed to find a file in a
+     *  search path. */
+    mutable std::atomic<uint64_t> m_file_system_probes;
+
+    void              addSearchPathIndex(const std::string &dir);
+    void              removeSearchPathIndex(const std::string &dir);
+    bool              existsInSearchPath(const std::string &dir,
+                                         const std::string &fname) const;
     bool              findFile(std::string& full_path,
                                const std::string& fname,
                                const std::vector<std::string>& search_path)
@@ -128,9 +164,12 @@ private:
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateReplayDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCachedDataDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
     void              addAssetsSearchPath();
+    void              addAssetManifestRoots();
+    void              invalidateAssetManifest(const std::string &path) const;
     void              resetSubdir();
 #if !defined(WIN32) && !defined(__APPLE__)
     std::string       checkAndCreateLinuxDir(const char *env_name,
@@ -144,16 +183,22 @@ public:
                      ~FileManager();
     void              init();
     void              reinitAfterDownloadAssets();
+    void              saveAssetManifest();
     static void       addRootDirs(const std::string &roots);
     static void       setStdoutName(const std::string &name);
     static void       setStdoutDir(const std::string &dir);
     io::IXMLReader   *createXMLReader(const std::string &filename);
     XMLNode          *createXMLTree(const std::string &filename);
     XMLNode          *createXMLTreeFromString(const std::string & content);
+    void              createXMLTrees(const std::vector<std::string> &filenames,
+                                     std::vector<XMLNode*> *trees);
 
     std::string       getScreenshotDir() const;
     std::string       getReplayDir() const;
     std::string       getCachedTexturesDir() const;
+    std::string       getCachedDataDir() const;
+    void              setCachedDataDir(const std::string &dir);
+    std::string       createTempDirectory(const std::string &prefix);
     std::string       getGPDir() const;
     bool              checkAndCreateDirectory(const std::string &path);
     bool              checkAndCreateDirectoryP(const std::string &path);
@@ -218,6 +263,10 @@ public:
     /** Returns the irrlicht file system. */
     irr::io::IFileSystem* getFileSystem() { return m_file_system; }
     // ------------------------------------------------------------------------
+    /** Returns how often the file system was accessed to find a file in a
+     *  search path (for profiling). */
+    uint64_t getFileSystemProbes() const { return m_file_system_probes; }
+    // ------------------------------------------------------------------------
     /** Adds a directory to the music search path (or stack).
      */
     void pushMusicSearchPath(const std::string& path)
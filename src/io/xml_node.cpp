@@ -18,19 +18,106 @@
 
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/interpolation_array.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/vec3.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <unordered_set>
 
-XMLNode::XMLNode(io::IXMLReader *xml)
+// ----------------------------------------------------------------------------
+/** A simple memory arena in which all nodes and attributes of a tree are
+ *  allocated. The memory is only freed when the arena is deleted.
+ */
+class XMLNode::Arena : public NoCopy
+{
+private:
+    std::vector<char*> m_blocks;
+
+    /** Size of the last block. */
+    size_t m_block_size;
+
+    /** Number of bytes used in the last block. */
+    size_t m_used;
+
+public:
+    /** Name of the file the tree was read from. */
+    std::string m_file_name;
+
+    /** Stores the children of all nodes which are being read, so that the
+     *  children of a node can be copied into one array in the arena. */
+    std::vector<XMLNode*> m_children;
+
+    // ------------------------------------------------------------------------
+    Arena(const std::string &filename)
+        : m_block_size(0), m_used(0), m_file_name(filename)
+    {
+    }   // Arena
+    // ------------------------------------------------------------------------
+    ~Arena()
+    {
+        for (char *block : m_blocks)
+            delete [] block;
+    }   // ~Arena
+    // ------------------------------------------------------------------------
+    /** Returns memory aligned for a pointer (which is enough for XMLNode
+     *  and all data stored in it). */
+    void *allocate(size_t size)
+    {
+        size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+        if (m_blocks.empty() || m_used + size > m_block_size)
+        {
+            // Small files (which are the majority) need only a small block
+            m_block_size = m_block_size == 0
+                         ? 4096 : std::min(m_block_size * 2, (size_t)65536);
+            m_block_size = std::max(m_block_size, size);
+            m_blocks.push_back(new char[m_block_size]);
+            m_used = 0;
+        }
+        void *p = m_blocks.back() + m_used;
+        m_used += size;
+        return p;
+    }   // allocate
+};   // class XMLNode::Arena
+
+static_assert(alignof(XMLNode) <= sizeof(void*),
+              "XMLNode needs a bigger alignment in the arena");
+
+/** All element and attribute names, which are shared by all trees. */
+static std::unordered_set<std::string> g_names;
+static std::mutex g_names_mutex;
+
+// ----------------------------------------------------------------------------
+/** Returns the interned name (g_names_mutex must be locked). The name is
+ *  converted in the same way as with core::stringc.
+ */
+static const std::string *internName(const wchar_t *name)
+{
+    std::string s;
+    if (name)
+    {
+        for (; *name; name++)
+            s.push_back((char)*name);
+    }
+    return &*g_names.insert(s).first;
+}   // internName
+
+// ----------------------------------------------------------------------------
+XMLNode::XMLNode(io::IXMLReader *xml, const std::string &filename)
 {
-    m_file_name = "[unknown]";
+    init(filename);
 
     while(xml->getNodeType()!=io::EXN_ELEMENT && xml->read());
-    readXML(xml);
+    readXML(xml, m_arena);
 }   // XMLNode
 
 // ----------------------------------------------------------------------------
@@ -39,12 +126,13 @@ XMLNode::XMLNode(io::IXMLReader *xml)
  */
 XMLNode::XMLNode(const std::string &filename)
 {
-    m_file_name = filename;
+    init(filename);
 
     io::IXMLReader *xml = file_manager->createXMLReader(filename);
     
     if (xml == NULL)
     {
+        delete m_arena;
         throw std::runtime_error("Cannot find file "+filename);
     }
 
@@ -61,7 +149,7 @@ XMLNode::XMLNode(const std::string &filename)
                                 "More than one root element in '%s' - ignored.",
                             filename.c_str());
                 }
-                readXML(xml);
+                readXML(xml, m_arena);
                 is_first_element = false;
                 break;
             }
@@ -75,51 +163,131 @@ XMLNode::XMLNode(const std::string &filename)
     xml->drop();
 }   // XMLNode
 
+// ----------------------------------------------------------------------------
+/** Creates a child node in the arena of a tree.
+ *  \param xml The XML reader.
+ *  \param arena The arena of the tree.
+ */
+XMLNode::XMLNode(io::IXMLReader *xml, Arena *arena)
+{
+    m_attributes     = NULL;
+    m_num_attributes = 0;
+    m_nodes          = NULL;
+    m_num_nodes      = 0;
+    m_arena          = NULL;
+    m_file_name      = &arena->m_file_name;
+    readXML(xml, arena);
+}   // XMLNode
+
+// ----------------------------------------------------------------------------
+/** Initialises a root node, which owns the arena of the tree.
+ *  \param filename Name of the file the tree is read from.
+ */
+void XMLNode::init(const std::string &filename)
+{
+    static const std::string empty_name;
+    m_name           = &empty_name;
+    m_attributes     = NULL;
+    m_num_attributes = 0;
+    m_nodes          = NULL;
+    m_num_nodes      = 0;
+    m_arena          = new Arena(filename);
+    m_file_name      = &m_arena->m_file_name;
+}   // init
+
 // ----------------------------------------------------------------------------
 /** Destructor. */
 XMLNode::~XMLNode()
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    // The memory of the nodes is freed together with the arena of the root
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
-        delete m_nodes[i];
+        m_nodes[i]->~XMLNode();
     }
-    m_nodes.clear();
+    delete m_arena;
 }   // ~XMLNode
 
 // ----------------------------------------------------------------------------
 /** Stores all attributes, and reads in all children.
  *  \param xml The XML reader.
+ *  \param arena The arena to allocate attributes and children in.
  */
-void XMLNode::readXML(io::IXMLReader *xml)
-{
-    m_name = std::string(core::stringc(xml->getNodeName()).c_str());
+void XMLNode::readXML(io::IXMLReader *xml, Arena *arena)
+{
+    // If a file has more than one root element, the attributes and children
+    // of all of them are kept. Attributes are searched from the end, so the
+    // last value of an attribute is used.
+    const unsigned int count = xml->getAttributeCount();
+    Attribute *attributes = (Attribute*)
+        arena->allocate((m_num_attributes + count) * sizeof(Attribute));
+    std::copy(m_attributes, m_attributes + m_num_attributes, attributes);
+    {
+        std::lock_guard<std::mutex> lock(g_names_mutex);
+        m_name = internName(xml->getNodeName());
+        for(unsigned int i=0; i<count; i++)
+        {
+            attributes[m_num_attributes + i].m_name =
+                internName(xml->getAttributeName(i));
+        }
+    }
 
-    for(unsigned int i=0; i<xml->getAttributeCount(); i++)
+    for(unsigned int i=0; i<count; i++)
     {
-        std::string   name  = core::stringc(xml->getAttributeName(i)).c_str();
-        core::stringw value = xml->getAttributeValue(i);
-        m_attributes[name] = value;
+        Attribute &a = attributes[m_num_attributes + i];
+        const wchar_t *value = xml->getAttributeValue(i);
+        size_t length = 0;
+        a.m_is_ascii = true;
+        for (; value && value[length]; length++)
+        {
+            if (value[length] >= 0x80)
+                a.m_is_ascii = false;
+        }
+
+        char *utf8;
+        if (a.m_is_ascii)
+        {
+            utf8 = (char*)arena->allocate(length + 1);
+            for (size_t j = 0; j < length; j++)
+                utf8[j] = (char)value[j];
+        }
+        else
+        {
+            const std::string s = StringUtils::wideToUtf8(value);
+            length = s.size();
+            utf8 = (char*)arena->allocate(length + 1);
+            memcpy(utf8, s.data(), length);
+        }
+        utf8[length] = 0;
+        a.m_value  = utf8;
+        a.m_length = (unsigned int)length;
     }   // for i
+    m_attributes      = attributes;
+    m_num_attributes += count;
 
     // If no children, we are done
     if(xml->isEmptyElement())
         return;
 
+    const size_t first = arena->m_children.size();
+    arena->m_children.insert(arena->m_children.end(), m_nodes,
+                             m_nodes + m_num_nodes);
+
     /** Read all children elements. */
-    while(xml->read())
+    bool end_found = false;
+    while(!end_found && xml->read())
     {
         switch (xml->getNodeType())
         {
         case io::EXN_ELEMENT:
             {
-                XMLNode* n = new XMLNode(xml);
-                n->m_file_name = m_file_name;
-                m_nodes.push_back(n);
+                XMLNode* n =
+                    new (arena->allocate(sizeof(XMLNode))) XMLNode(xml, arena);
+                arena->m_children.push_back(n);
                 break;
             }
         case io::EXN_ELEMENT_END:
             // End of this element found.
-            return;
+            end_found = true;
             break;
         case io::EXN_UNKNOWN:            break;
         case io::EXN_COMMENT:            break;
@@ -127,6 +295,15 @@ void XMLNode::readXML(io::IXMLReader *xml)
         default:                         break;
         }   // switch
     }   // while
+
+    m_num_nodes = (unsigned int)(arena->m_children.size() - first);
+    if (m_num_nodes > 0)
+    {
+        m_nodes = (XMLNode**)arena->allocate(m_num_nodes * sizeof(XMLNode*));
+        std::copy(arena->m_children.begin() + first, arena->m_children.end(),
+                  m_nodes);
+    }
+    arena->m_children.resize(first);
 }   // readXML
 
 // ----------------------------------------------------------------------------
@@ -144,7 +321,7 @@ const XMLNode *XMLNode::getNode(unsigned int i) const
  */
 const XMLNode *XMLNode::getNode(const std::string &s) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
         if(m_nodes[i]->getName()==s) return m_nodes[i];
     }
@@ -158,7 +335,7 @@ const XMLNode *XMLNode::getNode(const std::string &s) const
  */
 const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
         if(m_nodes[i]->getName()==s)
         {
@@ -167,39 +344,54 @@ const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) c
     }
 }   // getNode
 
+// ----------------------------------------------------------------------------
+/** Returns the attribute with the given name, or NULL if it is not defined.
+ *  \param attribute Name of the attribute.
+ */
+const XMLNode::Attribute *XMLNode::getAttribute(const std::string &attribute)
+                                                                          const
+{
+    for(unsigned int i=m_num_attributes; i>0; i--)
+    {
+        if(*m_attributes[i-1].m_name==attribute) return &m_attributes[i-1];
+    }
+    return NULL;
+}   // getAttribute
+
 // ----------------------------------------------------------------------------
 /** If 'attribute' was defined, set 'value' to the value of the
 *   attribute and return 1, otherwise return 0 and do not change value.
+*   Non-ASCII characters are truncated to 8 bit as with core::stringc, use
+*   the core::stringw version to get them.
 *  \param attribute Name of the attribute.
 *  \param value Value of the attribute.
 */
 int XMLNode::get(const std::string &attribute, std::string *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value=core::stringc(o->second).c_str();
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if(a->m_is_ascii)
+        value->assign(a->m_value, a->m_length);
+    else
+        *value = core::stringc(StringUtils::utf8ToWide(a->m_value)).c_str();
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, core::stringw *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value = o->second;
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if(a->m_is_ascii)
+        *value = a->m_value;
+    else
+        *value = StringUtils::utf8ToWide(a->m_value);
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::getAndDecode(const std::string &attribute, core::stringw *value) const
 {
-    if (m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if (o == m_attributes.end()) return 0;
-    std::string raw_value = core::stringc(o->second).c_str();
+    std::string raw_value;
+    if (!get(attribute, &raw_value)) return 0;
     *value = StringUtils::xmlDecode(raw_value);
     return 1;
 }   // get
@@ -236,7 +428,7 @@ int XMLNode::get(const std::string &attribute, Vec3 *value) const
     if (v.size() != 3)
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -253,7 +445,7 @@ int XMLNode::get(const std::string &attribute, Vec3 *value) const
     else
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -318,7 +510,7 @@ int XMLNode::get(const std::string &attribute, int32_t *value) const
     if (!StringUtils::parseString<int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -334,7 +526,7 @@ int XMLNode::get(const std::string &attribute, int64_t *value) const
     if (!StringUtils::parseString<int64_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -351,7 +543,7 @@ int XMLNode::get(const std::string &attribute, uint16_t *value) const
     if (!StringUtils::parseString<uint16_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -367,7 +559,7 @@ int XMLNode::get(const std::string &attribute, uint32_t *value) const
     if (!StringUtils::parseString<unsigned int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -383,7 +575,7 @@ int XMLNode::get(const std::string &attribute, float *value) const
     if (!StringUtils::parseString<float>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -400,7 +592,7 @@ int XMLNode::get(const std::string &attribute, double *value) const
     {
         Log::warn("[XMLNode]", "WARNING: Expected double but found '%s' for"
             " attribute '%s' of node '%s' in file %s", s.c_str(),
-            attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+            attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -459,7 +651,7 @@ int XMLNode::get(const std::string &attribute,
         if (!StringUtils::parseString<float>(v[i], &curr))
         {
             Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                        v[i].c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
             return 0;
         }
 
@@ -490,7 +682,7 @@ int XMLNode::get(const std::string &attribute, std::vector<int> *value) const
         if (!StringUtils::parseString<int>(v[i], &val))
         {
             Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s'",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str());
+                        v[i].c_str(), attribute.c_str(), m_name->c_str());
             return 0;
         }
 
@@ -643,9 +835,110 @@ int XMLNode::getHPR(Vec3 *value) const
 
 bool XMLNode::hasChildNamed(const char* name) const
 {
-    for (unsigned int i = 0; i < m_nodes.size(); i++)
+    for (unsigned int i = 0; i < m_num_nodes; i++)
     {
         if (m_nodes[i]->getName() == name) return true;
     }
     return false;
 }
+
+// ----------------------------------------------------------------------------
+/** Returns the number of nodes in a tree. */
+static unsigned int countNodes(const XMLNode *node)
+{
+    unsigned int count = 1;
+    for (unsigned int i = 0; i < node->getNumNodes(); i++)
+        count += countNodes(node->getNode(i));
+    return count;
+}   // countNodes
+
+// ----------------------------------------------------------------------------
+/** Measures the time to create the trees of all XML files of all tracks.
+ *  For comparison the time to only run the XML reader over all files is
+ *  measured, the difference is the time spent building the trees. The files
+ *  are read into memory first, so that disk access is not measured.
+ */
+void XMLNode::benchmark()
+{
+    const int ITERATIONS = 5;
+    io::IFileSystem *fs = file_manager->getFileSystem();
+    std::vector<std::string> names, contents;
+    for (unsigned int t = 0; t < track_manager->getNumberOfTracks(); t++)
+    {
+        const std::string dir = track_manager->getTrack(t)->getTrackFile("");
+        std::set<std::string> files;
+        file_manager->listFiles(files, dir);
+        for (const std::string &f : files)
+        {
+            if (StringUtils::getExtension(f) != "xml")
+                continue;
+            FILE *fp = FileUtils::fopenU8Path(dir + f, "rb");
+            if (!fp)
+                continue;
+            std::string content;
+            char buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+                content.append(buffer, n);
+            fclose(fp);
+            names.push_back(dir + f);
+            contents.push_back(content);
+        }
+    }
+
+    auto create_reader = [fs, &names, &contents](unsigned int i)
+    {
+        io::IReadFile *file =
+            fs->createMemoryReadFile((void*)contents[i].data(),
+                                     (s32)contents[i].size(),
+                                     names[i].c_str(), false);
+        io::IXMLReader *reader = fs->createXMLReader(file);
+        file->drop();
+        return reader;
+    };
+
+    size_t num_bytes = 0;
+    unsigned int num_nodes = 0;
+    double start = StkTime::getRealTime();
+    for (int n = 0; n < ITERATIONS; n++)
+    {
+        for (unsigned int i = 0; i < names.size(); i++)
+        {
+            io::IXMLReader *reader = create_reader(i);
+            if (!reader)
+                continue;
+            while (reader->read())
+            {
+                for (unsigned int j = 0; j < reader->getAttributeCount(); j++)
+                    num_bytes += wcslen(reader->getAttributeValue(j));
+            }
+            reader->drop();
+        }
+    }
+    const double reader_time = StkTime::getRealTime() - start;
+
+    start = StkTime::getRealTime();
+    for (int n = 0; n < ITERATIONS; n++)
+    {
+        for (unsigned int i = 0; i < names.size(); i++)
+        {
+            io::IXMLReader *reader = create_reader(i);
+            if (!reader)
+                continue;
+            XMLNode *root = new XMLNode(reader, names[i]);
+            if (n == 0)
+                num_nodes += countNodes(root);
+            delete root;
+            reader->drop();
+        }
+    }
+    const double tree_time = StkTime::getRealTime() - start;
+
+    Log::info("XMLNode", "%d files of %d tracks (%d nodes, %d bytes of "
+              "attribute values): %f ms reading only, %f ms creating the "
+              "trees.", (int)names.size(),
+              track_manager->getNumberOfTracks(), num_nodes,
+              (int)(num_bytes / ITERATIONS),
+              reader_time * 1000.0 / ITERATIONS,
+              tree_time * 1000.0 / ITERATIONS);
+}   // benchmark
@@ -20,7 +20,6 @@
 #define HEADER_XML_NODE_HPP
 
 #include <string>
-#include <map>
 #include <vector>
 
 #include <irrString.h>
@@ -42,36 +41,63 @@ class Vec3;
 
 /**
   * \brief utility class used to parse XML files
+  * All nodes of a tree (except the root) and their attributes are allocated
+  * in one arena owned by the root, so a tree needs only a few allocations.
+  * Element and attribute names are interned, and values are stored as
+  * UTF-8 and only converted when they are read.
   * \ingroup io
   */
 class XMLNode : public NoCopy
 {
 private:
-    /** Name of this element. */
-    std::string                          m_name;
-    /** List of all attributes. */
-    std::map<std::string, core::stringw> m_attributes;
-    /** List of all sub nodes. */
-    std::vector<XMLNode *>               m_nodes;
-
-    void readXML(io::IXMLReader *xml);
-
-    std::string                          m_file_name;
+    class Arena;
+
+    /** An attribute of a node. */
+    struct Attribute
+    {
+        /** The interned name of the attribute. */
+        const std::string *m_name;
+        /** The 0-terminated UTF-8 value, allocated in the arena. */
+        const char        *m_value;
+        unsigned int       m_length;
+        /** True if the value contains only ASCII characters. */
+        bool               m_is_ascii;
+    };
+
+    /** Interned name of this element. */
+    const std::string *m_name;
+    /** List of all attributes, allocated in the arena. */
+    Attribute         *m_attributes;
+    unsigned int       m_num_attributes;
+    /** List of all sub nodes, allocated in the arena. */
+    XMLNode          **m_nodes;
+    unsigned int       m_num_nodes;
+    /** The arena of the tree, which is only owned by the root node. */
+    Arena             *m_arena;
+    /** Name of the file the tree was read from (stored in the arena). */
+    const std::string *m_file_name;
+
+         XMLNode(io::IXMLReader *xml, Arena *arena);
+    void init(const std::string &filename);
+    void readXML(io::IXMLReader *xml, Arena *arena);
+    const Attribute *getAttribute(const std::string &attribute) const;
 
 public:
          LEAK_CHECK();
-         XMLNode(io::IXMLReader *xml);
+         XMLNode(io::IXMLReader *xml,
+                 const std::string &filename = "[unknown]");
 
          /** \throw runtime_error if the file is not found */
          XMLNode(const std::string &filename);
 
         ~XMLNode();
 
-    const std::string &getName() const {return m_name; }
+    static void benchmark();
+    const std::string &getName() const {return *m_name; }
     const XMLNode     *getNode(const std::string &name) const;
     const void         getNodes(const std::string &s, std::vector<XMLNode*>& out) const;
     const XMLNode     *getNode(unsigned int i) const;
-    unsigned int       getNumNodes() const {return (unsigned int) m_nodes.size(); }
+    unsigned int       getNumNodes() const {return m_num_nodes; }
     int get(const std::string &attribute, std::string *value) const;
     int get(const std::string &attribute, core::stringw *value) const;
     int getAndDecode(const std::string &attribute, core::stringw *value) const;
@@ -257,11 +257,19 @@ public:
     // ------------------------------------------------------------------------
     virtual void computeError() OVERRIDE;
     // ------------------------------------------------------------------------
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
     // ------------------------------------------------------------------------
+    virtual bool getInterestPosition(Vec3* xyz) const OVERRIDE
+                                             { *xyz = getXYZ(); return true; }
+    // ------------------------------------------------------------------------
+    virtual void setFrozen(bool frozen) OVERRIDE
+    {
+        Rewinder::setFrozen(frozen);
+        setBodySimulated(!frozen);
+    }
+    // ------------------------------------------------------------------------
     /* Return true if still in game state, or otherwise can be deleted. */
     bool hasServerState() const                  { return m_has_server_state; }
     // ------------------------------------------------------------------------
@@ -148,6 +148,7 @@ void ItemManager::removeTextures()
 ItemManager::ItemManager()
 {
     m_switch_ticks = -1;
+    m_item_grid_dirty = true;
     // The actual loading is done in loadDefaultItems
 
     // Prepare the switch to array, which stores which item should be
@@ -230,10 +231,12 @@ unsigned int ItemManager::insertItem(Item *item)
 
 //-----------------------------------------------------------------------------
 /** Insert into the appropriate quad list, if there is a quad list
- *  (i.e. race mode has a quad graph).
+ *  (i.e. race mode has a quad graph). The spatial hash of items is updated
+ *  the next time it is used.
  */
 void ItemManager::insertItemInQuad(Item *item)
 {
+    m_item_grid_dirty = true;
     if(m_items_in_quads)
     {
         int graph_node = item->getGraphNode();
@@ -356,6 +359,48 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
     kart->collectedItem(item);
 }   // collectedItem
 
+//-----------------------------------------------------------------------------
+/** Returns the key of a cell in the spatial hash of items.
+ *  \param x, z Index of the cell in x and z direction.
+ */
+uint64_t ItemManager::getItemGridKey(int x, int z)
+{
+    return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+}   // getItemGridKey
+
+//-----------------------------------------------------------------------------
+/** Returns the index of the cell in the spatial hash of items which contains
+ *  the coordinate v (x or z).
+ */
+static int getItemGridCell(float v)
+{
+    // Size of a cell. A kart can only hit an item if its distance is less
+    // than about 2.2 (see Item::hitKart), so it is enough to test the
+    // cell of the kart and all adjacent cells.
+    const float ITEM_GRID_CELL_SIZE = 4.0f;
+    // Avoid overflows for karts that are far away (e.g. falling)
+    float cell = floorf(v / ITEM_GRID_CELL_SIZE);
+    return (int)std::max(-1.0e6f, std::min(cell, 1.0e6f));
+}   // getItemGridCell
+
+//-----------------------------------------------------------------------------
+/** Rebuilds the spatial hash of all items.
+ */
+void ItemManager::updateItemGrid()
+{
+    m_item_grid.clear();
+    for (ItemState* item : m_all_items)
+    {
+        if (!item)
+            continue;
+        const Vec3& xyz = item->getXYZ();
+        m_item_grid[getItemGridKey(getItemGridCell(xyz.getX()),
+                                   getItemGridCell(xyz.getZ()))]
+            .push_back(item);
+    }
+    m_item_grid_dirty = false;
+}   // updateItemGrid
+
 //-----------------------------------------------------------------------------
 /** Checks if any item was collected by the given kart. This function calls
  *  collectedItem if an item was collected.
@@ -363,26 +408,43 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
     /** Disable item collection detection for debug purposes. */
     if(m_disable_item_collection) return;
 
     // Spare tire karts don't collect items
     if ( dynamic_cast<SpareTireAI*>(kart->getController()) ) return;
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-                               i!=m_all_items.end();  i++)
+    // Only test the items in the cells close to the kart. Items on the
+    // track and off the track are handled the same way, so we don't need
+    // to test adjacent quads of the graph.
+    if (m_item_grid_dirty)
+        updateItemGrid();
+    const int cx = getItemGridCell(kart->getXYZ().getX());
+    const int cz = getItemGridCell(kart->getXYZ().getZ());
+    m_close_items.clear();
+    for (int z = cz - 1; z <= cz + 1; z++)
+    {
+        for (int x = cx - 1; x <= cx + 1; x++)
+        {
+            auto cell = m_item_grid.find(getItemGridKey(x, z));
+            if (cell != m_item_grid.end())
+            {
+                m_close_items.insert(m_close_items.end(),
+                                     cell->second.begin(), cell->second.end());
+            }
+        }
+    }
+    // Collect items in the same order as all items are stored, so the
+    // result does not depend on the hash (important for networking).
+    std::sort(m_close_items.begin(), m_close_items.end(),
+              [](const ItemState* a, const ItemState* b)
+              { return a->getItemId() < b->getItemId(); });
+
+    for(AllItemTypes::iterator i =m_close_items.begin();
+                               i!=m_close_items.end();  i++)
     {
         // Ignore items that have been collected or are not available atm
-        if ((!*i) || !(*i)->isAvailable() || (*i)->isUsedUp()) continue;
+        if (!(*i)->isAvailable() || (*i)->isUsedUp()) continue;
 
         // Shielded karts can simply drive over bubble gums without any effect
         if ( kart->isShielded() &&
@@ -399,7 +461,7 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
         {
             collectedItem(*i, kart);
         }   // if hit
-    }   // for m_all_items
+    }   // for m_close_items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -510,11 +572,13 @@ void ItemManager::deleteItem(ItemState *item)
 }   // delete item
 
 //-----------------------------------------------------------------------------
-/** Removes an items from the items-in-quad list only
+/** Removes an items from the items-in-quad list only (and from the spatial
+ *  hash the next time it is used).
  *  \param The item to delete.
  */
 void ItemManager::deleteItemInQuad(ItemState* item)
 {
+    m_item_grid_dirty = true;
     if(m_items_in_quads)
     {
         int sector = item->getGraphNode();
@@ -35,6 +35,7 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -107,6 +108,18 @@ private:
      *  field is undefined if no Graph exist, e.g. arena without navmesh. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** A spatial hash of all items, used to only test items close to a kart
+     *  in checkItemHit. The key is the x/z cell of the item (see
+     *  getItemGridKey), and each cell contains the items in it. Unlike
+     *  m_items_in_quads it also works without a graph and for items off
+     *  the track. It is rebuilt when needed after items were added, removed
+     *  or moved. */
+    std::unordered_map<uint64_t, AllItemTypes> m_item_grid;
+
+    /** Temporary list of items close to a kart, stored here to avoid memory
+     *  allocations in each call of checkItemHit. */
+    AllItemTypes m_close_items;
+
     /** Stores all item models. */
     static std::vector<scene::IMesh *> m_item_mesh;
 
@@ -118,12 +131,17 @@ protected:
      *  value is <0, it indicates that the items are not switched atm. */
     int m_switch_ticks;
 
+    /** Set if m_item_grid needs to be rebuilt before it is used. */
+    bool m_item_grid_dirty;
+
     void deleteItem(ItemState *item);
     virtual unsigned int insertItem(Item *item);
     void switchItemsInternal(std::vector < ItemState*> &all_items);
     void setSwitchItems(const std::vector<int> &switch_items);
     void insertItemInQuad(Item *item);
     void deleteItemInQuad(ItemState *item);
+    void updateItemGrid();
+    static uint64_t getItemGridKey(int x, int z);
 public:
              ItemManager();
     virtual ~ItemManager();
@@ -110,7 +110,8 @@ void ProjectileManager::updateServer(int ticks)
     auto p = m_active_projectiles.begin();
     while (p != m_active_projectiles.end())
     {
-        if (!p->second->hasServerState())
+        // Frozen flyables keep their current state in a partial rewind
+        if (!p->second->hasServerState() || p->second->isFrozen())
         {
             p++;
             continue;
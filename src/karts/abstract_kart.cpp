@@ -84,6 +84,12 @@ void AbstractKart::loadKartProperties(const std::string& new_ident,
             new_ident.c_str());
         kp = kart_properties_manager->getKart(std::string("tux"));
     }
+    else if (!kp->loadModels())
+    {
+        Log::warn("Abstract_Kart", "Cannot load the model of kart %s, "
+            "fallback to tux", new_ident.c_str());
+        kp = kart_properties_manager->getKart(std::string("tux"));
+    }
     m_kart_properties->copyForPlayer(kp, handicap);
     m_name = m_kart_properties->getName();
     m_handicap = handicap;
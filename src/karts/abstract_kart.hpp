@@ -533,6 +533,11 @@ public:
     // ------------------------------------------------------------------------
     virtual void makeKartRest();
     // ------------------------------------------------------------------------
+    /** Called for all karts before any kart is updated, possibly from
+     *  several threads at the same time. It must only read the world state,
+     *  and only change data that is used by this kart's update(). */
+    virtual void prepareUpdate(int ticks) = 0;
+    // ------------------------------------------------------------------------
     virtual void setStartupBoost(float val) = 0;
     // ------------------------------------------------------------------------
     virtual float getStartupBoost() const = 0;
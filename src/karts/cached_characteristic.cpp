@@ -18,159 +18,279 @@
 
 #include "karts/cached_characteristic.hpp"
 
-#include "utils/interpolation_array.hpp"
+#include "karts/kart_properties.hpp"
+#include "karts/kart_properties_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <memory>
 
 CachedCharacteristic::CachedCharacteristic(const AbstractCharacteristic *origin) :
-    m_values(CHARACTERISTIC_COUNT),
+    m_values(),
     m_origin(origin)
 {
     updateSource();
 }
 
 // ----------------------------------------------------------------------------
-/** Deletes all allocated values. */
-CachedCharacteristic::~CachedCharacteristic()
+/** Returns a pointer to the value of a characteristic in values. */
+AbstractCharacteristic::Value CachedCharacteristic::getValue(Values *values,
+                                                     CharacteristicType type)
 {
-    // Delete all not-null values
-    for (int i = 0; i < CHARACTERISTIC_COUNT; i++)
+    switch (type)
     {
-        SaveValue &v = m_values[i];
-        if (v.content)
-        {
-            switch (getType(static_cast<CharacteristicType>(i)))
-            {
-            case TYPE_FLOAT:
-                delete static_cast<float*>(v.content);
-                break;
-            case TYPE_FLOAT_VECTOR:
-                delete static_cast<std::vector<float>*>(v.content);
-                break;
-            case TYPE_INTERPOLATION_ARRAY:
-                delete static_cast<InterpolationArray*>(v.content);
-                break;
-            case TYPE_BOOL:
-                delete static_cast<bool*>(v.content);
-                break;
-            }
-            v.content = nullptr;
-        }
+    // Script-generated content generated by tools/create_kart_properties.py ccgetvalue
+    // Please don't change the following tag. It will be automatically detected
+    // by the script and replace the contained content.
+    // To update the code, use tools/update_characteristics.py
+    /* <characteristics-start ccgetvalue> */
+    case SUSPENSION_STIFFNESS:
+        return &values->m_suspension_stiffness;
+    case SUSPENSION_REST:
+        return &values->m_suspension_rest;
+    case SUSPENSION_TRAVEL:
+        return &values->m_suspension_travel;
+    case SUSPENSION_EXP_SPRING_RESPONSE:
+        return &values->m_suspension_exp_spring_response;
+    case SUSPENSION_MAX_FORCE:
+        return &values->m_suspension_max_force;
+    case STABILITY_ROLL_INFLUENCE:
+        return &values->m_stability_roll_influence;
+    case STABILITY_CHASSIS_LINEAR_DAMPING:
+        return &values->m_stability_chassis_linear_damping;
+    case STABILITY_CHASSIS_ANGULAR_DAMPING:
+        return &values->m_stability_chassis_angular_damping;
+    case STABILITY_DOWNWARD_IMPULSE_FACTOR:
+        return &values->m_stability_downward_impulse_factor;
+    case STABILITY_TRACK_CONNECTION_ACCEL:
+        return &values->m_stability_track_connection_accel;
+    case STABILITY_ANGULAR_FACTOR:
+        return &values->m_stability_angular_factor;
+    case STABILITY_SMOOTH_FLYING_IMPULSE:
+        return &values->m_stability_smooth_flying_impulse;
+    case TURN_RADIUS:
+        return &values->m_turn_radius;
+    case TURN_TIME_RESET_STEER:
+        return &values->m_turn_time_reset_steer;
+    case TURN_TIME_FULL_STEER:
+        return &values->m_turn_time_full_steer;
+    case ENGINE_POWER:
+        return &values->m_engine_power;
+    case ENGINE_MAX_SPEED:
+        return &values->m_engine_max_speed;
+    case ENGINE_GENERIC_MAX_SPEED:
+        return &values->m_engine_generic_max_speed;
+    case ENGINE_BRAKE_FACTOR:
+        return &values->m_engine_brake_factor;
+    case ENGINE_BRAKE_TIME_INCREASE:
+        return &values->m_engine_brake_time_increase;
+    case ENGINE_MAX_SPEED_REVERSE_RATIO:
+        return &values->m_engine_max_speed_reverse_ratio;
+    case GEAR_SWITCH_RATIO:
+        return &values->m_gear_switch_ratio;
+    case GEAR_POWER_INCREASE:
+        return &values->m_gear_power_increase;
+    case MASS:
+        return &values->m_mass;
+    case WHEELS_DAMPING_RELAXATION:
+        return &values->m_wheels_damping_relaxation;
+    case WHEELS_DAMPING_COMPRESSION:
+        return &values->m_wheels_damping_compression;
+    case CAMERA_DISTANCE:
+        return &values->m_camera_distance;
+    case CAMERA_FORWARD_UP_ANGLE:
+        return &values->m_camera_forward_up_angle;
+    case CAMERA_BACKWARD_UP_ANGLE:
+        return &values->m_camera_backward_up_angle;
+    case JUMP_ANIMATION_TIME:
+        return &values->m_jump_animation_time;
+    case LEAN_MAX:
+        return &values->m_lean_max;
+    case LEAN_SPEED:
+        return &values->m_lean_speed;
+    case ANVIL_DURATION:
+        return &values->m_anvil_duration;
+    case ANVIL_WEIGHT:
+        return &values->m_anvil_weight;
+    case ANVIL_SPEED_FACTOR:
+        return &values->m_anvil_speed_factor;
+    case PARACHUTE_FRICTION:
+        return &values->m_parachute_friction;
+    case PARACHUTE_DURATION:
+        return &values->m_parachute_duration;
+    case PARACHUTE_DURATION_OTHER:
+        return &values->m_parachute_duration_other;
+    case PARACHUTE_DURATION_RANK_MULT:
+        return &values->m_parachute_duration_rank_mult;
+    case PARACHUTE_DURATION_SPEED_MULT:
+        return &values->m_parachute_duration_speed_mult;
+    case PARACHUTE_LBOUND_FRACTION:
+        return &values->m_parachute_lbound_fraction;
+    case PARACHUTE_UBOUND_FRACTION:
+        return &values->m_parachute_ubound_fraction;
+    case PARACHUTE_MAX_SPEED:
+        return &values->m_parachute_max_speed;
+    case FRICTION_KART_FRICTION:
+        return &values->m_friction_kart_friction;
+    case BUBBLEGUM_DURATION:
+        return &values->m_bubblegum_duration;
+    case BUBBLEGUM_SPEED_FRACTION:
+        return &values->m_bubblegum_speed_fraction;
+    case BUBBLEGUM_TORQUE:
+        return &values->m_bubblegum_torque;
+    case BUBBLEGUM_FADE_IN_TIME:
+        return &values->m_bubblegum_fade_in_time;
+    case BUBBLEGUM_SHIELD_DURATION:
+        return &values->m_bubblegum_shield_duration;
+    case ZIPPER_DURATION:
+        return &values->m_zipper_duration;
+    case ZIPPER_FORCE:
+        return &values->m_zipper_force;
+    case ZIPPER_SPEED_GAIN:
+        return &values->m_zipper_speed_gain;
+    case ZIPPER_MAX_SPEED_INCREASE:
+        return &values->m_zipper_max_speed_increase;
+    case ZIPPER_FADE_OUT_TIME:
+        return &values->m_zipper_fade_out_time;
+    case SWATTER_DURATION:
+        return &values->m_swatter_duration;
+    case SWATTER_DISTANCE:
+        return &values->m_swatter_distance;
+    case SWATTER_SQUASH_DURATION:
+        return &values->m_swatter_squash_duration;
+    case SWATTER_SQUASH_SLOWDOWN:
+        return &values->m_swatter_squash_slowdown;
+    case PLUNGER_BAND_MAX_LENGTH:
+        return &values->m_plunger_band_max_length;
+    case PLUNGER_BAND_FORCE:
+        return &values->m_plunger_band_force;
+    case PLUNGER_BAND_DURATION:
+        return &values->m_plunger_band_duration;
+    case PLUNGER_BAND_SPEED_INCREASE:
+        return &values->m_plunger_band_speed_increase;
+    case PLUNGER_BAND_FADE_OUT_TIME:
+        return &values->m_plunger_band_fade_out_time;
+    case PLUNGER_IN_FACE_TIME:
+        return &values->m_plunger_in_face_time;
+    case STARTUP_TIME:
+        return &values->m_startup_time;
+    case STARTUP_BOOST:
+        return &values->m_startup_boost;
+    case RESCUE_DURATION:
+        return &values->m_rescue_duration;
+    case RESCUE_VERT_OFFSET:
+        return &values->m_rescue_vert_offset;
+    case RESCUE_HEIGHT:
+        return &values->m_rescue_height;
+    case EXPLOSION_DURATION:
+        return &values->m_explosion_duration;
+    case EXPLOSION_RADIUS:
+        return &values->m_explosion_radius;
+    case EXPLOSION_INVULNERABILITY_TIME:
+        return &values->m_explosion_invulnerability_time;
+    case NITRO_DURATION:
+        return &values->m_nitro_duration;
+    case NITRO_ENGINE_FORCE:
+        return &values->m_nitro_engine_force;
+    case NITRO_ENGINE_MULT:
+        return &values->m_nitro_engine_mult;
+    case NITRO_CONSUMPTION:
+        return &values->m_nitro_consumption;
+    case NITRO_SMALL_CONTAINER:
+        return &values->m_nitro_small_container;
+    case NITRO_BIG_CONTAINER:
+        return &values->m_nitro_big_container;
+    case NITRO_MAX_SPEED_INCREASE:
+        return &values->m_nitro_max_speed_increase;
+    case NITRO_FADE_OUT_TIME:
+        return &values->m_nitro_fade_out_time;
+    case NITRO_MAX:
+        return &values->m_nitro_max;
+    case SLIPSTREAM_DURATION_FACTOR:
+        return &values->m_slipstream_duration_factor;
+    case SLIPSTREAM_BASE_SPEED:
+        return &values->m_slipstream_base_speed;
+    case SLIPSTREAM_LENGTH:
+        return &values->m_slipstream_length;
+    case SLIPSTREAM_WIDTH:
+        return &values->m_slipstream_width;
+    case SLIPSTREAM_INNER_FACTOR:
+        return &values->m_slipstream_inner_factor;
+    case SLIPSTREAM_MIN_COLLECT_TIME:
+        return &values->m_slipstream_min_collect_time;
+    case SLIPSTREAM_MAX_COLLECT_TIME:
+        return &values->m_slipstream_max_collect_time;
+    case SLIPSTREAM_ADD_POWER:
+        return &values->m_slipstream_add_power;
+    case SLIPSTREAM_MIN_SPEED:
+        return &values->m_slipstream_min_speed;
+    case SLIPSTREAM_MAX_SPEED_INCREASE:
+        return &values->m_slipstream_max_speed_increase;
+    case SLIPSTREAM_FADE_OUT_TIME:
+        return &values->m_slipstream_fade_out_time;
+    case SKID_INCREASE:
+        return &values->m_skid_increase;
+    case SKID_DECREASE:
+        return &values->m_skid_decrease;
+    case SKID_MAX:
+        return &values->m_skid_max;
+    case SKID_TIME_TILL_MAX:
+        return &values->m_skid_time_till_max;
+    case SKID_VISUAL:
+        return &values->m_skid_visual;
+    case SKID_VISUAL_TIME:
+        return &values->m_skid_visual_time;
+    case SKID_REVERT_VISUAL_TIME:
+        return &values->m_skid_revert_visual_time;
+    case SKID_MIN_SPEED:
+        return &values->m_skid_min_speed;
+    case SKID_TIME_TILL_BONUS:
+        return &values->m_skid_time_till_bonus;
+    case SKID_BONUS_SPEED:
+        return &values->m_skid_bonus_speed;
+    case SKID_BONUS_TIME:
+        return &values->m_skid_bonus_time;
+    case SKID_BONUS_FORCE:
+        return &values->m_skid_bonus_force;
+    case SKID_PHYSICAL_JUMP_TIME:
+        return &values->m_skid_physical_jump_time;
+    case SKID_GRAPHICAL_JUMP_TIME:
+        return &values->m_skid_graphical_jump_time;
+    case SKID_POST_SKID_ROTATE_FACTOR:
+        return &values->m_skid_post_skid_rotate_factor;
+    case SKID_REDUCE_TURN_MIN:
+        return &values->m_skid_reduce_turn_min;
+    case SKID_REDUCE_TURN_MAX:
+        return &values->m_skid_reduce_turn_max;
+    case SKID_ENABLED:
+        return &values->m_skid_enabled;
+    /* <characteristics-end ccgetvalue> */
+    case CHARACTERISTIC_COUNT:
+        break;
     }
-}   // ~CachedCharacteristic
+    Log::fatal("CachedCharacteristic::getValue", "Unknown type");
+    return &values->m_suspension_stiffness;
+}   // getValue
 
 // ----------------------------------------------------------------------------
 /** Recompute the values of all characteristics based on the list of
- *  source-characteristics.
+ *  source-characteristics. All characteristics must be set by the source
+ *  (the base characteristic sets all of them), since the values are read
+ *  without checking them afterwards.
  */
 void CachedCharacteristic::updateSource()
 {
+    m_values = Values();
     for (int i = 0; i < CHARACTERISTIC_COUNT; i++)
     {
-        SaveValue &v = m_values[i];
-        
+        const CharacteristicType type = static_cast<CharacteristicType>(i);
         bool is_set = false;
-        switch (getType(static_cast<CharacteristicType>(i)))
-        {
-        case TYPE_FLOAT:
-        {
-            float value;
-            float *ptr = static_cast<float*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    float *newPtr = new float();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_FLOAT_VECTOR:
-        {
-            std::vector<float> value;
-            std::vector<float> *ptr = static_cast<std::vector<float>*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    std::vector<float> *newPtr = new std::vector<float>();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_INTERPOLATION_ARRAY:
-        {
-            InterpolationArray value;
-            InterpolationArray *ptr = static_cast<InterpolationArray*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    InterpolationArray *newPtr = new InterpolationArray();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_BOOL:
+        m_origin->process(type, getValue(&m_values, type), &is_set);
+        if (!is_set)
         {
-            bool value;
-            bool *ptr = static_cast<bool*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    bool *newPtr = new bool();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
+            Log::fatal("CachedCharacteristic", "Can't get characteristic %s",
+                       getName(type).c_str());
         }
-        }   // switch (type)
     }   // foreach characteristic
 }   // updateSource
 
@@ -179,25 +299,114 @@ void CachedCharacteristic::updateSource()
 void CachedCharacteristic::process(CharacteristicType type, Value value,
                                    bool *is_set) const
 {
-    void *v = m_values[type].content;
-    if (v)
+    // getValue only returns a pointer into the values, they are not changed
+    Value v = getValue(const_cast<Values*>(&m_values), type);
+    switch (getType(type))
+    {
+    case TYPE_FLOAT:
+        *value.f = *v.f;
+        break;
+    case TYPE_FLOAT_VECTOR:
+        *value.fv = *v.fv;
+        break;
+    case TYPE_INTERPOLATION_ARRAY:
+        *value.ia = *v.ia;
+        break;
+    case TYPE_BOOL:
+        *value.b = *v.b;
+        break;
+    }
+    *is_set = true;
+}   // process
+
+// ----------------------------------------------------------------------------
+/** Compares the time to read the characteristics that are used in each
+ *  update of a kart (Kart::update, MaxSpeed and Skidding) for 16 karts
+ *  through the process function of the cached characteristic (as all
+ *  KartProperties getters did before) and through the cached values that
+ *  are used by the KartProperties getters now. Both must give the same
+ *  result. The loaded karts must be available.
+ */
+void CachedCharacteristic::benchmark()
+{
+    const int NUM_KARTS  = 16;
+    const int ITERATIONS = 20000;
+    if (kart_properties_manager->getNumberOfKarts() == 0)
+    {
+        Log::warn("CachedCharacteristic", "No karts loaded, skipping the "
+                  "benchmark.");
+        return;
+    }
+
+    std::vector<std::unique_ptr<KartProperties> > kps;
+    std::vector<std::unique_ptr<CachedCharacteristic> > cached;
+    for (int i = 0; i < NUM_KARTS; i++)
+    {
+        const KartProperties *source = kart_properties_manager->getKartById(
+            i % kart_properties_manager->getNumberOfKarts());
+        kps.emplace_back(new KartProperties());
+        kps.back()->copyForPlayer(source, HANDICAP_NONE);
+        cached.emplace_back(new CachedCharacteristic(
+            kps.back()->getCombinedCharacteristic()));
+    }
+
+    float process_sum = 0.0f;
+    double start = StkTime::getRealTime();
+    for (int n = 0; n < ITERATIONS; n++)
     {
-        switch (getType(type))
+        const float speed = (float)(n % 30);
+        const float steer = (float)(n % 21) * 0.1f - 1.0f;
+        for (int i = 0; i < NUM_KARTS; i++)
         {
-        case TYPE_FLOAT:
-            *value.f = *static_cast<float*>(v);
-            break;
-        case TYPE_FLOAT_VECTOR:
-            *value.fv = *static_cast<std::vector<float>*>(v);
-            break;
-        case TYPE_INTERPOLATION_ARRAY:
-            *value.ia = *static_cast<InterpolationArray*>(v);
-            break;
-        case TYPE_BOOL:
-            *value.b = *static_cast<bool*>(v);
-            break;
+            const CachedCharacteristic *c = cached[i].get();
+            process_sum += c->getEngineMaxSpeed() + c->getEnginePower()
+                + c->getEngineBrakeFactor()
+                + c->getStabilityChassisLinearDamping()
+                + c->getStabilityChassisAngularDamping()
+                + c->getTurnRadius().get(speed)
+                + c->getTurnTimeFullSteer().get(steer)
+                + c->getSkidVisual() + c->getSkidMinSpeed()
+                + c->getSkidReduceTurnMin() + c->getSkidReduceTurnMax()
+                + c->getSkidTimeTillBonus()[0] + c->getSkidBonusSpeed()[0]
+                + c->getNitroConsumption() + c->getZipperMaxSpeedIncrease()
+                + c->getSlipstreamMaxSpeedIncrease()
+                + (c->getSkidEnabled() ? 1.0f : 0.0f);
         }
-        *is_set = true;
     }
-}   // process
+    const double process_time = StkTime::getRealTime() - start;
+
+    float values_sum = 0.0f;
+    start = StkTime::getRealTime();
+    for (int n = 0; n < ITERATIONS; n++)
+    {
+        const float speed = (float)(n % 30);
+        const float steer = (float)(n % 21) * 0.1f - 1.0f;
+        for (int i = 0; i < NUM_KARTS; i++)
+        {
+            const KartProperties *kp = kps[i].get();
+            values_sum += kp->getEngineMaxSpeed() + kp->getEnginePower()
+                + kp->getEngineBrakeFactor()
+                + kp->getStabilityChassisLinearDamping()
+                + kp->getStabilityChassisAngularDamping()
+                + kp->getTurnRadius().get(speed)
+                + kp->getTurnTimeFullSteer().get(steer)
+                + kp->getSkidVisual() + kp->getSkidMinSpeed()
+                + kp->getSkidReduceTurnMin() + kp->getSkidReduceTurnMax()
+                + kp->getSkidTimeTillBonus()[0] + kp->getSkidBonusSpeed()[0]
+                + kp->getNitroConsumption() + kp->getZipperMaxSpeedIncrease()
+                + kp->getSlipstreamMaxSpeedIncrease()
+                + (kp->getSkidEnabled() ? 1.0f : 0.0f);
+        }
+    }
+    const double values_time = StkTime::getRealTime() - start;
 
+    if (process_sum != values_sum)
+    {
+        Log::error("CachedCharacteristic", "Characteristics differ: %f %f.",
+                   process_sum, values_sum);
+    }
+    Log::info("CachedCharacteristic", "Characteristics of %d karts per "
+              "update: %f us with process, %f us with cached values.",
+              NUM_KARTS, process_time * 1000000.0 / ITERATIONS,
+              values_time * 1000000.0 / ITERATIONS);
+}   // benchmark
@@ -68,7 +68,7 @@ protected:
 
     void         setControllerName(const std::string &name) OVERRIDE;
     float        steerToPoint(const Vec3 &point);
-    float        normalizeAngle(float angle);
+    static float normalizeAngle(float angle);
     // ------------------------------------------------------------------------
     /** This can be called to detect if the kart is stuck (i.e. repeatedly
     *  hitting part of the track). */
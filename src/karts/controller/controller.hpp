@@ -62,6 +62,11 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (int ticks) = 0;
+    /** Called before any kart is updated, possibly from several threads at
+     *  the same time. It can be used to do expensive queries in advance,
+     *  which must only read the world state (see
+     *  AbstractKart::prepareUpdate). */
+    virtual void  prepareUpdate      (int ticks) {}
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const ItemState &item,
                                       float previous_energy=0) = 0;
@@ -57,19 +57,34 @@ bool NetworkAIController::isLocalPlayerController() const
     return NetworkConfig::get()->isNetworkAIInstance();
 }   // isLocalPlayerController
 
+// ----------------------------------------------------------------------------
+/** Returns if the AI makes a new decision in this time step. The AI is only
+ *  used every m_ai_frequency ticks, and not when rewinding (the actions
+ *  sent to the server are replayed then).
+ */
+bool NetworkAIController::isAIUpdated() const
+{
+    return !RewindManager::get()->isRewinding() &&
+        (World::getWorld()->isStartPhase() ||
+         World::getWorld()->getTicksSinceStart() > m_prev_update_ticks);
+}   // isAIUpdated
+
+// ----------------------------------------------------------------------------
+void NetworkAIController::prepareUpdate(int ticks)
+{
+    if (isAIUpdated())
+        m_ai_controller->prepareUpdate(m_ai_frequency);
+}   // prepareUpdate
+
 // ----------------------------------------------------------------------------
 void NetworkAIController::update(int ticks)
 {
-    if (!RewindManager::get()->isRewinding())
+    if (isAIUpdated())
     {
-        if (World::getWorld()->isStartPhase() ||
-            World::getWorld()->getTicksSinceStart() > m_prev_update_ticks)
-        {
-            m_prev_update_ticks = World::getWorld()->getTicksSinceStart() +
-                m_ai_frequency;
-            m_ai_controller->update(m_ai_frequency);
-            convertAIToPlayerActions();
-        }
+        m_prev_update_ticks = World::getWorld()->getTicksSinceStart() +
+            m_ai_frequency;
+        m_ai_controller->update(m_ai_frequency);
+        convertAIToPlayerActions();
     }
     PlayerController::update(ticks);
 }   // update
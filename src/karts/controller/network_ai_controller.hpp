@@ -32,10 +32,12 @@ private:
     AIBaseController* m_ai_controller;
     KartControl* m_ai_controls;
     void convertAIToPlayerActions();
+    bool isAIUpdated() const;
 public:
                  NetworkAIController(AbstractKart *kart, int local_player_id,
                                      AIBaseController* ai);
     virtual     ~NetworkAIController();
+    virtual void prepareUpdate(int ticks) OVERRIDE;
     virtual void update(int ticks) OVERRIDE;
     virtual void reset() OVERRIDE;
     // ------------------------------------------------------------------------
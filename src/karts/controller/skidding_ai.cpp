@@ -177,6 +177,7 @@ void SkiddingAI::reset()
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
     m_burster                    = false;
+    m_prepared_aim               = false;
 
     AIBaseLapController::reset();
     m_track_node               = Graph::UNKNOWN_SECTOR;
@@ -215,6 +216,31 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
     return m_successor_index[index];
 }   // getNextSector
 
+//-----------------------------------------------------------------------------
+/** Computes the point to aim at in advance, which is the most expensive
+ *  part of handleSteering(). This only reads the drive graph, so it can be
+ *  done for all karts in parallel. It uses the position the kart will get
+ *  from the physics, and the result is only used if the kart is really at
+ *  that position and on the same graph node when handleSteering() is
+ *  called.
+ *  \param ticks Number of physics time steps - should be 1.
+ */
+void SkiddingAI::prepareUpdate(int ticks)
+{
+    m_prepared_aim = false;
+    if (m_kart->getKartAnimation() || m_world->isStartPhase() ||
+        m_point_selection_algorithm != PSA_DEFAULT ||
+        m_track_node == Graph::UNKNOWN_SECTOR)
+        return;
+
+    m_prepared_ticks      = m_world->getTicksSinceStart();
+    m_prepared_xyz        = m_kart->getPhysicsTrans().getOrigin();
+    m_prepared_track_node = m_track_node;
+    findNonCrashingPoint(m_prepared_xyz, m_prepared_track_node,
+                         &m_prepared_aim_point, &m_prepared_last_node);
+    m_prepared_aim = true;
+}   // prepareUpdate
+
 //-----------------------------------------------------------------------------
 /** This is the main entry point for the AI.
  *  It is called once per frame for each AI and determines the behaviour of
@@ -471,9 +497,30 @@ void SkiddingAI::handleSteering(float dt)
         {
         case PSA_NEW:    findNonCrashingPointNew(&aim_point, &last_node);
                          break;
-        case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
-                         break;
+        case PSA_DEFAULT:
+            if (m_prepared_aim &&
+                m_prepared_ticks == m_world->getTicksSinceStart() &&
+                m_prepared_xyz == m_kart->getXYZ() &&
+                m_prepared_track_node == m_track_node)
+            {
+                aim_point = m_prepared_aim_point;
+                last_node = m_prepared_last_node;
+            }
+            else
+            {
+                findNonCrashingPoint(m_kart->getXYZ(), m_track_node,
+                                     &aim_point, &last_node);
+            }
+            m_prepared_aim = false;
+            break;
         }
+#ifdef AI_DEBUG_KART_HEADING
+        const Vec3 eps(0,0.5f,0);
+        m_curve[CURVE_KART]->clear();
+        m_curve[CURVE_KART]->addPoint(m_kart->getXYZ()+eps);
+        Vec3 forw(0, 0, 50);
+        m_curve[CURVE_KART]->addPoint(m_kart->getTrans()(forw)+eps);
+#endif
 #ifdef AI_DEBUG
         m_debug_sphere[m_point_selection_algorithm]->setPosition(aim_point.toIrrVector());
 #endif
@@ -2674,21 +2721,18 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
  *  which takes some time - so it is actually mostly on track.
  *  Since this algoritm (so far) ends up with by far the best AI behaviour,
  *  it is for now the default).
+ *  \param xyz The position of the kart.
+ *  \param track_node The graph node the kart is on.
  *  \param aim_position On exit contains the point the AI should aim at.
  *  \param last_node On exit contais the graph node the AI is aiming at.
 */
- void SkiddingAI::findNonCrashingPoint(Vec3 *aim_position, int *last_node)
+ void SkiddingAI::findNonCrashingPoint(const Vec3 &xyz, int track_node,
+                                       Vec3 *aim_position,
+                                       int *last_node) const
 {
-#ifdef AI_DEBUG_KART_HEADING
-    const Vec3 eps(0,0.5f,0);
-    m_curve[CURVE_KART]->clear();
-    m_curve[CURVE_KART]->addPoint(m_kart->getXYZ()+eps);
-    Vec3 forw(0, 0, 50);
-    m_curve[CURVE_KART]->addPoint(m_kart->getTrans()(forw)+eps);
-#endif
-    *last_node = m_next_node_index[m_track_node];
-    float angle = DriveGraph::get()->getAngleToNext(m_track_node,
-                                              m_successor_index[m_track_node]);
+    *last_node = m_next_node_index[track_node];
+    float angle = DriveGraph::get()->getAngleToNext(track_node,
+                                              m_successor_index[track_node]);
 
     Vec3 direction;
     Vec3 step_track_coord;
@@ -2716,7 +2760,7 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
 
         //direction is a vector from our kart to the sectors we are testing
         direction = DriveGraph::get()->getNode(target_sector)->getCenter()
-                  - m_kart->getXYZ();
+                  - xyz;
 
         float len=direction.length();
         unsigned int steps = (unsigned int)( len / m_kart_length );
@@ -2736,7 +2780,7 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
         //Test if we crash if we drive towards the target sector
         for(unsigned int i = 2; i < steps; ++i )
         {
-            step_coord = m_kart->getXYZ()+direction*m_kart_length * float(i);
+            step_coord = xyz+direction*m_kart_length * float(i);
 
             DriveGraph::get()->spatialToTrack(&step_track_coord, step_coord,
                                              *last_node );
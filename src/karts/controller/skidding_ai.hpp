@@ -235,6 +235,17 @@ private:
     enum {PSA_DEFAULT, PSA_NEW}
           m_point_selection_algorithm;
 
+    /** Set by prepareUpdate() if findNonCrashingPoint() was done in advance,
+     *  and the time step it was done in. */
+    bool  m_prepared_aim;
+    int   m_prepared_ticks;
+    /** The kart position and graph node findNonCrashingPoint() was called
+     *  with in prepareUpdate(), and its results. */
+    Vec3  m_prepared_xyz;
+    int   m_prepared_track_node;
+    Vec3  m_prepared_aim_point;
+    int   m_prepared_last_node;
+
     ItemManager* m_item_manager;
 #ifdef AI_DEBUG
     /** For skidding debugging: shows the estimated turn shape. */
@@ -288,7 +299,8 @@ private:
 
     void  checkCrashes(const Vec3& pos);
     void  findNonCrashingPointNew(Vec3 *result, int *last_node);
-    void  findNonCrashingPoint(Vec3 *result, int *last_node);
+    void  findNonCrashingPoint(const Vec3 &xyz, int track_node,
+                               Vec3 *result, int *last_node) const;
 
     void  determineTrackDirection();
     virtual bool canSkid(float steer_fraction);
@@ -301,6 +313,7 @@ protected:
 public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
+    virtual void prepareUpdate(int ticks) OVERRIDE;
     virtual void update      (int ticks);
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
@@ -101,6 +101,9 @@ public:
     virtual void kartIsInRestNow() OVERRIDE {}
     // ------------------------------------------------------------------------
     virtual void makeKartRest() OVERRIDE {}
+    // ------------------------------------------------------------------------
+    /** Ghost karts do not query the terrain and have no AI. */
+    virtual void prepareUpdate(int ticks) OVERRIDE {}
 };   // GhostKart
 #endif
 
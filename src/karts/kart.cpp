@@ -1338,6 +1338,45 @@ void Kart::eliminate()
         m_node->setVisible(false);
 }   // eliminate
 
+//-----------------------------------------------------------------------------
+/** Returns the start point of the raycast which detects the terrain under
+ *  the kart, see update().
+ *  \param trans The transform of the kart.
+ */
+Vec3 Kart::getTerrainRayOrigin(const btTransform &trans) const
+{
+    Vec3 from(0.0f, 0.0f, 0.0f);
+    for (unsigned int i = 0; i < 4; i++)
+        from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
+
+    // Add a certain epsilon (0.3) to the height of the kart. This avoids
+    // problems of the ray being cast from under the track (which happened
+    // e.g. on tux tollway when jumping down from the ramp, when the chassis
+    // partly tunnels through the track). While tunneling should not be
+    // happening (since Z velocity is clamped), the epsilon is left in place
+    // just to be on the safe side (it will not hit the chassis itself).
+    return from/4 + (trans.getBasis() * Vec3(0.0f, 0.3f, 0.0f));
+}   // getTerrainRayOrigin
+
+//-----------------------------------------------------------------------------
+/** Does the expensive queries of update() in advance, see
+ *  AbstractKart::prepareUpdate(). The terrain raycast is done with the
+ *  transform that Moveable::update() will take from the physics. If anything
+ *  moves the kart before that (e.g. an animation), update() notices the
+ *  different ray and casts it again.
+ *  \param ticks Number of physics time steps - should be 1.
+ */
+void Kart::prepareUpdate(int ticks)
+{
+    if (!m_kart_animation)
+    {
+        const btTransform trans = getPhysicsTrans();
+        m_terrain_info->prepareUpdate(trans.getBasis(),
+                                      getTerrainRayOrigin(trans));
+    }
+    m_controller->prepareUpdate(ticks);
+}   // prepareUpdate
+
 //-----------------------------------------------------------------------------
 /** Updates the kart in each time step. It updates the physics setting,
  *  particle effects, camera position, etc.
@@ -1538,19 +1577,8 @@ void Kart::update(int ticks)
 
     if (!has_animation_before)
     {
-        Vec3 from(0.0f, 0.0f, 0.0f);
-        for (unsigned int i = 0; i < 4; i++)
-            from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
-
-        // Add a certain epsilon (0.3) to the height of the kart. This avoids
-        // problems of the ray being cast from under the track (which happened
-        // e.g. on tux tollway when jumping down from the ramp, when the chassis
-        // partly tunnels through the track). While tunneling should not be
-        // happening (since Z velocity is clamped), the epsilon is left in place
-        // just to be on the safe side (it will not hit the chassis itself).
-        from = from/4 + (getTrans().getBasis() * Vec3(0.0f, 0.3f, 0.0f));
-
-        m_terrain_info->update(getTrans().getBasis(), from);
+        m_terrain_info->update(getTrans().getBasis(),
+                               getTerrainRayOrigin(getTrans()));
     }
     else
     {
@@ -283,6 +283,7 @@ protected:
     void          updateEnginePowerAndBrakes(int ticks);
     void          updateEngineSFX(float dt);
     void          updateSpeed();
+    Vec3          getTerrainRayOrigin(const btTransform &trans) const;
     void          updateNitro(int ticks);
     float         applyAirFriction (float engine_power);
     float         getActualWheelForce();
@@ -325,6 +326,7 @@ public:
     virtual void   crashed          (AbstractKart *k, bool update_attachments) OVERRIDE;
     virtual void   crashed          (const Material *m, const Vec3 &normal) OVERRIDE;
     virtual float  getHoT           () const OVERRIDE;
+    virtual void   prepareUpdate    (int ticks) OVERRIDE;
     virtual void   update           (int ticks) OVERRIDE;
     virtual void   finishedRace     (float time, bool from_server=false) OVERRIDE;
     virtual void   setPosition      (int p) OVERRIDE;
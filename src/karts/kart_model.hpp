@@ -361,6 +361,11 @@ public:
     scene::IAnimatedMesh*
                   getModel() const { return m_mesh; }
 
+    // ------------------------------------------------------------------------
+    /** Returns the file name of the kart model (relative to the kart
+     *  directory). */
+    const std::string& getModelFilename() const { return m_model_filename; }
+
     // ------------------------------------------------------------------------
     /** Returns the mesh of the wheel for this kart. */
     scene::IMesh* getWheelModel(const int i) const
@@ -19,6 +19,7 @@
 #ifndef HEADER_KART_PROPERTIES_HPP
 #define HEADER_KART_PROPERTIES_HPP
 
+#include <cassert>
 #include <memory>
 #include <string>
 #include <vector>
@@ -84,6 +85,14 @@ private:
      *  the kart_properties object is const. */
     mutable std::shared_ptr<KartModel> m_kart_model;
 
+    /** True once the models of the kart were loaded. At startup only the
+     *  kart.xml file is read, the models are loaded when the kart is first
+     *  used (see loadModels). */
+    mutable bool m_models_loaded;
+
+    /** True if loading the models failed, so that it is not tried again. */
+    mutable bool m_models_failed;
+
     /** List of all groups the kart belongs to. */
     std::vector<std::string> m_groups;
 
@@ -114,7 +123,8 @@ private:
                                        *   for this kart.*/
     float m_shadow_z_offset;          /**< Z offset of the shadow plane
                                        *   for this kart.*/
-    Material* m_shadow_material;      /**< The texture with the shadow. */
+    mutable Material* m_shadow_material; /**< The texture with the shadow.
+                                          *   Set in loadModels. */
     video::SColor m_color;            /**< Color the represents the kart in the
                                        *   status bar and on the track-view. */
     int  m_shape;                     /**< Number of vertices in polygon when
@@ -160,8 +170,9 @@ private:
      *  chassis. Useful for karts that don't have enough space for suspension
      *  compression. */
     float       m_graphical_y_offset;
-    /** Wheel base of the kart. */
-    float       m_wheel_base;
+    /** Wheel base of the kart. It depends on the length of the model, so it
+     *  is computed in loadModels. */
+    mutable float m_wheel_base;
 
     /** The maximum roll a kart graphics should show when driving in a fast
      *  curve. This is read in as degrees, but stored in radians. */
@@ -178,8 +189,9 @@ private:
     // -------------------
     float m_friction_slip;
 
-    /** Shift of center of gravity. */
-    Vec3  m_gravity_center_shift;
+    /** Shift of center of gravity. If not defined in the kart.xml file it
+     *  depends on the size of the model and is computed in loadModels. */
+    mutable Vec3 m_gravity_center_shift;
 
 public:
     /** STK can add an impulse to push karts away from the track in case
@@ -207,18 +219,21 @@ private:
     InterpolationArray m_restitution;
 
     void  load              (const std::string &filename,
-                             const std::string &node);
+                             const std::string &node,
+                             const XMLNode *root = NULL);
     void combineCharacteristics(HandicapLevel h);
 
 public:
     /** Returns the string representation of a handicap level. */
     static std::string      getHandicapAsString(HandicapLevel h);
 
-          KartProperties    (const std::string &filename="");
+          KartProperties    (const std::string &filename="",
+                             const XMLNode *root = NULL);
          ~KartProperties    ();
     void  copyForPlayer     (const KartProperties *source,
                              HandicapLevel h = HANDICAP_NONE);
     void  copyFrom          (const KartProperties *source);
+    bool  loadModels        () const;
     void  getAllData        (const XMLNode * root);
     void  checkAllSet       (const std::string &filename);
     bool  isInGroup         (const std::string &group) const;
@@ -247,7 +262,11 @@ public:
     // ------------------------------------------------------------------------
     /** Returns a pointer to the main KartModel object. This copy
      *  should not be modified, not attachModel be called on it. */
-    const KartModel& getMasterKartModel() const {return *m_kart_model;        }
+    const KartModel& getMasterKartModel() const
+    {
+        loadModels();
+        return *m_kart_model;
+    }   // getMasterKartModel
     // ------------------------------------------------------------------------
     void setHatMeshName(const std::string &hat_name);
     // ------------------------------------------------------------------------
@@ -265,7 +284,11 @@ public:
 
     // ------------------------------------------------------------------------
     /** Returns the shadow texture to use. */
-    Material* getShadowMaterial() const           { return m_shadow_material; }
+    Material* getShadowMaterial() const
+    {
+        assert(m_models_loaded);
+        return m_shadow_material;
+    }   // getShadowMaterial
 
     // ------------------------------------------------------------------------
     /** Returns the absolute path of the icon file of this kart. */
@@ -305,12 +328,20 @@ public:
 
     // ------------------------------------------------------------------------
     /** Returns the wheel base (distance front to rear axis). */
-    float getWheelBase              () const {return m_wheel_base;            }
+    float getWheelBase() const
+    {
+        assert(m_models_loaded);
+        return m_wheel_base;
+    }   // getWheelBase
 
     // ------------------------------------------------------------------------
     /** Returns a shift of the center of mass (lowering the center of mass
      *  makes the karts more stable. */
-    const Vec3&getGravityCenterShift() const {return m_gravity_center_shift;  }
+    const Vec3& getGravityCenterShift() const
+    {
+        assert(m_models_loaded);
+        return m_gravity_center_shift;
+    }   // getGravityCenterShift
 
     // ------------------------------------------------------------------------
     /** Returns an artificial impulse to push karts away from the terrain
@@ -382,12 +413,12 @@ public:
     float getStabilityChassisAngularDamping() const;
     float getStabilityDownwardImpulseFactor() const;
     float getStabilityTrackConnectionAccel() const;
-    std::vector<float> getStabilityAngularFactor() const;
+    const std::vector<float>& getStabilityAngularFactor() const;
     float getStabilitySmoothFlyingImpulse() const;
 
-    InterpolationArray getTurnRadius() const;
+    const InterpolationArray& getTurnRadius() const;
     float getTurnTimeResetSteer() const;
-    InterpolationArray getTurnTimeFullSteer() const;
+    const InterpolationArray& getTurnTimeFullSteer() const;
 
     float getEnginePower() const;
     float getEngineMaxSpeed() const;
@@ -396,8 +427,8 @@ public:
     float getEngineBrakeTimeIncrease() const;
     float getEngineMaxSpeedReverseRatio() const;
 
-    std::vector<float> getGearSwitchRatio() const;
-    std::vector<float> getGearPowerIncrease() const;
+    const std::vector<float>& getGearSwitchRatio() const;
+    const std::vector<float>& getGearPowerIncrease() const;
 
     float getMass() const;
 
@@ -452,8 +483,8 @@ public:
     int   getPlungerBandFadeOutTicks() const;
     float getPlungerInFaceTime() const;
 
-    std::vector<float> getStartupTime() const;
-    std::vector<float> getStartupBoost() const;
+    const std::vector<float>& getStartupTime() const;
+    const std::vector<float>& getStartupBoost() const;
 
     float getRescueDuration() const;
     float getRescueVertOffset() const;
@@ -492,10 +523,10 @@ public:
     float getSkidVisualTime() const;
     float getSkidRevertVisualTime() const;
     float getSkidMinSpeed() const;
-    std::vector<float> getSkidTimeTillBonus() const;
-    std::vector<float> getSkidBonusSpeed() const;
-    std::vector<float> getSkidBonusTime() const;
-    std::vector<float> getSkidBonusForce() const;
+    const std::vector<float>& getSkidTimeTillBonus() const;
+    const std::vector<float>& getSkidBonusSpeed() const;
+    const std::vector<float>& getSkidBonusTime() const;
+    const std::vector<float>& getSkidBonusForce() const;
     float getSkidPhysicalJumpTime() const;
     float getSkidGraphicalJumpTime() const;
     float getSkidPostSkidRotateFactor() const;
@@ -149,17 +149,24 @@ void KartPropertiesManager::removeKart(const std::string &ident)
 }   // removeKart
 
 //-----------------------------------------------------------------------------
-/** Loads all kart properties and models.
+/** Loads all kart properties. The kart.xml files are read in parallel,
+ *  the models of a kart are only loaded when the kart is first used
+ *  (see KartProperties::loadModels).
  */
 void KartPropertiesManager::loadAllKarts(bool loading_icon)
 {
     m_all_kart_dirs.clear();
+    std::vector<std::string> kart_dirs;
     std::vector<std::string>::const_iterator dir;
     for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
     {
         // First check if there is a kart in the current directory
         // -------------------------------------------------------
-        if(loadKart(*dir)) continue;
+        if(file_manager->fileExists(*dir + "/kart.xml"))
+        {
+            kart_dirs.push_back(*dir);
+            continue;
+        }
 
         // If not, check each subdir of this directory.
         // --------------------------------------------
@@ -168,17 +175,29 @@ void KartPropertiesManager::loadAllKarts(bool loading_icon)
         for(std::set<std::string>::const_iterator subdir=result.begin();
             subdir!=result.end(); subdir++)
         {
-            const bool loaded = loadKart(*dir+*subdir);
-
-            if (loaded && loading_icon)
-            {
-                GUIEngine::addLoadingIcon(irr_driver->getTexture(
-                    m_karts_properties[m_karts_properties.size()-1]
-                            .getAbsoluteIconFile()              )
-                                          );
-            }
+            if(file_manager->fileExists(*dir + *subdir + "/kart.xml"))
+                kart_dirs.push_back(*dir + *subdir);
         }   // for all files in the currently handled directory
     }   // for i
+
+    std::vector<std::string> config_files;
+    for(unsigned int i=0; i<kart_dirs.size(); i++)
+        config_files.push_back(kart_dirs[i] + "/kart.xml");
+    std::vector<XMLNode*> roots;
+    file_manager->createXMLTrees(config_files, &roots);
+
+    for(unsigned int i=0; i<kart_dirs.size(); i++)
+    {
+        const bool loaded = loadKart(kart_dirs[i], roots[i]);
+
+        if (loaded && loading_icon)
+        {
+            GUIEngine::addLoadingIcon(irr_driver->getTexture(
+                m_karts_properties[m_karts_properties.size()-1]
+                        .getAbsoluteIconFile()              )
+                                      );
+        }
+    }   // for i < kart_dirs.size()
 }   // loadAllKarts
 
 //-----------------------------------------------------------------------------
@@ -239,19 +258,22 @@ void KartPropertiesManager::loadCharacteristics(const XMLNode *root)
 }
 
 //-----------------------------------------------------------------------------
-/** Loads a single kart and (if not disabled) the corresponding 3d model.
- *  \param filename Full path to the kart config file.
+/** Loads the properties of a single kart. The 3d model is loaded when the
+ *  kart is first used.
+ *  \param dir Directory of the kart.
+ *  \param root The already read content of the kart.xml file, or NULL if
+ *         it should be read here. It will be deleted.
  */
-bool KartPropertiesManager::loadKart(const std::string &dir)
+bool KartPropertiesManager::loadKart(const std::string &dir, XMLNode *root)
 {
     std::string config_filename = dir + "/kart.xml";
-    if(!file_manager->fileExists(config_filename))
+    if(!root && !file_manager->fileExists(config_filename))
         return false;
 
     KartProperties* kart_properties;
     try
     {
-        kart_properties = new KartProperties(config_filename);
+        kart_properties = new KartProperties(config_filename, root);
     }
     catch (std::runtime_error& err)
     {
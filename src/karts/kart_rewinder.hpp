@@ -40,8 +40,7 @@ public:
     ~KartRewinder() {}
     virtual void saveTransform() OVERRIDE;
     virtual void computeError() OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer) OVERRIDE;
     void reset() OVERRIDE;
     virtual void restoreState(BareNetworkString *p, int count) OVERRIDE;
     virtual void rewindToEvent(BareNetworkString *p) OVERRIDE {}
@@ -73,6 +72,15 @@ public:
     virtual void undoEvent(BareNetworkString *p) OVERRIDE {}
     // ------------------------------------------------------------------------
     virtual std::function<void()> getLocalStateRestoreFunction() OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual bool getInterestPosition(Vec3* xyz) const OVERRIDE
+                                             { *xyz = getXYZ(); return true; }
+    // ------------------------------------------------------------------------
+    virtual void setFrozen(bool frozen) OVERRIDE
+    {
+        Rewinder::setFrozen(frozen);
+        setBodySimulated(!frozen);
+    }
 
 
 };   // Rewinder
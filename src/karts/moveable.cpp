@@ -35,6 +35,7 @@ Moveable::Moveable()
 {
     m_node            = NULL;
     m_heading         = 0;
+    m_saved_activation_state = -1;
 }   // Moveable
 
 //-----------------------------------------------------------------------------
@@ -44,6 +45,30 @@ Moveable::~Moveable()
     if(m_node) irr_driver->removeNode(m_node);
 }   // ~Moveable
 
+//-----------------------------------------------------------------------------
+/** Removes the body from the physics simulation (or adds it back) without
+ *  changing its transform or velocities. A body which is not simulated does
+ *  not move and does not collide with other bodies which are not simulated.
+ *  \param simulated False to disable the simulation of the body.
+ */
+void Moveable::setBodySimulated(bool simulated)
+{
+    if (!m_body)
+        return;
+    if (!simulated)
+    {
+        if (m_saved_activation_state != -1)
+            return;
+        m_saved_activation_state = m_body->getActivationState();
+        m_body->forceActivationState(DISABLE_SIMULATION);
+    }
+    else if (m_saved_activation_state != -1)
+    {
+        m_body->forceActivationState(m_saved_activation_state);
+        m_saved_activation_state = -1;
+    }
+}   // setBodySimulated
+
 //-----------------------------------------------------------------------------
 /** Sets the mesh for this model.
  *  \param n The scene node.
@@ -158,6 +183,19 @@ void Moveable::update(int ticks)
     updatePosition();
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Returns the transform that the next call to update() will set, i.e. the
+ *  position and rotation of the physics body. This can be used to do some
+ *  work before the moveable is actually updated.
+ */
+btTransform Moveable::getPhysicsTrans() const
+{
+    btTransform trans = m_transform;
+    if (m_body->getInvMass() != 0)
+        m_motion_state->getWorldTransform(trans);
+    return trans;
+}   // getPhysicsTrans
+
 //-----------------------------------------------------------------------------
 /** Updates the current position and rotation. This function is also called
  *  by ghost karts for getHeading() to work.
@@ -52,6 +52,9 @@ private:
     float                  m_pitch;
     /** The roll between -180 and 180 degrees. */
     float                  m_roll;
+    /** Activation state of the body before it was removed from the
+     *  simulation, see setBodySimulated. */
+    int                    m_saved_activation_state;
 protected:
     /** The bullet transform of this rigid body. */
     btTransform            m_transform;
@@ -126,7 +129,9 @@ public:
     const btTransform
                  &getTrans() const {return m_transform;}
     void          setTrans(const btTransform& t);
+    btTransform   getPhysicsTrans() const;
     void          updatePosition();
+    void          setBodySimulated(bool simulated);
     // ------------------------------------------------------------------------
     /** Called once per rendered frame. It is used to only update any graphical
      *  effects.
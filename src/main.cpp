@@ -208,6 +208,7 @@
 #include "items/network_item_manager.hpp"
 #include "items/powerup_manager.hpp"
 #include "items/projectile_manager.hpp"
+#include "karts/cached_characteristic.hpp"
 #include "karts/combined_characteristic.hpp"
 #include "karts/controller/ai_base_controller.hpp"
 #include "karts/controller/network_ai_controller.hpp"
@@ -216,6 +217,8 @@
 #include "karts/kart_properties_manager.hpp"
 #include "modes/cutscene_world.hpp"
 #include "modes/demo_world.hpp"
+#include "modes/linear_world.hpp"
+#include "network/delta_network_state.hpp"
 #include "network/protocols/connect_to_server.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/protocols/server_lobby.hpp"
@@ -232,6 +235,8 @@
 #include "network/stk_peer.hpp"
 #include "online/profile_manager.hpp"
 #include "online/request_manager.hpp"
+#include "physics/physics.hpp"
+#include "physics/triangle_mesh.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
@@ -263,6 +268,7 @@
 static void cleanSuperTuxKart();
 static void cleanUserConfig();
 void runUnitTests();
+void runMicroBenchmarks();
 
 // ============================================================================
 //                        gamepad visualisation screen
@@ -591,6 +597,12 @@ void cmdLineHelp()
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --broadphase=name  Physics broadphase to use on all tracks: "
+                              "axis-sweep,\n"
+    "                          axis-sweep-32 or dbvt.\n"
+    "       --no-bvh-cache     Always build the collision BVH of tracks, "
+                              "instead of\n"
+    "                          loading it from the cache.\n"
     "       --unlock-all       Permanently unlock all karts and tracks for testing.\n"
     "       --no-unlock-all    Disable unlock-all (i.e. base unlocking on player achievement).\n"
     "       --no-graphics      Do not display the actual race.\n"
@@ -646,6 +658,16 @@ void cmdLineHelp()
     "       --firewalled-server Turn on all stun related code in server.\n"
     "       --no-firewalled-server Turn off all stun related code in server.\n"
     "       --connection-debug Print verbose info for sending or receiving packets.\n"
+    "       --network-latency=ms Delay all sent packets by ms milliseconds.\n"
+    "       --network-jitter=ms Delay all sent packets by up to ms additional\n"
+    "                          random milliseconds.\n"
+    "       --network-packet-loss=n Drop n percent of the sent unreliable packets.\n"
+    "       --rewind-stats=file Write rewind and bandwidth statistics to file at\n"
+    "                          the end of a network race.\n"
+    "       --rollback-benchmark=file Start a local server, connect to it with the\n"
+    "                          AI of --network-ai, and write the rewind statistics\n"
+    "                          of the race to file (and file.server for the server).\n"
+    "       --benchmark-startup Print the time spent in each phase of the startup.\n"
     "       --no-console-log   Does not write messages in the console but to\n"
     "                          stdout.log.\n"
     "  -h,  --help             Show this help.\n"
@@ -772,6 +794,9 @@ int handleCmdLinePreliminary()
         UserConfigParams::m_verbosity |= UserConfigParams::LOG_ALL;
     if(CommandLine::has("--online"))
         History::m_online_history_replay = true;
+    // Must be known before the startup, which handleCmdLine comes after
+    if(CommandLine::has("--benchmark-startup"))
+        UserConfigParams::m_benchmark_startup = true;
 #if !(defined(SERVER_ONLY) || defined(ANDROID))
     if(CommandLine::has("--apitrace"))
     {
@@ -961,6 +986,8 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     if (CommandLine::has("--unit-testing"))
         UserConfigParams::m_unit_testing = true;
+    if (CommandLine::has("--micro-benchmark"))
+        UserConfigParams::m_micro_benchmark = true;
     if (CommandLine::has("--gamepad-debug"))
         UserConfigParams::m_gamepad_debug=true;
     if (CommandLine::has("--keyboard-debug"))
@@ -1319,6 +1346,17 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         NetworkConfig::get()->setIsPublicServer();
     }
 
+    int latency = 0, jitter = 0, packet_loss = 0;
+    CommandLine::has("--network-latency", &latency);
+    CommandLine::has("--network-jitter", &jitter);
+    CommandLine::has("--network-packet-loss", &packet_loss);
+    latency = std::max(latency, 0);
+    jitter = std::max(jitter, 0);
+    packet_loss = std::min(std::max(packet_loss, 0), 100);
+    NetworkConfig::get()->setSimulatedNetwork(latency, jitter, packet_loss);
+    if (CommandLine::has("--rewind-stats", &s))
+        RewindManager::setStatisticsFile(s);
+
     unsigned server_id = 0;
     if ((NetworkConfig::get()->isServer() && ServerConfig::m_wan_server) ||
         CommandLine::has("--server-id", &server_id))
@@ -1358,6 +1396,50 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     std::string addr;
     bool has_addr = CommandLine::has("--connect-now", &addr);
+    SeparateProcess* benchmark_server = NULL;
+    std::string benchmark_file;
+    if (!has_addr &&
+        CommandLine::has("--rollback-benchmark", &benchmark_file))
+    {
+        if (!CommandLine::has("--network-ai"))
+        {
+            Log::error("Main", "--rollback-benchmark needs --network-ai.");
+            cleanSuperTuxKart();
+            return false;
+        }
+        // The server reports its address in the server id file, it will be
+        // used by ConnectToServer (see STKHost::isClientServer)
+        const std::string server_id_file = "stk-server-id-file_";
+        std::set<std::string> files;
+        file_manager->listFiles(files, file_manager->getUserConfigDir());
+        for (auto& f : files)
+        {
+            if (f.find(server_id_file) != std::string::npos)
+            {
+                file_manager->removeFile(
+                    file_manager->getUserConfigDir() + "/" + f);
+            }
+        }
+        NetworkConfig::get()->setServerIdFile(
+            file_manager->getUserConfigFile(server_id_file));
+        NetworkConfig::get()->setRollbackBenchmark(true);
+        RewindManager::setStatisticsFile(benchmark_file);
+
+        std::ostringstream server_cfg;
+        server_cfg << "--lan-server=rollback-benchmark --no-graphics"
+            " --owner-less --auto-end --stdout=rollback-benchmark-server.log"
+            " --server-id-file=" << server_id_file <<
+            " --rewind-stats=" << benchmark_file << ".server" <<
+            " --network-latency=" << latency <<
+            " --network-jitter=" << jitter <<
+            " --network-packet-loss=" << packet_loss;
+        benchmark_server = new SeparateProcess(
+            SeparateProcess::getCurrentExecutableLocation(),
+            server_cfg.str());
+        // Replaced with the real address by ConnectToServer
+        addr = "127.0.0.1";
+        has_addr = true;
+    }
     if (has_addr)
     {
         NetworkConfig::get()->setIsServer(false);
@@ -1407,7 +1489,7 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         }
         else
             NetworkConfig::get()->setIsLAN();
-        STKHost::create();
+        STKHost::create(benchmark_server);
         if (!GUIEngine::isNoGraphics())
             NetworkingLobby::getInstance()->setJoinedServer(server);
         else if (NetworkConfig::get()->isClient())
@@ -1457,6 +1539,8 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         {
             const KartProperties *km =
                 kart_properties_manager->getKartById(i);
+            if (!km->loadModels())
+                continue;
             Log::info("main", "%s:\t%swidth: %f length: %f height: %f "
                       "mesh-buffer count %d",
                       km->getIdent().c_str(),
@@ -1636,6 +1720,15 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--broadphase", &s))
+    {
+        Log::verbose("main", "Using broadphase '%s'.", s.c_str());
+        Physics::setBroadphaseOverride(s);
+    }   // --broadphase
+
+    if(CommandLine::has("--no-bvh-cache"))
+        TriangleMesh::setUseBvhCache(false);
+
     if(CommandLine::has("--history"))
     {
         history->setReplayHistory(true);
@@ -1740,9 +1833,26 @@ void clearGlobalVariables()
     GUIEngine::resetGlobalVariables();
 }   // clearGlobalVariables
 
+//=============================================================================
+/** Prints the time spent in a phase of the startup (i.e. since the previous
+ *  call, or since stk was started) if --benchmark-startup is used.
+ *  \param phase Name of the phase that was just finished.
+ */
+static void reportStartupPhase(const char *phase)
+{
+    if (!UserConfigParams::m_benchmark_startup)
+        return;
+    static uint64_t last_time = 0;
+    const uint64_t now = StkTime::getMonoTimeMs();
+    Log::info("Startup", "%-28s %6d ms (total %6d ms)", phase,
+              (int)(now - last_time), (int)now);
+    last_time = now;
+}   // reportStartupPhase
+
 //=============================================================================
 void initRest()
 {
+    reportStartupPhase("Before initRest");
     SP::setMaxTextureSize();
     irr_driver = new IrrDriver();
 
@@ -1755,6 +1865,7 @@ void initRest()
 
     // Now create the actual non-null device in the irrlicht driver
     irr_driver->initDevice();
+    reportStartupPhase("Irrlicht device");
 
     // Init GUI
     IrrlichtDevice* device = irr_driver->getDevice();
@@ -1780,6 +1891,7 @@ void initRest()
     input_manager = new InputManager();
     // Get into menu mode initially.
     input_manager->setMode(InputManager::MENU);
+    reportStartupPhase("Fonts and GUI");
 
     stk_config->initMusicFiles();
     // This only initialises the non-network part of the add-ons manager. The
@@ -1808,6 +1920,7 @@ void initRest()
     if (!GUIEngine::isNoGraphics())
         NewsManager::get();   // this will create the news manager
 #endif
+    reportStartupPhase("Shaders, addons and players");
 
     music_manager = new MusicManager();
     SFXManager::create();
@@ -1832,13 +1945,17 @@ void initRest()
     track_manager->addTrackSearchDir(
                  file_manager->getAddonsFile("tracks/"));
 
+    reportStartupPhase("Managers");
+
     {
         XMLNode characteristicsNode(file_manager->getAsset("kart_characteristics.xml"));
         kart_properties_manager->loadCharacteristics(&characteristicsNode);
     }
+    reportStartupPhase("Kart characteristics");
 
     track_manager->loadTrackList();
     music_manager->addMusicToTracks();
+    reportStartupPhase("Track list");
 
     GUIEngine::addLoadingIcon(irr_driver->getTexture(FileManager::GUI_ICON,
                                                      "notes.png"      ) );
@@ -1849,6 +1966,7 @@ void initRest()
     grand_prix_manager->checkConsistency();
     GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                       "cup_gold.png"    ) );
+    reportStartupPhase("Grand prix");
 
     race_manager            = new RaceManager          ();
     // default settings for Quickstart
@@ -1863,7 +1981,7 @@ void initRest()
         UserConfigParams::m_last_track.revertToDefaults();
 
     race_manager->setTrack(UserConfigParams::m_last_track);
-
+    reportStartupPhase("Race manager");
 }   // initRest
 
 //=============================================================================
@@ -2081,6 +2199,7 @@ int main(int argc, char *argv[])
         else
             main_loop = new MainLoop(0/*parent_pid*/);
         material_manager->loadMaterial();
+        reportStartupPhase("Materials");
 
         // Preload the explosion effects (explode.png)
         ParticleKindManager::get()->getParticles("explosion.xml");
@@ -2093,6 +2212,7 @@ int main(int argc, char *argv[])
         kart_properties_manager -> loadAllKarts    ();
         handleXmasMode();
         handleEasterEarMode();
+        reportStartupPhase("Karts");
 
         // Needs the kart and track directories to load potential challenges
         // in those dirs, so it can only be created after reading tracks
@@ -2104,6 +2224,7 @@ int main(int argc, char *argv[])
         // initialise the game slots of all players and the AchievementsManager
         // to initialise the AchievementsStatus, so it is done only now.
         PlayerManager::get()->initRemainingData();
+        reportStartupPhase("Unlocks and achievements");
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                           "gui_lock.png"  ) );
@@ -2136,6 +2257,10 @@ int main(int argc, char *argv[])
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                           "banana.png")    );
+        reportStartupPhase("Item and attachment models");
+        // Save the directories listed during startup, so the next start
+        // does not need to list them again
+        file_manager->saveAssetManifest();
 
         //handleCmdLine() needs InitTuxkart() so it can't be called first
         if (!handleCmdLine(!server_config.empty(), has_parent_process))
@@ -2173,6 +2298,11 @@ int main(int argc, char *argv[])
             runUnitTests();
             exit(0);
         }
+        if(UserConfigParams::m_micro_benchmark)
+        {
+            runMicroBenchmarks();
+            exit(0);
+        }
 
 #ifndef SERVER_ONLY
         if (!GUIEngine::isNoGraphics())
@@ -2565,6 +2695,8 @@ void runUnitTests()
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
+    Log::info("UnitTest", "DeltaNetworkState");
+    DeltaNetworkState::unitTesting();
     Log::info("UnitTest", "SocketAddress");
     SocketAddress::unitTesting();
     Log::info("UnitTest", "StringUtils::versionToInt");
@@ -2610,6 +2742,15 @@ void runUnitTests()
     Log::info("UnitTest", "Arena Graph");
     ArenaGraph::unitTesting();
 
+    Log::info("UnitTest", "Graph sector search");
+    Graph::unitTesting();
+
+    Log::info("UnitTest", "Race positions");
+    LinearWorld::unitTesting();
+
+    Log::info("UnitTest", "TriangleMesh BVH cache");
+    TriangleMesh::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
@@ -2620,3 +2761,23 @@ void runUnitTests()
     Log::info("UnitTest", "Testing successful   ");
     Log::info("UnitTest", "=====================");
 }   // runUnitTests
+
+//=============================================================================
+void runMicroBenchmarks()
+{
+    Log::info("Benchmark", "Starting micro benchmarks");
+    Log::info("Benchmark", "=========================");
+    Log::info("Benchmark", "RewindManager::saveState");
+    RewindManager::benchmark();
+    Log::info("Benchmark", "RewindQueue rewind");
+    RewindQueue::benchmark();
+    Log::info("Benchmark", "STKHost encryption");
+    STKHost::benchmark();
+    Log::info("Benchmark", "ArenaGraph shortest paths");
+    ArenaGraph::benchmark();
+    Log::info("Benchmark", "CachedCharacteristic kart updates");
+    CachedCharacteristic::benchmark();
+    Log::info("Benchmark", "XMLNode track files");
+    XMLNode::benchmark();
+    Log::info("Benchmark", "=========================");
+}   // runMicroBenchmarks
@@ -49,10 +49,14 @@
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/thread_pool.hpp"
 #include "utils/translation.hpp"
 
+#include <algorithm>
 #include <climits>
+#include <cmath>
 #include <iostream>
+#include <random>
 
 //-----------------------------------------------------------------------------
 /** Constructs the linear world. Note that here no functions can be called
@@ -268,8 +272,9 @@ void LinearWorld::update(int ticks)
 //-----------------------------------------------------------------------------
 void LinearWorld::updateTrackSectors()
 {
-    const unsigned int kart_amount = getNumKarts();
-    for(unsigned int n=0; n<kart_amount; n++)
+    // Each kart only changes its own track sector and kart info, so all
+    // karts can be done in parallel.
+    m_kart_update_pool->parallelFor(getNumKarts(), [this](unsigned int n)
     {
         KartInfo& kart_info = m_kart_info[n];
         AbstractKart* kart = m_karts[n].get();
@@ -278,7 +283,7 @@ void LinearWorld::updateTrackSectors()
         // rescued or eliminated
         if(kart->getKartAnimation() &&
            !dynamic_cast<CannonAnimation*>(kart->getKartAnimation()))
-            continue;
+            return;
         // If the kart is off road, and 'flying' over a reset plane
         // don't adjust the distance of the kart, to avoid a jump
         // in the position of the kart (e.g. while falling the kart
@@ -288,12 +293,12 @@ void LinearWorld::updateTrackSectors()
             (!kart->getMaterial() ||
               kart->getMaterial()->isDriveReset()))  &&
              !kart->isGhostKart())
-            continue;
+            return;
         getTrackSector(n)->update(kart->getFrontXYZ());
         kart_info.m_overall_distance = kart_info.m_finished_laps
                                      * Track::getCurrentTrack()->getTrackLength()
                         + getDistanceDownTrackForKart(kart->getWorldKartId(), true);
-    }   // for n
+    });
 }   // updateTrackSectors
 
 //-----------------------------------------------------------------------------
@@ -849,9 +854,10 @@ btTransform LinearWorld::getRescueTransform(unsigned int index) const
 }   // getRescueTransform
 
 //-----------------------------------------------------------------------------
-/** Find the position (rank) of every kart. ATM it uses a stable O(n^2)
- *  algorithm by counting for each kart how many other karts are ahead of
- *  it.
+/** Find the position (rank) of every kart. The karts still racing are
+ *  sorted once by overall distance (O(n log n), see computeRacePositions),
+ *  karts which have finished the race or are eliminated keep their
+ *  position.
  */
 void LinearWorld::updateRacePosition()
 {
@@ -863,9 +869,22 @@ void LinearWorld::updateRacePosition()
     bool rank_changed = false;
 #endif
 
-    // NOTE: if you do any changes to this loop, the next loop (see
-    // DEBUG_KART_RANK below) needs to have the same changes applied
-    // so that debug output is still correct!!!!!!!!!!!
+    m_ranking_data.resize(kart_amount);
+    for (unsigned int i=0; i<kart_amount; i++)
+    {
+        const AbstractKart* kart = m_karts[i].get();
+        RankingData& data = m_ranking_data[i];
+        data.m_overall_distance = m_kart_info[i].m_overall_distance;
+        data.m_initial_position = kart->getInitialPosition();
+        data.m_finished         = kart->hasFinishedRace();
+        data.m_eliminated       = kart->isEliminated();
+    }
+    computeRacePositions(m_ranking_data, &m_ranking_order,
+                         &m_ranking_positions);
+
+    // NOTE: if you do any changes to the ranking rules in
+    // computeRacePositions, the loop in DEBUG_KART_RANK below needs to have
+    // the same changes applied so that debug output is still correct!!!!!!!
     for (unsigned int i=0; i<kart_amount; i++)
     {
         AbstractKart* kart = m_karts[i].get();
@@ -883,33 +902,7 @@ void LinearWorld::updateRacePosition()
         }
         KartInfo& kart_info = m_kart_info[i];
 
-        int p = 1 ;
-
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
-
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
-        {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
-
-        } //next kart
+        const int p = m_ranking_positions[i];
 
 #ifndef DEBUG
         setKartPosition(i, p);
@@ -1029,6 +1022,126 @@ void LinearWorld::updateRacePosition()
     endSetKartPositions();
 }   // updateRacePosition
 
+//-----------------------------------------------------------------------------
+/** Computes the race position of all karts that have neither finished the
+ *  race nor are eliminated. The position is one more than the number of
+ *  (not eliminated) karts ahead, i.e. karts that have finished the race,
+ *  or have covered a larger overall distance, or have the same distance
+ *  (very unlikely) but started earlier. This is done by sorting the karts
+ *  by these criteria.
+ *  \param data The ranking data of all karts.
+ *  \param order Temporary storage for the sorted karts.
+ *  \param positions On return the position of each kart, or -1 if the
+ *         kart has finished the race or is eliminated.
+ */
+void LinearWorld::computeRacePositions(const std::vector<RankingData> &data,
+                                       std::vector<int> *order,
+                                       std::vector<int> *positions)
+{
+    positions->assign(data.size(), -1);
+    order->clear();
+    int num_finished = 0;
+    for (unsigned int i = 0; i < data.size(); i++)
+    {
+        if (data[i].m_eliminated)
+            continue;
+        if (data[i].m_finished)
+            num_finished++;
+        // A NAN distance is never ahead or behind of any kart
+        else if (!std::isnan(data[i].m_overall_distance))
+            order->push_back(i);
+        else
+            (*positions)[i] = 0;
+    }
+
+    auto is_ahead = [&data](int a, int b)
+    {
+        return data[a].m_overall_distance > data[b].m_overall_distance ||
+              (data[a].m_overall_distance == data[b].m_overall_distance &&
+               data[a].m_initial_position < data[b].m_initial_position);
+    };
+    std::sort(order->begin(), order->end(), is_ahead);
+
+    // All karts before the first kart that is equal to the current kart
+    // are ahead of it.
+    unsigned int first_equal = 0;
+    for (unsigned int k = 0; k < order->size(); k++)
+    {
+        if (k > 0 && is_ahead((*order)[k - 1], (*order)[k]))
+            first_equal = k;
+        (*positions)[(*order)[k]] = 1 + num_finished + first_equal;
+    }
+    for (unsigned int i = 0; i < data.size(); i++)
+    {
+        if ((*positions)[i] == 0)
+            (*positions)[i] = 1 + num_finished;
+    }
+}   // computeRacePositions
+
+//-----------------------------------------------------------------------------
+/** The original ranking algorithm, which compares each kart with all other
+ *  karts. Only used to test computeRacePositions.
+ */
+void LinearWorld::computeRacePositionsSlow(const std::vector<RankingData> &data,
+                                           std::vector<int> *positions)
+{
+    positions->assign(data.size(), -1);
+    for (unsigned int i = 0; i < data.size(); i++)
+    {
+        if (data[i].m_eliminated || data[i].m_finished)
+            continue;
+        int p = 1;
+        const float my_distance = data[i].m_overall_distance;
+        for (unsigned int j = 0; j < data.size(); j++)
+        {
+            if (j == i || data[j].m_eliminated)
+                continue;
+            if (data[j].m_finished                          ||
+                data[j].m_overall_distance > my_distance    ||
+               (data[j].m_overall_distance == my_distance &&
+                data[j].m_initial_position < data[i].m_initial_position))
+            {
+                p++;
+            }
+        }   // for j
+        (*positions)[i] = p;
+    }   // for i
+}   // computeRacePositionsSlow
+
+//-----------------------------------------------------------------------------
+/** Tests that computeRacePositions gives exactly the same positions as the
+ *  original algorithm, using random races with many karts, ties in distance
+ *  and finished and eliminated karts.
+ */
+void LinearWorld::unitTesting()
+{
+    std::mt19937 random(42);
+    std::vector<RankingData> data;
+    std::vector<int> order, positions, expected;
+    for (int test = 0; test < 2000; test++)
+    {
+        const unsigned int num_karts = 1 + random() % 40;
+        data.resize(num_karts);
+        for (unsigned int i = 0; i < num_karts; i++)
+        {
+            // Only use few different distances to get ties
+            data[i].m_overall_distance = (float)(random() % 8) * 100.0f
+                                       - 20.0f;
+            if (random() % 50 == 0)
+                data[i].m_overall_distance = std::nanf("");
+            data[i].m_initial_position = 1 + i;
+            // Duplicated start positions must give the same result, too
+            if (random() % 20 == 0)
+                data[i].m_initial_position = 1 + random() % num_karts;
+            data[i].m_finished   = random() % 5 == 0;
+            data[i].m_eliminated = random() % 8 == 0;
+        }
+        computeRacePositions(data, &order, &positions);
+        computeRacePositionsSlow(data, &expected);
+        assert(positions == expected);
+    }
+}   // unitTesting
+
 //-----------------------------------------------------------------------------
 /** Checks if a kart is going in the wrong direction. This is done only for
  *  player karts to display a message to the player.
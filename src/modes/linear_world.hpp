@@ -123,6 +123,26 @@ private:
         void restoreCompleteState(const BareNetworkString& b);
     };
     // ------------------------------------------------------------------------
+    /** The data of a kart that determines its race position. */
+    struct RankingData
+    {
+        float m_overall_distance;
+        int   m_initial_position;
+        bool  m_finished;
+        bool  m_eliminated;
+    };
+    /** Temporary data used in updateRacePosition, stored here to avoid
+     *  memory allocations each time step. */
+    std::vector<RankingData> m_ranking_data;
+    std::vector<int>         m_ranking_order;
+    std::vector<int>         m_ranking_positions;
+
+    static void computeRacePositions(const std::vector<RankingData> &data,
+                                     std::vector<int> *order,
+                                     std::vector<int> *positions);
+    static void computeRacePositionsSlow(const std::vector<RankingData> &data,
+                                         std::vector<int> *positions);
+    // ------------------------------------------------------------------------
 
 protected:
 
@@ -136,6 +156,7 @@ protected:
     virtual float estimateFinishTimeForKart(AbstractKart* kart) OVERRIDE;
 
 public:
+    static void   unitTesting();
                   LinearWorld();
    /** call just after instanciating. can't be moved to the contructor as child
        classes must be instanciated, otherwise polymorphism will fail and the
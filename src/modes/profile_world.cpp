@@ -23,6 +23,7 @@
 #include "graphics/irr_driver.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "physics/physics.hpp"
 #include "tracks/track.hpp"
 
 #include <ISceneManager.h>
@@ -205,6 +206,14 @@ void ProfileWorld::enterRaceOverState()
     Log::verbose("profile", "Number of frames: %d time %f, Average FPS: %f",
                  m_frame_count, runtime, (float)m_frame_count/runtime);
 
+    // Print the time spent in physics, e.g. to compare broadphases
+    const Physics* physics = Physics::getInstance();
+    const unsigned int steps = std::max(physics->getUpdateCount(), 1u);
+    Log::verbose("profile", "Physics broadphase %s: %d steps, time %f, "
+                 "average step %f ms", physics->getBroadphaseName().c_str(),
+                 physics->getUpdateCount(), physics->getUpdateTime(),
+                 physics->getUpdateTime()*1000.0/steps);
+
     // Print geometry statistics if we're not in no-graphics mode
     if(!GUIEngine::isNoGraphics())
     {
@@ -55,6 +55,7 @@
 #include "network/protocols/client_lobby.hpp"
 #include "network/network_config.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
 #include "physics/btKart.hpp"
 #include "physics/physics.hpp"
 #include "physics/triangle_mesh.hpp"
@@ -77,6 +78,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/profiler.hpp"
+#include "utils/thread_pool.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
 
@@ -194,6 +196,15 @@ void World::init()
     unsigned int num_karts = race_manager->getNumberOfKarts();
     //assert(num_karts > 0);
 
+    // The calling thread prepares karts too, so more than one thread less
+    // than the number of karts would never be used.
+    int threads = UserConfigParams::m_kart_update_threads;
+    if (threads < 0)
+        threads = (int)ThreadPool::getDefaultThreadCount();
+    threads = std::min(threads, (int)num_karts - 1);
+    m_kart_update_pool.reset(new ThreadPool(std::max(threads, 0),
+                                            "KartUpdate"));
+
     // Load the track models - this must be done before the karts so that the
     // karts can be positioned properly on (and not in) the tracks.
     // This also defines the static Track::getCurrentTrack function.
@@ -1086,6 +1097,24 @@ void World::updateGraphics(float dt)
     Track::getCurrentTrack()->updateGraphics(dt);
 }   // updateGraphics
 
+//-----------------------------------------------------------------------------
+/** Returns if the kart with the given index is updated in this time step.
+ *  Eliminated karts and karts frozen in a partial rewind keep their state.
+ *  \param i Index of the kart.
+ */
+bool World::isKartUpdated(unsigned int i) const
+{
+    if (RewindManager::get()->isPartialRewinding())
+    {
+        Rewinder* r = dynamic_cast<Rewinder*>(m_karts[i].get());
+        if (r && r->isFrozen())
+            return false;
+    }
+    SpareTireAI* sta =
+        dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
+    return !m_karts[i]->isEliminated() || (sta && sta->isMoving());
+}   // isKartUpdated
+
 //-----------------------------------------------------------------------------
 /** Updates the physics, all karts, the track, and projectile manager.
  *  \param ticks Number of physics time steps - should be 1.
@@ -1121,16 +1150,23 @@ void World::update(int ticks)
 
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
 
+    // First do the expensive queries which only read the world state
+    // (terrain raycasts, AI look ahead) for all karts in parallel. Each kart
+    // only uses these results if they are identical to what a serial update
+    // would compute, so the result does not depend on the number of threads.
+    const unsigned int kart_amount = (unsigned int)m_karts.size();
+    m_kart_update_pool->parallelFor(kart_amount, [this, ticks](unsigned i)
+    {
+        if (isKartUpdated(i))
+            m_karts[i]->prepareUpdate(ticks);
+    });
+
     // Update all the karts. This in turn will also update the controller,
     // which causes all AI steering commands set. So in the following 
     // physics update the new steering is taken into account.
-    const int kart_amount = (int)m_karts.size();
-    for (int i = 0 ; i < kart_amount; ++i)
+    for (unsigned int i = 0 ; i < kart_amount; ++i)
     {
-        SpareTireAI* sta =
-            dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
-        // Update all karts that are not eliminated
-        if(!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
+        if (isKartUpdated(i))
             m_karts[i]->update(ticks);
         if (isStartPhase())
             m_karts[i]->makeKartRest();
@@ -47,6 +47,7 @@ class Controller;
 class ItemState;
 class PhysicalObject;
 class STKPeer;
+class ThreadPool;
 
 namespace Scripting
 {
@@ -113,6 +114,10 @@ protected:
     KartList                  m_karts;
     RandomGenerator           m_random;
 
+    /** Worker threads used for the parts of the kart update which only
+     *  read the world state, see AbstractKart::prepareUpdate(). */
+    std::unique_ptr<ThreadPool> m_kart_update_pool;
+
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
     int         m_eliminated_karts;
@@ -134,6 +139,7 @@ protected:
 
     void  updateHighscores  (int* best_highscore_rank);
     void  resetAllKarts     ();
+    bool  isKartUpdated     (unsigned int i) const;
     Controller*
           loadAIController  (AbstractKart *kart);
 
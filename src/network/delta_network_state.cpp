@@ -0,0 +1,183 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/delta_network_state.hpp"
+
+#include "network/network_string.hpp"
+
+#include <assert.h>
+
+namespace DeltaNetworkState
+{
+// ----------------------------------------------------------------------------
+/** Returns a Fletcher-16 checksum of a state, which is used to detect that a
+ *  delta was decoded with a different baseline than it was encoded with.
+ *  \param data The state.
+ *  \param size Size of the state.
+ */
+static uint16_t checksum(const uint8_t* data, unsigned size)
+{
+    unsigned sum1 = 0, sum2 = 0;
+    for (unsigned i = 0; i < size; i++)
+    {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}   // checksum
+
+// ----------------------------------------------------------------------------
+/** Encodes the difference between current and baseline (which both must have
+ *  size bytes) into out. The caller should compare the size of out with the
+ *  full state size to decide which one to send.
+ *  \param baseline The state acknowledged by the receiver.
+ *  \param current The state to be sent.
+ *  \param size Size of both states.
+ *  \param out Vector to which the encoded bytes are appended.
+ */
+void encode(const uint8_t* baseline, const uint8_t* current, unsigned size,
+            std::vector<uint8_t>* out)
+{
+    const uint16_t sum = checksum(current, size);
+    out->push_back((uint8_t)(sum & 0xff));
+    out->push_back((uint8_t)(sum >> 8));
+
+    // Skip the trailing run of identical bytes, decode will copy them
+    // from the baseline
+    unsigned end = size;
+    while (end > 0 && baseline[end - 1] == current[end - 1])
+        end--;
+
+    unsigned i = 0;
+    while (i < end)
+    {
+        unsigned zero = 0;
+        while (i < end && zero < 255 && baseline[i] == current[i])
+        {
+            zero++;
+            i++;
+        }
+        unsigned literal_start = i;
+        unsigned literal = 0;
+        while (i < end && literal < 255 && baseline[i] != current[i])
+        {
+            literal++;
+            i++;
+        }
+        out->push_back((uint8_t)zero);
+        out->push_back((uint8_t)literal);
+        for (unsigned j = literal_start; j < literal_start + literal; j++)
+            out->push_back(baseline[j] ^ current[j]);
+    }
+}   // encode
+
+// ----------------------------------------------------------------------------
+/** Reconstructs a state from baseline and an encoded difference.
+ *  \param baseline The state used as baseline by the sender.
+ *  \param size Size of the baseline (and the reconstructed) state.
+ *  \param encoded Buffer to read the encoded difference from, exactly
+ *         encoded_size bytes will be read.
+ *  \param out Memory with size bytes for the reconstructed state.
+ *  \return False if the encoded data is invalid, or if the reconstructed
+ *          state does not match the checksum (i.e. a different baseline
+ *          was used to encode it).
+ */
+bool decode(const uint8_t* baseline, unsigned size,
+            const BareNetworkString* encoded, unsigned encoded_size,
+            uint8_t* out)
+{
+    if (encoded_size < 2)
+        return false;
+    memcpy(out, baseline, size);
+    uint16_t sum = encoded->getUInt8();
+    sum |= (uint16_t)(encoded->getUInt8() << 8);
+    unsigned i = 0;
+    unsigned read = 2;
+    while (read + 2 <= encoded_size)
+    {
+        i += encoded->getUInt8();
+        unsigned literal = encoded->getUInt8();
+        read += 2;
+        if (i + literal > size || read + literal > encoded_size)
+            return false;
+        for (unsigned j = 0; j < literal; j++)
+            out[i++] ^= encoded->getUInt8();
+        read += literal;
+    }
+    return read == encoded_size && i <= size && checksum(out, size) == sum;
+}   // decode
+
+// ----------------------------------------------------------------------------
+void unitTesting()
+{
+    std::vector<uint8_t> baseline(600), current(600), encoded, decoded(600);
+    for (unsigned i = 0; i < baseline.size(); i++)
+        baseline[i] = current[i] = (uint8_t)(i * 7);
+
+    // Identical states encode to the checksum only
+    encode(baseline.data(), current.data(), 600, &encoded);
+    assert(encoded.size() == 2);
+    BareNetworkString same((char*)encoded.data(), (int)encoded.size());
+    assert(decode(baseline.data(), 600, &same, (unsigned)encoded.size(),
+                  decoded.data()));
+    assert(decoded == current);
+
+    // Long runs (more than 255 bytes) of both identical and different bytes
+    current[0] ^= 1;
+    current[300] ^= 0xff;
+    for (unsigned i = 320; i < 590; i++)
+        current[i] ^= 0x5a;
+    encoded.clear();
+    encode(baseline.data(), current.data(), 600, &encoded);
+    assert(encoded.size() < current.size());
+
+    BareNetworkString bns((char*)encoded.data(), (int)encoded.size());
+    assert(decode(baseline.data(), 600, &bns, (unsigned)encoded.size(),
+                  decoded.data()));
+    assert(decoded == current);
+    assert(bns.size() == 0);
+
+    // A different baseline (e.g. a wrong acknowledged state) must be
+    // rejected, even if it has the same size and the bytes changed by the
+    // delta are the same
+    std::vector<uint8_t> wrong_baseline = baseline;
+    wrong_baseline[100] ^= 0x10;
+    BareNetworkString wrong((char*)encoded.data(), (int)encoded.size());
+    assert(!decode(wrong_baseline.data(), 600, &wrong,
+                   (unsigned)encoded.size(), decoded.data()));
+
+    // A baseline with a different size must be rejected
+    BareNetworkString shorter((char*)encoded.data(), (int)encoded.size());
+    assert(!decode(baseline.data(), 500, &shorter, (unsigned)encoded.size(),
+                   decoded.data()));
+
+    // A truncated delta must be rejected, wherever it is cut off
+    for (unsigned size = 0; size < encoded.size(); size++)
+    {
+        BareNetworkString truncated((char*)encoded.data(), (int)size);
+        assert(!decode(baseline.data(), 600, &truncated, size,
+                       decoded.data()));
+    }
+
+    // Corrupted data must be rejected
+    const uint8_t corrupted[] = { 0, 0, 250, 100 };
+    BareNetworkString bad((char*)corrupted, 4);
+    assert(!decode(baseline.data(), 300, &bad, 4, decoded.data()));
+}   // unitTesting
+
+}   // namespace DeltaNetworkState
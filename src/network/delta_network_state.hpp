@@ -0,0 +1,57 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_DELTA_NETWORK_STATE_HPP
+#define HEADER_DELTA_NETWORK_STATE_HPP
+
+#include "utils/types.hpp"
+
+#include <vector>
+
+class BareNetworkString;
+
+/** \ingroup network
+ *  Encodes the state of a rewinder as a difference to an older state of the
+ *  same rewinder (the baseline), which was acknowledged by the receiver.
+ *  The current state is XOR'ed with the baseline, and the (usually mostly
+ *  zero) result is run-length encoded as a sequence of
+ *  (uint8 zero count, uint8 literal count, literal bytes...) tuples. They
+ *  are preceded by a uint16 checksum of the current state, so a delta
+ *  decoded with the wrong baseline is detected.
+ */
+namespace DeltaNetworkState
+{
+    /** Delta encoding is only done if both buffers have the same size,
+     *  otherwise (or if it's not smaller) the full state is sent. */
+    enum DeltaMode : uint8_t
+    {
+        DM_FULL = 0,
+        DM_XOR  = 1
+    };
+    // ------------------------------------------------------------------------
+    void encode(const uint8_t* baseline, const uint8_t* current,
+                unsigned size, std::vector<uint8_t>* out);
+    // ------------------------------------------------------------------------
+    bool decode(const uint8_t* baseline, unsigned size,
+                const BareNetworkString* encoded, unsigned encoded_size,
+                uint8_t* out);
+    // ------------------------------------------------------------------------
+    void unitTesting();
+};   // DeltaNetworkState
+
+#endif // HEADER_DELTA_NETWORK_STATE_HPP
@@ -19,6 +19,9 @@
 #ifndef HEADER_EVENT_REWINDER_HPP
 #define HEADER_EVENT_REWINDER_HPP
 
+#include <cstdint>
+#include <vector>
+
 class BareNetworkString;
 
 /** A simple class that defines an interface to event rewinding: an undo()
@@ -40,6 +43,15 @@ public:
      *  rewind, i.e. when going forward in time again.
      */
     virtual void rewind(BareNetworkString *buffer) = 0;
+
+    /** Adds the ids of all rewinders whose state is changed by the event to
+     *  the list, which is used to find the rewinders to be rewound in a
+     *  partial rewind.
+     *  \return False if the event can change any rewinder.
+     */
+    virtual bool getChangedRewinders(BareNetworkString *buffer,
+                                     std::vector<uint16_t>* ids)
+                                                              { return false; }
 };   // EventRewinder
 #endif
 
@@ -0,0 +1,259 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/interest_manager.hpp"
+
+#include "config/stk_config.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/world.hpp"
+#include "network/network_config.hpp"
+#include "network/network_string.hpp"
+#include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
+#include "network/server_config.hpp"
+#include "network/stk_peer.hpp"
+#include "tracks/arena_graph.hpp"
+#include "tracks/drive_graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/** Size of the state header: protocol type, message type and ticks. */
+static const unsigned STATE_HEADER_SIZE = 6;
+
+// ----------------------------------------------------------------------------
+InterestManager::InterestManager()
+{
+    m_ticks = 0;
+    m_partial_state = new NetworkString(PROTOCOL_CONTROLLER_EVENTS);
+}   // InterestManager
+
+// ----------------------------------------------------------------------------
+InterestManager::~InterestManager()
+{
+    delete m_partial_state;
+}   // ~InterestManager
+
+// ----------------------------------------------------------------------------
+/** Returns the graph node of a position, or Graph::UNKNOWN_SECTOR if there
+ *  is no graph. */
+int InterestManager::findSector(const Vec3& xyz) const
+{
+    Graph* graph = Graph::get();
+    if (!graph)
+        return Graph::UNKNOWN_SECTOR;
+    int sector = Graph::UNKNOWN_SECTOR;
+    graph->findRoadSector(xyz, &sector);
+    if (sector == Graph::UNKNOWN_SECTOR)
+        sector = graph->findOutOfRoadSector(xyz);
+    return sector;
+}   // findSector
+
+// ----------------------------------------------------------------------------
+/** Returns the distance between two positions, which is the shortest path
+ *  in arena graph or the distance along the track in drive graph. The
+ *  straight distance is used if any sector is unknown.
+ */
+float InterestManager::getDistance(const Vec3& xyz_1, int sector_1,
+                                   const Vec3& xyz_2, int sector_2) const
+{
+    if (sector_1 != Graph::UNKNOWN_SECTOR &&
+        sector_2 != Graph::UNKNOWN_SECTOR)
+    {
+        if (ArenaGraph* ag = ArenaGraph::get())
+            return ag->getDistance(sector_1, sector_2);
+        if (DriveGraph* dg = DriveGraph::get())
+        {
+            float distance = std::fabs(dg->getDistanceFromStart(sector_1) -
+                dg->getDistanceFromStart(sector_2));
+            // The track is a loop, so objects near the start line are close
+            // to objects before it
+            const float lap_length = dg->getLapLength();
+            if (lap_length > 0.0f && distance > lap_length * 0.5f)
+                distance = lap_length - distance;
+            return distance;
+        }
+    }
+    return (xyz_1 - xyz_2).length();
+}   // getDistance
+
+// ----------------------------------------------------------------------------
+/** Finds the records of all rewinders in a state written by the rewind
+ *  manager, and the position of the rewinders to decide their relevance.
+ *  Called once for each state before sendPartialState.
+ *  \param state The full state.
+ */
+void InterestManager::prepareState(NetworkString& state)
+{
+    m_records.clear();
+    RewindManager* rwm = RewindManager::get();
+    state.reset();
+    state.skip(STATE_HEADER_SIZE - 4);
+    m_ticks = state.getUInt32();
+    // Full state has no deferred rewinders
+    state.skip(2);
+    const unsigned count = state.getUInt16();
+    std::string uid;
+    for (unsigned i = 0; i < count; i++)
+    {
+        StateRecord sr;
+        sr.m_offset = state.getCurrentOffset();
+        sr.m_rewinder_id = RewindManager::decodeRewinderID(&state, &uid);
+        const uint16_t data_size = state.getUInt16();
+        state.skip(data_size);
+        sr.m_size = state.getCurrentOffset() - sr.m_offset;
+        sr.m_sector = Graph::UNKNOWN_SECTOR;
+        std::shared_ptr<Rewinder> r = rwm->getRewinder(sr.m_rewinder_id);
+        sr.m_has_position = r && r->getInterestPosition(&sr.m_xyz);
+        if (sr.m_has_position)
+            sr.m_sector = findSector(sr.m_xyz);
+        m_records.push_back(sr);
+    }
+    state.reset();
+
+    for (auto it = m_last_sent_ticks.begin(); it != m_last_sent_ticks.end();)
+    {
+        if (it->first.expired())
+            it = m_last_sent_ticks.erase(it);
+        else
+            it++;
+    }
+}   // prepareState
+
+// ----------------------------------------------------------------------------
+/** Sends the state to a peer, leaving out rewinders which are not relevant
+ *  to its karts.
+ *  \param peer The peer to send to.
+ *  \param state The full state, prepareState must be called for it first.
+ *  \return False if the peer has no kart (spectating), so the full state
+ *          needs to be sent.
+ */
+bool InterestManager::sendPartialState(std::shared_ptr<STKPeer> peer,
+                                       const NetworkString& state)
+{
+    World* world = World::getWorld();
+    m_kart_positions.clear();
+    for (unsigned kart_id : peer->getAvailableKartIDs())
+    {
+        if (kart_id >= world->getNumKarts())
+            continue;
+        AbstractKart* kart = world->getKart(kart_id);
+        Rewinder* r = dynamic_cast<Rewinder*>(kart);
+        if (!r || kart->isEliminated())
+            continue;
+        KartPosition kp;
+        kp.m_xyz = kart->getXYZ();
+        kp.m_sector = findSector(kp.m_xyz);
+        kp.m_rewinder_id = r->getRewinderID();
+        m_kart_positions.push_back(kp);
+    }
+    if (m_kart_positions.empty())
+        return false;
+
+    std::vector<int>& last_sent = m_last_sent_ticks[peer];
+    const float near_distance = ServerConfig::m_interest_near_distance;
+    const int far_ticks = ServerConfig::m_interest_far_interval *
+        stk_config->getPhysicsFPS() /
+        NetworkConfig::get()->getStateFrequency();
+    const unsigned budget = ServerConfig::m_interest_state_budget;
+
+    // Rewinders without position and the karts of the peer are always sent,
+    // the others are sorted by distance divided by the number of ticks since
+    // they were last sent. Each rewinder not sent uses 2 bytes in the
+    // deferred list.
+    unsigned total_size = STATE_HEADER_SIZE + 4 +
+        2 * (unsigned)m_records.size();
+    m_candidates.clear();
+    m_selected.assign(m_records.size(), false);
+    for (unsigned i = 0; i < m_records.size(); i++)
+    {
+        const StateRecord& sr = m_records[i];
+        if (sr.m_rewinder_id >= last_sent.size())
+            last_sent.resize(sr.m_rewinder_id + 1, -1);
+        float distance = 0.0f;
+        bool is_own_kart = false;
+        if (sr.m_has_position)
+        {
+            distance = std::numeric_limits<float>::max();
+            for (const KartPosition& kp : m_kart_positions)
+            {
+                if (kp.m_rewinder_id == sr.m_rewinder_id)
+                {
+                    is_own_kart = true;
+                    break;
+                }
+                distance = std::min(distance, getDistance(sr.m_xyz,
+                    sr.m_sector, kp.m_xyz, kp.m_sector));
+            }
+        }
+        if (!sr.m_has_position || is_own_kart)
+        {
+            m_selected[i] = true;
+            total_size += sr.m_size - 2;
+            continue;
+        }
+        const int last_ticks = last_sent[sr.m_rewinder_id];
+        const int ticks_since_sent = last_ticks == -1 ?
+            std::numeric_limits<int>::max() : m_ticks - last_ticks;
+        // Distant objects are only sent at a reduced rate
+        if (distance > near_distance && ticks_since_sent < far_ticks)
+            continue;
+        m_candidates.emplace_back(
+            distance / (1.0f + (float)std::min(ticks_since_sent, 100000)), i);
+    }
+
+    std::sort(m_candidates.begin(), m_candidates.end());
+    for (auto& c : m_candidates)
+    {
+        const StateRecord& sr = m_records[c.second];
+        if (budget != 0 && total_size + sr.m_size - 2 > budget)
+            continue;
+        m_selected[c.second] = true;
+        total_size += sr.m_size - 2;
+    }
+
+    // Write the partial state in the same order as the full state, the
+    // restore order of rewinders matters
+    auto& out = m_partial_state->getBuffer();
+    const uint8_t* data = (const uint8_t*)state.getData();
+    out.assign(data, data + STATE_HEADER_SIZE);
+    const unsigned deferred_pos = (unsigned)out.size();
+    m_partial_state->addUInt16(0);
+    uint16_t deferred = 0;
+    for (unsigned i = 0; i < m_records.size(); i++)
+    {
+        if (m_selected[i])
+            continue;
+        m_partial_state->addUInt16(m_records[i].m_rewinder_id);
+        deferred++;
+    }
+    m_partial_state->setUInt16(deferred_pos, deferred);
+    m_partial_state->addUInt16((uint16_t)(m_records.size() - deferred));
+    for (unsigned i = 0; i < m_records.size(); i++)
+    {
+        if (!m_selected[i])
+            continue;
+        const StateRecord& sr = m_records[i];
+        out.insert(out.end(), data + sr.m_offset,
+            data + sr.m_offset + sr.m_size);
+        last_sent[sr.m_rewinder_id] = m_ticks;
+    }
+    peer->sendPacket(m_partial_state, /*reliable*/false);
+    return true;
+}   // sendPartialState
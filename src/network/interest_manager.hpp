@@ -0,0 +1,101 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_INTEREST_MANAGER_HPP
+#define HEADER_INTEREST_MANAGER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+class NetworkString;
+class STKPeer;
+
+/** \ingroup network */
+
+/** Server only: selects which rewinders of a game state are sent to each
+ *  peer. The state of objects close to the karts of a peer (using the
+ *  distance in the drive or arena graph) is always sent, distant objects
+ *  are sent at a reduced rate and within a byte budget per state. The
+ *  rewinders which are left out are listed as deferred, so the client
+ *  can restore its own predicted state for them when rewinding.
+ */
+class InterestManager : public NoCopy
+{
+private:
+    /** Information about the data of a rewinder in the current state. */
+    struct StateRecord
+    {
+        /** Offset of the record (starting at the rewinder id). */
+        unsigned m_offset;
+        /** Size of the record including rewinder id and data size. */
+        unsigned m_size;
+        uint16_t m_rewinder_id;
+        /** False if the record is always sent. */
+        bool m_has_position;
+        Vec3 m_xyz;
+        int m_sector;
+    };   // struct StateRecord
+
+    /** Position of a kart used by a peer. */
+    struct KartPosition
+    {
+        Vec3 m_xyz;
+        int m_sector;
+        uint16_t m_rewinder_id;
+    };   // struct KartPosition
+
+    /** All records of the current state. */
+    std::vector<StateRecord> m_records;
+
+    /** Ticks of the current state. */
+    int m_ticks;
+
+    /** For each peer the ticks each rewinder id was last sent. */
+    std::map<std::weak_ptr<STKPeer>, std::vector<int>,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_last_sent_ticks;
+
+    /** The following are only used in sendPartialState, they are kept as
+     *  members so no memory needs to be allocated for each peer. */
+    std::vector<KartPosition> m_kart_positions;
+    std::vector<std::pair<float, unsigned> > m_candidates;
+    std::vector<bool> m_selected;
+    NetworkString* m_partial_state;
+
+    // ------------------------------------------------------------------------
+    int findSector(const Vec3& xyz) const;
+    // ------------------------------------------------------------------------
+    float getDistance(const Vec3& xyz_1, int sector_1, const Vec3& xyz_2,
+                      int sector_2) const;
+
+public:
+    // ------------------------------------------------------------------------
+    InterestManager();
+    // ------------------------------------------------------------------------
+    ~InterestManager();
+    // ------------------------------------------------------------------------
+    void prepareState(NetworkString& state);
+    // ------------------------------------------------------------------------
+    bool sendPartialState(std::shared_ptr<STKPeer> peer,
+                          const NetworkString& state);
+};   // class InterestManager
+
+#endif
@@ -74,6 +74,10 @@ NetworkConfig::NetworkConfig()
     m_state_frequency = 10;
     m_nat64_prefix_data.fill(-1);
     m_num_fixed_ai = 0;
+    m_simulated_latency = 0;
+    m_simulated_jitter = 0;
+    m_simulated_packet_loss = 0;
+    m_rollback_benchmark = false;
 }   // NetworkConfig
 
 // ----------------------------------------------------------------------------
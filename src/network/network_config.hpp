@@ -118,6 +118,16 @@ private:
      *  addresses they use the same prefix for each initIPTest. */
     std::string m_nat64_prefix;
     std::array<uint32_t, 8> m_nat64_prefix_data;
+
+    /** Artificial latency and jitter (in ms) and packet loss (in percent)
+     *  added to all sent packets, used for testing bad connections. */
+    int m_simulated_latency;
+    int m_simulated_jitter;
+    int m_simulated_packet_loss;
+
+    /** True if this client connects to a server started by itself, and
+     *  exits after the race (see --rollback-benchmark). */
+    bool m_rollback_benchmark;
 public:
     /** Singleton get, which creates this object if necessary. */
     static NetworkConfig *get()
@@ -282,6 +292,30 @@ public:
     void setNumFixedAI(unsigned num)                  { m_num_fixed_ai = num; }
     // ------------------------------------------------------------------------
     unsigned getNumFixedAI() const                   { return m_num_fixed_ai; }
+    // ------------------------------------------------------------------------
+    void setSimulatedNetwork(int latency, int jitter, int packet_loss)
+    {
+        m_simulated_latency = latency;
+        m_simulated_jitter = jitter;
+        m_simulated_packet_loss = packet_loss;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns true if sent packets are delayed or dropped on purpose. */
+    bool hasSimulatedNetwork() const
+    {
+        return m_simulated_latency > 0 || m_simulated_jitter > 0 ||
+            m_simulated_packet_loss > 0;
+    }
+    // ------------------------------------------------------------------------
+    int getSimulatedLatency() const             { return m_simulated_latency; }
+    // ------------------------------------------------------------------------
+    int getSimulatedJitter() const               { return m_simulated_jitter; }
+    // ------------------------------------------------------------------------
+    int getSimulatedPacketLoss() const      { return m_simulated_packet_loss; }
+    // ------------------------------------------------------------------------
+    void setRollbackBenchmark(bool b)           { m_rollback_benchmark = b; }
+    // ------------------------------------------------------------------------
+    bool isRollbackBenchmark() const           { return m_rollback_benchmark; }
 };   // class NetworkConfig
 
 #endif // HEADER_NETWORK_CONFIG
@@ -229,6 +229,28 @@ public:
         return *this;
     }   // addUInt16
 
+    // ------------------------------------------------------------------------
+    /** Overwrites a 16 bit unsigned int which was added before, e.g. to
+     *  fill in a size which is only known after adding more data.
+     *  \param pos Position in the whole buffer (ignoring any offset).
+     *  \param value The new value.
+     */
+    void setUInt16(unsigned pos, const uint16_t value)
+    {
+        assert(pos + 2 <= m_buffer.size());
+        m_buffer[pos] = (value >> 8) & 0xff;
+        m_buffer[pos + 1] = value & 0xff;
+    }   // setUInt16
+
+    // ------------------------------------------------------------------------
+    /** Removes all data after the given size of the whole buffer, the
+     *  capacity is kept so the buffer can be reused without allocation. */
+    void truncate(unsigned size)
+    {
+        assert(size <= m_buffer.size());
+        m_buffer.resize(size);
+    }   // truncate
+
     // ------------------------------------------------------------------------
     /** Adds signed 24 bit integer. */
     BareNetworkString& addInt24(const int value)
@@ -36,6 +36,7 @@
 #include "karts/controller/controller.hpp"
 #include "karts/kart_properties.hpp"
 #include "karts/kart_properties_manager.hpp"
+#include "main_loop.hpp"
 #include "modes/linear_world.hpp"
 #include "network/crypto.hpp"
 #include "network/event.hpp"
@@ -49,6 +50,7 @@
 #include "network/protocols/game_events_protocol.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server.hpp"
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
@@ -453,6 +455,14 @@ void ClientLobby::update(int ticks)
             if (StateManager::get()->getGameState() == GUIEngine::INGAME_MENU)
                 StateManager::get()->enterGameState();
             World::getWorld()->enterRaceOverState();
+            if (RewindManager::isEnabled())
+                RewindManager::get()->writeStatistics();
+            if (NetworkConfig::get()->isRollbackBenchmark())
+            {
+                // The server started for the benchmark is closed together
+                // with STKHost
+                main_loop->requestAbort();
+            }
         }
         if (NetworkConfig::get()->isAutoConnect() &&
             StkTime::getMonoTimeMs() > m_auto_back_to_lobby_time)
@@ -643,6 +653,8 @@ void ClientLobby::connectionAccepted(Event* event)
         data.decodeString(&cap);
         caps.insert(cap);
     }
+    event->getPeer()->setCoalescePackets(
+        caps.find("coalesced_packets") != caps.end());
     NetworkConfig::get()->setServerCapabilities(caps);
 
     float auto_start_timer = data.getFloat();
@@ -22,15 +22,19 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/player_controller.hpp"
 #include "modes/world.hpp"
+#include "network/delta_network_state.hpp"
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/game_setup.hpp"
+#include "network/interest_manager.hpp"
 #include "network/network.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
+#include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
@@ -62,12 +66,25 @@ GameProtocol::GameProtocol()
     m_network_item_manager = static_cast<NetworkItemManager*>
         (Track::getCurrentTrack()->getItemManager());
     m_data_to_send = getNetworkString();
+    m_interest_manager = NULL;
+    if (NetworkConfig::get()->isServer())
+    {
+        m_delta_state = ServerConfig::m_delta_state;
+        if (ServerConfig::m_interest_state)
+            m_interest_manager = new InterestManager();
+    }
+    else
+    {
+        const auto& caps = NetworkConfig::get()->getServerCapabilities();
+        m_delta_state = caps.find("delta_state") != caps.end();
+    }
 }   // GameProtocol
 
 //-----------------------------------------------------------------------------
 GameProtocol::~GameProtocol()
 {
     delete m_data_to_send;
+    delete m_interest_manager;
 }   // ~GameProtocol
 
 //-----------------------------------------------------------------------------
@@ -130,6 +147,9 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_DELTA_STATE:       handleDeltaState(event);       break;
+    case GP_STATE_ACK:         handleStateAck(event);         break;
+    case GP_REWINDER_IDS:      handleRewinderIDs(event);      break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
     case GP_ADJUST_TIME:
     case GP_ITEM_UPDATE:
@@ -286,44 +306,104 @@ void GameProtocol::startNewState()
     assert(NetworkConfig::get()->isServer());
     m_data_to_send->clear();
     m_data_to_send->addUInt8(GP_STATE)
-        .addUInt32(World::getWorld()->getTicksSinceStart());
+        .addUInt32(World::getWorld()->getTicksSinceStart())
+        // Number of deferred rewinders (only used in partial state, see
+        // InterestManager) and rewinders, the latter is set in finalizeState
+        .addUInt16(0).addUInt16(0);
 }   // startNewState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to add data to the current state. The data in buffer
- *  is copied, so the data can be freed after this call/.
- *  \param buffer Adds the data in the buffer to the current state.
+/** Called by a server to finalize the current state, after all rewinders
+ *  wrote their data directly into it.
+ *  \param rewinder_count Number of rewinders in the state.
  */
-void GameProtocol::addState(BareNetworkString *buffer)
+void GameProtocol::finalizeState(uint16_t rewinder_count)
 {
     assert(NetworkConfig::get()->isServer());
-    m_data_to_send->addUInt16(buffer->size());
-    (*m_data_to_send) += *buffer;
-}   // addState
+    const int header_size = 1/*protocol type*/ + 1 /*gp event type*/+
+        4/*time*/;
+    m_data_to_send->setUInt16(header_size + 2, rewinder_count);
+
+    m_data_to_send->reset();
+    if (m_delta_state)
+    {
+        m_data_to_send->skip(header_size);
+        saveStateSnapshot(World::getWorld()->getTicksSinceStart(),
+            *m_data_to_send);
+        m_data_to_send->reset();
+    }
+}   // finalizeState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to finalize the current state, which add updated
- *  names of rewinder using to the beginning of state buffer
- *  \param cur_rewinder List of current rewinder using.
+/** Server only: sends the unique identity of new rewinder ids to all peers
+ *  in game.
+ *  \param ids List of new rewinder ids.
  */
-void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
+void GameProtocol::sendRewinderIDs(const std::vector<uint16_t>& ids)
 {
     assert(NetworkConfig::get()->isServer());
-    auto& buffer = m_data_to_send->getBuffer();
-    auto pos = buffer.begin() + 1/*protocol type*/ + 1 /*gp event type*/+
-        4/*time*/;
+    NetworkString* ns = getNetworkString();
+    ns->addUInt8(GP_REWINDER_IDS);
+    RewindManager::get()->encodeRewinderIDs(ns, ids);
+    sendMessageToPeers(ns, /*reliable*/true);
+    delete ns;
+}   // sendRewinderIDs
 
-    m_data_to_send->reset();
-    std::vector<uint8_t> names;
-    names.push_back((uint8_t)cur_rewinder.size());
-    for (std::string& name : cur_rewinder)
+// ----------------------------------------------------------------------------
+/** Server only: adds a peer which finished live joining, it will be sent all
+ *  rewinder ids with the next state. This function is thread-safe.
+ *  \param peer The live joining peer.
+ */
+void GameProtocol::addLiveJoinPeer(std::shared_ptr<STKPeer> peer)
+{
+    std::lock_guard<std::mutex> lock(m_live_join_peers_mutex);
+    m_live_join_peers.push_back(peer);
+}   // addLiveJoinPeer
+
+// ----------------------------------------------------------------------------
+/** Server only: sends all rewinder ids to peers which finished live joining
+ *  since the last state.
+ */
+void GameProtocol::sendAllRewinderIDsToLiveJoinPeers()
+{
+    std::vector<std::weak_ptr<STKPeer> > peers;
+    std::unique_lock<std::mutex> ul(m_live_join_peers_mutex);
+    std::swap(peers, m_live_join_peers);
+    ul.unlock();
+    if (peers.empty())
+        return;
+
+    NetworkString* ns = getNetworkString();
+    ns->addUInt8(GP_REWINDER_IDS);
+    RewindManager::get()->encodeAllRewinderIDs(ns);
+    for (auto& p : peers)
     {
-        names.push_back((uint8_t)name.size());
-        std::vector<uint8_t> rewinder(name.begin(), name.end());
-        names.insert(names.end(), rewinder.begin(), rewinder.end());
+        if (auto peer = p.lock())
+            peer->sendPacket(ns, /*reliable*/true);
     }
-    buffer.insert(pos, names.begin(), names.end());
-}   // finalizeState
+    delete ns;
+}   // sendAllRewinderIDsToLiveJoinPeers
+
+// ----------------------------------------------------------------------------
+/** Client only: handles the unique identity of rewinder ids sent by server,
+ *  they will be bound in main thread.
+ */
+void GameProtocol::handleRewinderIDs(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    std::vector<std::pair<uint16_t, std::string> > ids;
+    unsigned count = data.getUInt16();
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint16_t id = data.getUInt16();
+        std::string uid;
+        data.decodeString(&uid);
+        ids.emplace_back(id, uid);
+    }
+    RewindManager::get()->addNetworkRewinderIDs(ids);
+}   // handleRewinderIDs
 
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
@@ -332,9 +412,193 @@ void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    if (!m_delta_state && !m_interest_manager)
+    {
+        sendMessageToPeers(m_data_to_send, /*reliable*/false);
+        return;
+    }
+    if (m_interest_manager)
+        m_interest_manager->prepareState(*m_data_to_send);
+
+    // Group peers by their acknowledged state, so each delta state is only
+    // encoded once. Peers without a usable baseline get the full state.
+    // Peers which get a partial state from the interest manager never use
+    // delta state.
+    std::map<int, std::vector<std::shared_ptr<STKPeer> > > peers_by_baseline;
+    for (auto& peer : STKHost::get()->getPeers())
+    {
+        if (!peer->isValidated() || peer->isWaitingForGame())
+            continue;
+        const auto& caps = peer->getClientCapabilities();
+        if (m_interest_manager &&
+            caps.find("interest_state") != caps.end() &&
+            m_interest_manager->sendPartialState(peer, *m_data_to_send))
+            continue;
+        int baseline = -1;
+        if (m_delta_state && caps.find("delta_state") != caps.end())
+        {
+            std::lock_guard<std::mutex> lock(m_peer_acked_state_mutex);
+            auto it = m_peer_acked_state.find(peer);
+            if (it != m_peer_acked_state.end())
+                baseline = it->second;
+        }
+        peers_by_baseline[baseline].push_back(peer);
+    }
+
+    for (auto& p : peers_by_baseline)
+    {
+        std::vector<STKPeer*> peers;
+        for (auto& peer : p.second)
+            peers.push_back(peer.get());
+        const StateSnapshot* baseline = findStateSnapshot(p.first);
+        if (!baseline)
+        {
+            STKHost::get()->sendPacketToPeers(peers, m_data_to_send,
+                /*reliable*/false);
+            continue;
+        }
+        NetworkString* ns = encodeDeltaState(*baseline);
+        STKHost::get()->sendPacketToPeers(peers, ns, /*reliable*/false);
+        delete ns;
+    }
 }   // sendState
 
+// ----------------------------------------------------------------------------
+/** Saves the data of each rewinder in a full state, so it can be used as
+ *  baseline for later delta states.
+ *  \param ticks Time of the state.
+ *  \param data The state content, starting at the number of deferred
+ *         rewinders.
+ */
+void GameProtocol::saveStateSnapshot(int ticks, BareNetworkString& data)
+{
+    if (m_state_snapshots.size() >= MAX_STATE_SNAPSHOTS)
+        m_state_snapshots.pop_front();
+    m_state_snapshots.emplace_back();
+    StateSnapshot& snapshot = m_state_snapshots.back();
+    snapshot.m_ticks = ticks;
+    data.skip(data.getUInt16() * 2);
+    const unsigned count = data.getUInt16();
+    std::string uid;
+    for (unsigned i = 0; i < count; i++)
+    {
+        const uint16_t id = RewindManager::decodeRewinderID(&data, &uid);
+        const uint16_t data_size = data.getUInt16();
+        if (data_size > data.size())
+            throw std::out_of_range("Invalid rewinder data size.");
+        const uint8_t* start = (const uint8_t*)data.getCurrentData();
+        snapshot.m_rewinder_using.push_back(id);
+        snapshot.m_rewinder_data[id].assign(start, start + data_size);
+        data.skip(data_size);
+    }
+}   // saveStateSnapshot
+
+// ----------------------------------------------------------------------------
+/** Returns the saved state at the given ticks, or NULL if it's not (or no
+ *  longer) available. */
+const GameProtocol::StateSnapshot* GameProtocol::findStateSnapshot(int ticks)
+                                                                          const
+{
+    if (ticks < 0)
+        return NULL;
+    for (auto it = m_state_snapshots.rbegin(); it != m_state_snapshots.rend();
+         it++)
+    {
+        if (it->m_ticks == ticks)
+            return &(*it);
+    }
+    return NULL;
+}   // findStateSnapshot
+
+// ----------------------------------------------------------------------------
+/** Encodes the latest saved state as a difference to baseline. The data of
+ *  each rewinder is sent in full if it's not in baseline, if its size
+ *  changed or if the delta is not smaller.
+ *  \param baseline The state acknowledged by the receiving peers.
+ *  \return The message which needs to be freed by the caller.
+ */
+NetworkString* GameProtocol::encodeDeltaState(const StateSnapshot& baseline)
+{
+    const StateSnapshot& current = m_state_snapshots.back();
+    NetworkString* ns = getNetworkString(m_data_to_send->getTotalSize());
+    ns->addUInt8(GP_DELTA_STATE).addUInt32(current.m_ticks)
+        .addUInt32(baseline.m_ticks)
+        .addUInt16((uint16_t)current.m_rewinder_using.size());
+
+    RewindManager* rwm = RewindManager::get();
+    std::vector<uint8_t> encoded;
+    auto& buffer = ns->getBuffer();
+    for (uint16_t id : current.m_rewinder_using)
+    {
+        const std::vector<uint8_t>& data = current.m_rewinder_data.at(id);
+        rwm->encodeRewinderID(ns, id, current.m_ticks);
+        ns->addUInt16((uint16_t)data.size());
+        encoded.clear();
+        auto it = baseline.m_rewinder_data.find(id);
+        bool use_delta = it != baseline.m_rewinder_data.end() &&
+            it->second.size() == data.size();
+        if (use_delta)
+        {
+            DeltaNetworkState::encode(it->second.data(), data.data(),
+                (unsigned)data.size(), &encoded);
+            use_delta = encoded.size() + 2 < data.size();
+        }
+        if (use_delta)
+        {
+            ns->addUInt8(DeltaNetworkState::DM_XOR)
+                .addUInt16((uint16_t)encoded.size());
+            buffer.insert(buffer.end(), encoded.begin(), encoded.end());
+        }
+        else
+        {
+            ns->addUInt8(DeltaNetworkState::DM_FULL);
+            buffer.insert(buffer.end(), data.begin(), data.end());
+        }
+    }
+    return ns;
+}   // encodeDeltaState
+
+// ----------------------------------------------------------------------------
+/** Sends to the server the time of the latest state received, so that it
+ *  can be used as baseline for delta states.
+ *  \param ticks Time of the state.
+ */
+void GameProtocol::sendStateAck(int ticks)
+{
+    assert(NetworkConfig::get()->isClient());
+    NetworkString *ns = getNetworkString(5);
+    ns->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+    // If it gets lost the server will use an older baseline
+    sendToServer(ns, /*reliable*/false);
+    delete ns;
+}   // sendStateAck
+
+// ----------------------------------------------------------------------------
+/** Handles a state acknowledgement from a client.
+ *  \param event The data from the client.
+ */
+void GameProtocol::handleStateAck(Event *event)
+{
+    if (!NetworkConfig::get()->isServer())
+        return;
+    int ticks = event->data().getUInt32();
+    std::lock_guard<std::mutex> lock(m_peer_acked_state_mutex);
+    for (auto it = m_peer_acked_state.begin();
+         it != m_peer_acked_state.end();)
+    {
+        if (it->first.expired())
+            it = m_peer_acked_state.erase(it);
+        else
+            it++;
+    }
+    std::weak_ptr<STKPeer> peer = event->getPeerSP();
+    auto it = m_peer_acked_state.find(peer);
+    if (it == m_peer_acked_state.end())
+        m_peer_acked_state[peer] = ticks;
+    else if (ticks > it->second)
+        it->second = ticks;
+}   // handleStateAck
+
 // ----------------------------------------------------------------------------
 /** Called when a new full state is received form the server.
  */
@@ -345,22 +609,90 @@ void GameProtocol::handleState(Event *event)
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
 
-    // Check for updated rewinder using
-    unsigned rewinder_size = data.getUInt8();
-    std::vector<std::string> rewinder_using;
-    for (unsigned i = 0; i < rewinder_size; i++)
+    if (m_delta_state)
     {
-        std::string name;
-        data.decodeString(&name);
-        rewinder_using.push_back(name);
+        const int offset = data.getCurrentOffset();
+        saveStateSnapshot(ticks, data);
+        data.reset();
+        data.skip(offset);
+        sendStateAck(ticks);
     }
 
     // The memory for bns will be handled in the RewindInfoState object
     RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
-        rewinder_using, data.getBuffer());
+        data.getBuffer());
     RewindManager::get()->addNetworkRewindInfo(ris);
 }   // handleState
 
+// ----------------------------------------------------------------------------
+/** Called when a delta state is received from the server. It reconstructs
+ *  the full state using the acknowledged baseline state, so that the
+ *  RewindInfoState is the same as for a full state.
+ */
+void GameProtocol::handleDeltaState(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    int ticks          = data.getUInt32();
+    int baseline_ticks = data.getUInt32();
+
+    const StateSnapshot* baseline = findStateSnapshot(baseline_ticks);
+    if (!baseline)
+    {
+        Log::warn("GameProtocol", "Missing baseline state %d for delta "
+            "state %d.", baseline_ticks, ticks);
+        return;
+    }
+
+    const unsigned count = data.getUInt16();
+    BareNetworkString full(data.size() * 2);
+    full.addUInt16(0).addUInt16((uint16_t)count);
+    auto& buffer = full.getBuffer();
+    std::string uid;
+    for (unsigned i = 0; i < count; i++)
+    {
+        // Copy the rewinder id (which may include unique identity) as is
+        const int id_offset = data.getCurrentOffset();
+        const uint16_t id = RewindManager::decodeRewinderID(&data, &uid);
+        buffer.insert(buffer.end(), data.getBuffer().begin() + id_offset,
+            data.getBuffer().begin() + data.getCurrentOffset());
+
+        const uint16_t data_size = data.getUInt16();
+        const uint8_t mode = data.getUInt8();
+        full.addUInt16(data_size);
+        const size_t offset = buffer.size();
+        buffer.resize(offset + data_size);
+        if (mode == DeltaNetworkState::DM_FULL)
+        {
+            if (data_size > data.size())
+                throw std::out_of_range("Invalid full rewinder data.");
+            memcpy(buffer.data() + offset, data.getCurrentData(), data_size);
+            data.skip(data_size);
+            continue;
+        }
+        const uint16_t encoded_size = data.getUInt16();
+        auto it = baseline->m_rewinder_data.find(id);
+        if (mode != DeltaNetworkState::DM_XOR ||
+            it == baseline->m_rewinder_data.end() ||
+            it->second.size() != data_size ||
+            !DeltaNetworkState::decode(it->second.data(), data_size, &data,
+            encoded_size, buffer.data() + offset))
+        {
+            Log::warn("GameProtocol", "Invalid delta state %d for rewinder "
+                "%d.", ticks, id);
+            return;
+        }
+    }
+
+    saveStateSnapshot(ticks, full);
+    sendStateAck(ticks);
+
+    // The memory for bns will be handled in the RewindInfoState object
+    RewindInfoState* ris = new RewindInfoState(ticks, 0, full.getBuffer());
+    RewindManager::get()->addNetworkRewindInfo(ris);
+}   // handleDeltaState
+
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
  *  \param buffer Pointer to the saved state information.
@@ -393,6 +725,22 @@ void GameProtocol::rewind(BareNetworkString *buffer)
     }
 }   // rewind
 
+// ----------------------------------------------------------------------------
+/** A controller action only changes the kart it belongs to. */
+bool GameProtocol::getChangedRewinders(BareNetworkString *buffer,
+                                       std::vector<uint16_t>* ids)
+{
+    unsigned kart_id = buffer->getUInt8();
+    World* world = World::getWorld();
+    if (!world || kart_id >= world->getNumKarts())
+        return false;
+    Rewinder* r = dynamic_cast<Rewinder*>(world->getKart(kart_id));
+    if (!r || r->getRewinderID() == Rewinder::INVALID_REWINDER_ID)
+        return false;
+    ids->push_back(r->getRewinderID());
+    return true;
+}   // getChangedRewinders
+
 // ----------------------------------------------------------------------------
 void GameProtocol::update(int ticks)
 {
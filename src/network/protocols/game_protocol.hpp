@@ -27,11 +27,16 @@
 #include "utils/singleton.hpp"
 
 #include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <tuple>
 
 class BareNetworkString;
+class InterestManager;
 class NetworkItemManager;
 class NetworkString;
 class STKPeer;
@@ -49,9 +54,25 @@ private:
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_DELTA_STATE,
+           GP_STATE_ACK,
+           GP_REWINDER_IDS
     };
 
+    /** Number of states kept as possible baseline for delta states. */
+    static const unsigned MAX_STATE_SNAPSHOTS = 32;
+
+    /** The data of each rewinder in a full state, saved on the server after
+     *  sending it and on the client after receiving it, so it can be used as
+     *  baseline for delta states. */
+    struct StateSnapshot
+    {
+        int m_ticks;
+        std::vector<uint16_t> m_rewinder_using;
+        std::map<uint16_t, std::vector<uint8_t> > m_rewinder_data;
+    };   // struct StateSnapshot
+
     /** A network string that collects all information from the server to be sent
      *  next. */
     NetworkString *m_data_to_send;
@@ -60,6 +81,29 @@ private:
      *  to reduce number of rollbacks. */
     std::vector<int8_t> m_adjust_time;
 
+    /** True if states are sent (server) or acknowledged (client) as delta
+     *  to a previous state. */
+    bool m_delta_state;
+
+    /** Server only: selects the rewinders sent to each peer if enabled. */
+    InterestManager* m_interest_manager;
+
+    /** Recently saved full states, the latest one is at the back. */
+    std::deque<StateSnapshot> m_state_snapshots;
+
+    /** Server only: the ticks of the latest state received by each peer. */
+    std::map<std::weak_ptr<STKPeer>, int,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_peer_acked_state;
+
+    /** Protects m_peer_acked_state which is updated by the network thread. */
+    std::mutex m_peer_acked_state_mutex;
+
+    /** Server only: live joining peers which need all rewinder ids. */
+    std::vector<std::weak_ptr<STKPeer> > m_live_join_peers;
+
+    /** Protects m_live_join_peers. */
+    std::mutex m_live_join_peers_mutex;
+
     // Dummy data structure to save all kart actions.
     struct Action
     {
@@ -76,6 +120,13 @@ private:
 
     void handleControllerAction(Event *event);
     void handleState(Event *event);
+    void handleDeltaState(Event *event);
+    void handleStateAck(Event *event);
+    void handleRewinderIDs(Event *event);
+    void sendStateAck(int ticks);
+    void saveStateSnapshot(int ticks, BareNetworkString& data);
+    const StateSnapshot* findStateSnapshot(int ticks) const;
+    NetworkString* encodeDeltaState(const StateSnapshot& baseline);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
     static std::weak_ptr<GameProtocol> m_game_protocol;
@@ -112,13 +163,17 @@ public:
     void controllerAction(int kart_id, PlayerAction action,
                           int value, int val_l, int val_r);
     void startNewState();
-    void addState(BareNetworkString *buffer);
     void sendState();
-    void finalizeState(std::vector<std::string>& cur_rewinder);
+    void finalizeState(uint16_t rewinder_count);
     void sendItemEventConfirmation(int ticks);
+    void sendRewinderIDs(const std::vector<uint16_t>& ids);
+    void addLiveJoinPeer(std::shared_ptr<STKPeer> peer);
+    void sendAllRewinderIDsToLiveJoinPeers();
 
     virtual void undo(BareNetworkString *buffer) OVERRIDE;
     virtual void rewind(BareNetworkString *buffer) OVERRIDE;
+    virtual bool getChangedRewinders(BareNetworkString *buffer,
+                                     std::vector<uint16_t>* ids) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void setup() OVERRIDE {};
     // ------------------------------------------------------------------------
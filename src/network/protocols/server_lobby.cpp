@@ -40,6 +40,7 @@
 #include "network/protocols/game_protocol.hpp"
 #include "network/protocols/game_events_protocol.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
@@ -1958,6 +1959,8 @@ void ServerLobby::finishedLoadingLiveJoinClient(Event* event)
     assert(nim);
     nim->saveCompleteState(ns);
     nim->addLiveJoinPeer(peer);
+    if (auto gp = GameProtocol::lock())
+        gp->addLiveJoinPeer(peer);
 
     w->saveCompleteState(ns, peer.get());
     if (race_manager->supportsLiveJoining())
@@ -2703,6 +2706,8 @@ void ServerLobby::checkRaceFinished()
     if (!RaceEventManager::getInstance()->isRaceOver()) return;
 
     Log::info("ServerLobby", "The game is considered finished.");
+    if (RewindManager::isEnabled())
+        RewindManager::get()->writeStatistics();
     // notify the network world that it is stopped
     RaceEventManager::getInstance()->stop();
 
@@ -3296,6 +3301,8 @@ void ServerLobby::connectionRequested(Event* event)
         data.decodeString(&cap);
         caps.insert(cap);
     }
+    event->getPeer()->setCoalescePackets(
+        caps.find("coalesced_packets") != caps.end());
     event->getPeer()->setClientCapabilities(caps);
     if (!handleAssets(data, event->getPeer()))
         return;
@@ -3515,9 +3522,15 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
     message_ack->addUInt8(LE_CONNECTION_ACCEPTED).addUInt32(peer->getHostId())
         .addUInt32(ServerConfig::m_server_version);
 
-    message_ack->addUInt16(
-        (uint16_t)stk_config->m_network_capabilities.size());
-    for (const std::string& cap : stk_config->m_network_capabilities)
+    // Clients only acknowledge received states if delta state is enabled,
+    // and save predicted states if interest state is enabled
+    std::set<std::string> server_caps = stk_config->m_network_capabilities;
+    if (!ServerConfig::m_delta_state)
+        server_caps.erase("delta_state");
+    if (!ServerConfig::m_interest_state)
+        server_caps.erase("interest_state");
+    message_ack->addUInt16((uint16_t)server_caps.size());
+    for (const std::string& cap : server_caps)
         message_ack->encodeString(cap);
 
     message_ack->addFloat(auto_start_timer)
@@ -24,6 +24,91 @@
 #include "items/projectile_manager.hpp"
 #include "utils/log.hpp"
 
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+/** A pool of memory blocks used by all RewindInfo. Freed blocks are kept in
+ *  a free list and reused, they are only released when the program exits.
+ *  It is used by the main thread and network thread.
+ */
+class RewindInfoPool
+{
+private:
+    /** Number of blocks allocated at once. */
+    static const unsigned BLOCKS_PER_CHUNK = 256;
+
+    std::mutex m_mutex;
+
+    /** Size of each block, which is large enough for all RewindInfo
+     *  classes. Larger objects are not allocated from the pool. */
+    size_t m_block_size;
+
+    /** First free block, each free block stores the pointer to the next
+     *  one. */
+    void* m_free_list;
+
+    std::vector<void*> m_chunks;
+
+public:
+    // ------------------------------------------------------------------------
+    RewindInfoPool()
+    {
+        m_block_size = std::max(sizeof(RewindInfoState),
+            std::max(sizeof(RewindInfoEvent),
+            sizeof(RewindInfoEventFunction)));
+        const size_t align = alignof(std::max_align_t);
+        m_block_size = (m_block_size + align - 1) / align * align;
+        m_free_list = NULL;
+    }   // RewindInfoPool
+    // ------------------------------------------------------------------------
+    ~RewindInfoPool()
+    {
+        for (void* chunk : m_chunks)
+            ::operator delete(chunk);
+    }   // ~RewindInfoPool
+    // ------------------------------------------------------------------------
+    void* allocate(size_t size)
+    {
+        if (size > m_block_size)
+            return ::operator new(size);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free_list)
+        {
+            char* chunk = (char*)::operator new(m_block_size *
+                BLOCKS_PER_CHUNK);
+            m_chunks.push_back(chunk);
+            for (unsigned i = 0; i < BLOCKS_PER_CHUNK; i++)
+            {
+                void* block = chunk + i * m_block_size;
+                *(void**)block = m_free_list;
+                m_free_list = block;
+            }
+        }
+        void* block = m_free_list;
+        m_free_list = *(void**)block;
+        return block;
+    }   // allocate
+    // ------------------------------------------------------------------------
+    void free(void* block, size_t size)
+    {
+        if (size > m_block_size)
+        {
+            ::operator delete(block);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *(void**)block = m_free_list;
+        m_free_list = block;
+    }   // free
+};   // class RewindInfoPool
+
+RewindInfoPool g_rewind_info_pool;
+
+}   // anonymous namespace
+
+// ============================================================================
 /** Constructor for a state: it only takes the size, and allocates a buffer
  *  for all state info.
  *  \param size Necessary buffer size for a state.
@@ -32,8 +117,22 @@ RewindInfo::RewindInfo(int ticks, bool is_confirmed)
 {
     m_ticks        = ticks;
     m_is_confirmed = is_confirmed;
+    m_replayed     = false;
 }   // RewindInfo
 
+// ----------------------------------------------------------------------------
+void* RewindInfo::operator new(size_t size)
+{
+    return g_rewind_info_pool.allocate(size);
+}   // operator new
+
+// ----------------------------------------------------------------------------
+void RewindInfo::operator delete(void* p, size_t size)
+{
+    if (p)
+        g_rewind_info_pool.free(p, size);
+}   // operator delete
+
 // ----------------------------------------------------------------------------
 /** Adjusts the time of this RewindInfo. This is only called on the server
  *  in case that an event is received in the past - in this case the server
@@ -48,11 +147,9 @@ void RewindInfo::setTicks(int ticks)
 
 // ============================================================================
 RewindInfoState::RewindInfoState(int ticks, int start_offset,
-                                 std::vector<std::string>& rewinder_using,
                                  std::vector<uint8_t>& buffer)
                : RewindInfo(ticks, true/*is_confirmed*/)
 {
-    std::swap(m_rewinder_using, rewinder_using);
     m_start_offset = start_offset;
     m_buffer = new BareNetworkString();
     std::swap(m_buffer->getBuffer(), buffer);
@@ -78,23 +175,47 @@ void RewindInfoState::restore()
 {
     m_buffer->reset();
     m_buffer->skip(m_start_offset);
-    for (const std::string& name : m_rewinder_using)
+    RewindManager* rwm = RewindManager::get();
+    // Rewinders left out by the server (see InterestManager) use the state
+    // predicted locally, they are restored in the order of unique identity
+    // together with the others
+    std::vector<uint16_t> deferred(m_buffer->getUInt16());
+    for (uint16_t& id : deferred)
+        id = m_buffer->getUInt16();
+    unsigned next_deferred = 0;
+    const unsigned count = m_buffer->getUInt16();
+    std::string state_uid;
+    for (unsigned i = 0; i < count; i++)
     {
+        const uint16_t id =
+            RewindManager::decodeRewinderID(m_buffer, &state_uid);
+        if (!state_uid.empty())
+            rwm->bindRewinderID(id, state_uid);
+        const std::string& uid = rwm->getRewinderUID(id);
+        while (next_deferred < deferred.size() &&
+            rwm->getRewinderUID(deferred[next_deferred]) < uid)
+            rwm->restorePredictedState(getTicks(), deferred[next_deferred++]);
         const uint16_t data_size = m_buffer->getUInt16();
         const unsigned current_offset_now = m_buffer->getCurrentOffset();
-        std::shared_ptr<Rewinder> r =
-            RewindManager::get()->getRewinder(name);
+        std::shared_ptr<Rewinder> r = rwm->getRewinder(id);
 
-        if (!r)
+        if (!r && !uid.empty())
         {
             // For now we only need to get missing rewinder from
             // projectile_manager
-            r = projectile_manager->addRewinderFromNetworkState(name);
+            r = projectile_manager->addRewinderFromNetworkState(uid);
         }
         if (!r)
         {
-            Log::error("RewindInfoState", "Missing rewinder %s",
-                name.c_str());
+            // Unknown id happens if the state arrives before its
+            // GP_REWINDER_IDS message
+            Log::error("RewindInfoState", "Missing rewinder %d", id);
+            m_buffer->skip(data_size);
+            continue;
+        }
+        // Frozen rewinders keep their current state in a partial rewind
+        if (r->isFrozen())
+        {
             m_buffer->skip(data_size);
             continue;
         }
@@ -119,6 +240,8 @@ void RewindInfoState::restore()
             m_buffer->skip(current_offset_now + data_size);
         }
     }   // for all rewinder
+    while (next_deferred < deferred.size())
+        rwm->restorePredictedState(getTicks(), deferred[next_deferred++]);
 }   // restore
 
 // ============================================================================
@@ -26,6 +26,7 @@
 #include "utils/ptr_vector.hpp"
 
 #include <assert.h>
+#include <cstddef>
 #include <functional>
 #include <string>
 #include <vector>
@@ -54,11 +55,20 @@ private:
      *  object.  */
     bool m_is_confirmed;
 
+    /** True once this RewindInfo was replayed, so events received from
+     *  network in the past can be found before a rewind. */
+    bool m_replayed;
+
 public:
     RewindInfo(int ticks, bool is_confirmed);
 
     void setTicks(int ticks);
 
+    /** RewindInfo are allocated from a pool, since many of them are created
+     *  and deleted every frame. */
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     /** Called when going back in time to undo any rewind information. */
     virtual void undo() = 0;
     /** This is called to restore a state before replaying the events. */
@@ -78,6 +88,16 @@ public:
     /** Returns if this RewindInfo is confirmed. */
     bool isConfirmed() const { return m_is_confirmed; }
     // ------------------------------------------------------------------------
+    void setReplayed() { m_replayed = true; }
+    // ------------------------------------------------------------------------
+    /** Returns true if this RewindInfo was replayed at least once. */
+    bool isReplayed() const { return m_replayed; }
+    // ------------------------------------------------------------------------
+    /** Adds the ids of all rewinders changed by this RewindInfo to the list.
+     *  \return False if any rewinder can be changed. */
+    virtual bool getChangedRewinders(std::vector<uint16_t>* ids)
+                                                              { return false; }
+    // ------------------------------------------------------------------------
     /** If this RewindInfo is an event. Subclasses will overwrite this. */
     virtual bool isEvent() const { return false; }
     // ------------------------------------------------------------------------
@@ -92,8 +112,8 @@ public:
 class RewindInfoState: public RewindInfo
 {
 private:
-    std::vector<std::string> m_rewinder_using;
-
+    /** Offset of the number of rewinders in the buffer, which is followed by
+     *  the rewinder id, data size and data of each rewinder. */
     int m_start_offset;
 
     /** Pointer to the buffer which stores all states. */
@@ -102,7 +122,6 @@ private:
 public:
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, int start_offset,
-                    std::vector<std::string>& rewinder_using,
                     std::vector<uint8_t>& buffer);
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, BareNetworkString *buffer, bool is_confirmed);
@@ -114,6 +133,9 @@ public:
     /** Returns a pointer to the state buffer. */
     BareNetworkString *getBuffer() const { return m_buffer; }
     // ------------------------------------------------------------------------
+    /** Returns the offset of the rewinder data in the state buffer. */
+    int getStartOffset() const { return m_start_offset; }
+    // ------------------------------------------------------------------------
     virtual bool isState() const { return true; }
     // ------------------------------------------------------------------------
     /** Called when going back in time to undo any rewind information.
@@ -174,6 +196,12 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the buffer with the event information in it. */
     BareNetworkString *getBuffer() { return m_buffer; }
+    // ------------------------------------------------------------------------
+    virtual bool getChangedRewinders(std::vector<uint16_t>* ids) OVERRIDE
+    {
+        m_buffer->reset();
+        return m_event_rewinder->getChangedRewinders(m_buffer, ids);
+    }   // getChangedRewinders
 };   // class RewindIndoEvent
 
 
@@ -18,6 +18,7 @@
 
 #include "network/rewind_manager.hpp"
 
+#include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "modes/world.hpp"
 #include "network/network_config.hpp"
@@ -26,18 +27,38 @@
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
 #include "network/smooth_network_body.hpp"
+#include "network/socket_address.hpp"
+#include "network/stk_host.hpp"
+#include "network/stk_peer.hpp"
 #include "physics/physics.hpp"
 #include "race/history.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/vec3.hpp"
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 
 RewindManager* RewindManager::m_rewind_manager = NULL;
 bool           RewindManager::m_enable_rewind_manager = false;
+std::string    RewindManager::m_statistics_file;
+
+namespace
+{
+    /** Upper bound of the speed (in m/s) of a rewinder with position, used
+     *  in a partial rewind to find the rewinders which can meet while
+     *  replaying. Cakes are the fastest (speed="50" in powerup.xml), karts
+     *  (max-speed="25" in kart_characteristics.xml) stay below it even with
+     *  nitro and zipper. */
+    const float MAX_REWINDER_SPEED = 50.0f;
+}
 
 /** Creates the singleton. */
 RewindManager *RewindManager::create()
@@ -61,6 +82,8 @@ void RewindManager::destroy()
  */
 RewindManager::RewindManager()
 {
+    m_full_rewinds = 0;
+    m_partial_rewinds = 0;
     reset();
 }   // RewindManager
 
@@ -80,11 +103,39 @@ RewindManager::~RewindManager()
  */
 void RewindManager::reset()
 {
+    if (m_full_rewinds + m_partial_rewinds > 0)
+    {
+        Log::info("RewindManager", "%u full rewinds and %u partial rewinds.",
+            m_full_rewinds, m_partial_rewinds);
+    }
+    m_full_rewinds = 0;
+    m_partial_rewinds = 0;
+    m_rewind_depths.clear();
+    m_rewound_ticks = 0;
+    m_rewind_time = 0.0;
+    m_max_rewind_time = 0.0;
+    m_state_count.store(0);
+    m_state_bytes.store(0);
+    m_max_state_size = 0;
+    m_statistics_start_time = StkTime::getRealTime();
     m_is_rewinding = false;
+    m_is_partial_rewinding = false;
     m_not_rewound_ticks.store(0);
     m_overall_state_size = 0;
     m_state_frequency = stk_config->getPhysicsFPS() /
         NetworkConfig::get()->getStateFrequency();
+    m_recent_rewinder_ticks = stk_config->time2Ticks(1.0f);
+    // Clients can still have states or events of the destroyed rewinder
+    // (with its unique identity inline for m_recent_rewinder_ticks) which
+    // have not been received or rewound to yet
+    m_free_rewinder_ticks = m_recent_rewinder_ticks * 5;
+    m_predicted_state.clear();
+    const auto& server_caps = NetworkConfig::get()->getServerCapabilities();
+    m_partial_rewind = NetworkConfig::get()->isClient() &&
+        UserConfigParams::m_partial_rewind;
+    m_save_predicted_state = m_partial_rewind ||
+        (NetworkConfig::get()->isClient() &&
+        server_caps.find("interest_state") != server_caps.end());
 
     if (!m_enable_rewind_manager) return;
 
@@ -140,6 +191,8 @@ void RewindManager::addNetworkEvent(EventRewinder *event_rewinder,
 void RewindManager::addNetworkState(BareNetworkString *buffer, int ticks)
 {
     assert(NetworkConfig::get()->isClient());
+    m_state_count.fetch_add(1);
+    m_state_bytes.fetch_add(buffer->getTotalSize());
     m_rewind_queue.addNetworkState(buffer, ticks);
 }   // addNetworkState
 
@@ -153,28 +206,94 @@ void RewindManager::saveState()
     auto gp = GameProtocol::lock();
     if (!gp)
         return;
+
+    // Send the newly added rewinder ids reliably to clients, states may
+    // still include the unique identity for a short time as they can arrive
+    // earlier
+    if (!m_new_rewinder_ids.empty())
+    {
+        gp->sendRewinderIDs(m_new_rewinder_ids);
+        m_new_rewinder_ids.clear();
+    }
+    gp->sendAllRewinderIDsToLiveJoinPeers();
     gp->startNewState();
 
-    m_overall_state_size = 0;
-    std::vector<std::string> rewinder_using;
+    NetworkString* buffer = gp->getState();
+    const unsigned start_size = buffer->getTotalSize();
+    World* world = World::getWorld();
+    freeExpiredRewinderIDs(world->getTicksSinceStart());
+    uint16_t count = saveRewinderStates(buffer, world->getTicksSinceStart());
+    m_overall_state_size = buffer->getTotalSize() - start_size;
+    m_max_state_size = std::max(m_max_state_size, m_overall_state_size);
+    m_state_count.fetch_add(1);
+    m_state_bytes.fetch_add(m_overall_state_size);
+    gp->finalizeState(count);
+    PROFILER_POP_CPU_MARKER();
+}   // saveState
 
-    for (auto& p : m_all_rewinder)
+// ----------------------------------------------------------------------------
+/** Server only: puts the rewinder ids of rewinders which were destroyed at
+ *  least m_free_rewinder_ticks ago into the free list, so that a long race
+ *  with many flyables does not use up all rewinder ids, and the number of
+ *  entries to check when saving states stays small.
+ *  \param ticks Current world ticks.
+ */
+void RewindManager::freeExpiredRewinderIDs(int ticks)
+{
+    for (unsigned i = 0; i < m_all_rewinder.size(); i++)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
-        BareNetworkString* buffer = NULL;
-        if (auto r = p.second.lock())
-            buffer = r->saveState(&rewinder_using);
-        if (buffer != NULL)
+        RewinderEntry& re = m_all_rewinder[i];
+        if (re.m_uid.empty() || !re.m_rewinder.expired())
+            continue;
+        if (re.m_expired_ticks == -1)
         {
-            m_overall_state_size += buffer->size();
-            gp->addState(buffer);
+            re.m_expired_ticks = ticks;
+            continue;
         }
-        delete buffer;    // buffer can be freed
+        if (ticks - re.m_expired_ticks < m_free_rewinder_ticks)
+            continue;
+        m_rewinder_ids.erase(re.m_uid);
+        re.m_uid.clear();
+        m_free_rewinder_ids.push_back((uint16_t)i);
     }
-    gp->finalizeState(rewinder_using);
-    PROFILER_POP_CPU_MARKER();
-}   // saveState
+}   // freeExpiredRewinderIDs
+
+// ----------------------------------------------------------------------------
+/** Appends the rewinder id, data size and state of all rewinders to the
+ *  buffer. The rewinders write directly into the buffer, which is reused
+ *  for each state, and the data size is filled in afterwards, so no memory
+ *  is allocated once the buffer is large enough.
+ *  The states are written in the order of unique identity, which is the
+ *  order clients restore them (see Rewinder::m_unique_identity).
+ *  \param buffer The buffer to write to.
+ *  \param ticks Time of the state.
+ *  \return Number of rewinders which saved a state.
+ */
+uint16_t RewindManager::saveRewinderStates(BareNetworkString* buffer,
+                                           int ticks)
+{
+    uint16_t count = 0;
+    for (auto& p : m_rewinder_ids)
+    {
+        std::shared_ptr<Rewinder> r =
+            m_all_rewinder[p.second].m_rewinder.lock();
+        if (!r)
+            continue;
+        const unsigned entry_start = buffer->getTotalSize();
+        encodeRewinderID(buffer, p.second, ticks);
+        const unsigned size_pos = buffer->getTotalSize();
+        buffer->addUInt16(0);
+        if (!r->saveState(buffer))
+        {
+            buffer->truncate(entry_start);
+            continue;
+        }
+        buffer->setUInt16(size_pos,
+            (uint16_t)(buffer->getTotalSize() - size_pos - 2));
+        count++;
+    }
+    return count;
+}   // saveRewinderStates
 
 // ----------------------------------------------------------------------------
 /** Determines if a new state snapshot should be taken, and if so calls all
@@ -185,10 +304,17 @@ void RewindManager::update(int ticks_not_used)
 {
     // FIXME: rename ticks_not_used
     if (!m_enable_rewind_manager ||
-        m_all_rewinder.size() == 0 ||
-        m_is_rewinding)  return;
+        (m_all_rewinder.empty() && m_unbound_rewinder.empty()))
+        return;
 
     int ticks = World::getWorld()->getTicksSinceStart();
+    if (m_is_rewinding)
+    {
+        // The predicted states are updated with the corrected prediction
+        if (m_save_predicted_state && shouldSaveState(ticks))
+            savePredictedState(ticks);
+        return;
+    }
 
     m_not_rewound_ticks.store(ticks, std::memory_order_relaxed);
 
@@ -200,11 +326,10 @@ void RewindManager::update(int ticks_not_used)
     if (NetworkConfig::get()->isClient())
     {
         auto& ret = m_local_state[ticks];
-        for (auto& p : m_all_rewinder)
-        {
-            if (auto r = p.second.lock())
-                ret.push_back(r->getLocalStateRestoreFunction());
-        }
+        for (auto& r : getAllRewinders())
+            ret.emplace_back(r, r->getLocalStateRestoreFunction());
+        if (m_save_predicted_state)
+            savePredictedState(ticks);
     }
     else
     {
@@ -216,6 +341,123 @@ void RewindManager::update(int ticks_not_used)
     PROFILER_POP_CPU_MARKER();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Client only: saves the state of all bound rewinders with position, which
+ *  is used if the server leaves them out in the state of the same ticks, and
+ *  to find the rewinders which need to be rewound in a partial rewind.
+ *  \param ticks Time of the state.
+ */
+void RewindManager::savePredictedState(int ticks)
+{
+    BareNetworkString buffer;
+    std::vector<uint8_t>& predicted = m_predicted_state[ticks];
+    // Frozen rewinders keep their previously predicted state
+    std::vector<uint8_t> previous;
+    if (m_is_partial_rewinding)
+        previous = predicted;
+    std::swap(buffer.getBuffer(), predicted);
+    buffer.getBuffer().clear();
+    Vec3 xyz;
+    for (unsigned i = 0; i < m_all_rewinder.size(); i++)
+    {
+        std::shared_ptr<Rewinder> r = m_all_rewinder[i].m_rewinder.lock();
+        if (!r || !r->getInterestPosition(&xyz))
+            continue;
+        const unsigned entry_start = buffer.getTotalSize();
+        if (r->isFrozen())
+        {
+            unsigned offset;
+            uint16_t size;
+            if (findPredictedState(previous, (uint16_t)i, &offset, &size))
+            {
+                buffer.addUInt16((uint16_t)i).addUInt16(size);
+                buffer.getBuffer().insert(buffer.getBuffer().end(),
+                    previous.begin() + offset,
+                    previous.begin() + offset + size);
+            }
+            continue;
+        }
+        buffer.addUInt16((uint16_t)i).addUInt16(0);
+        if (!r->saveState(&buffer))
+        {
+            buffer.truncate(entry_start);
+            continue;
+        }
+        buffer.setUInt16(entry_start + 2,
+            (uint16_t)(buffer.getTotalSize() - entry_start - 4));
+    }
+    std::swap(buffer.getBuffer(), predicted);
+}   // savePredictedState
+
+// ----------------------------------------------------------------------------
+/** Finds the data of a rewinder in a predicted state.
+ *  \param state The predicted state.
+ *  \param id Rewinder id.
+ *  \param offset Set to the offset of the data in the predicted state.
+ *  \param size Set to the size of the data.
+ *  \return False if the predicted state has no data for the rewinder.
+ */
+bool RewindManager::findPredictedState(std::vector<uint8_t>& state,
+                                       uint16_t id, unsigned* offset,
+                                       uint16_t* size)
+{
+    BareNetworkString buffer;
+    std::swap(buffer.getBuffer(), state);
+    bool found = false;
+    try
+    {
+        while (buffer.size() > 0)
+        {
+            const uint16_t state_id = buffer.getUInt16();
+            *size = buffer.getUInt16();
+            if (state_id == id)
+            {
+                *offset = buffer.getCurrentOffset();
+                found = true;
+                break;
+            }
+            buffer.skip(*size);
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::error("RewindManager", "Wrong predicted state: %s", e.what());
+    }
+    std::swap(buffer.getBuffer(), state);
+    return found;
+}   // findPredictedState
+
+// ----------------------------------------------------------------------------
+/** Client only: restores the locally predicted state of a rewinder which is
+ *  left out by the server in a state.
+ *  \param ticks Time of the state.
+ *  \param id Rewinder id.
+ */
+void RewindManager::restorePredictedState(int ticks, uint16_t id)
+{
+    std::shared_ptr<Rewinder> r = getRewinder(id);
+    auto it = m_predicted_state.find(ticks);
+    unsigned offset;
+    uint16_t data_size;
+    if (!r || r->isFrozen() || it == m_predicted_state.end() ||
+        !findPredictedState(it->second, id, &offset, &data_size))
+        return;
+
+    BareNetworkString buffer;
+    std::swap(buffer.getBuffer(), it->second);
+    try
+    {
+        buffer.skip(offset);
+        r->restoreState(&buffer, data_size);
+    }
+    catch (std::exception& e)
+    {
+        Log::error("RewindManager", "Restore predicted state error: %s",
+            e.what());
+    }
+    std::swap(buffer.getBuffer(), it->second);
+}   // restorePredictedState
+
 // ----------------------------------------------------------------------------
 /** Replays all events from the last event played till the specified time.
  *  \param world_ticks Up to (and inclusive) which time events will be replayed.
@@ -228,6 +470,7 @@ void RewindManager::playEventsTill(int world_ticks, bool fast_forward)
     // possible rewind, some RewindInfoEventFunction can be created during
     // rewind
     mergeRewindInfoEventFunction();
+    mergeRewinderIDs();
     bool needs_rewind;
     int rewind_ticks;
 
@@ -268,13 +511,334 @@ void RewindManager::playEventsTill(int world_ticks, bool fast_forward)
 bool RewindManager::addRewinder(std::shared_ptr<Rewinder> rewinder)
 {
     if (!m_enable_rewind_manager) return false;
-    // Maximum 1 bit to store no of rewinder used
-    if (m_all_rewinder.size() == 255)
-        return false;
-    m_all_rewinder[rewinder->getUniqueIdentity()] = rewinder;
+    const std::string& uid = rewinder->getUniqueIdentity();
+    auto it = m_rewinder_ids.find(uid);
+    // Re-added rewinder (for example re-created flyable or live join kart)
+    // uses the same rewinder id
+    if (it != m_rewinder_ids.end())
+    {
+        rewinder->setRewinderID(it->second);
+        m_all_rewinder[it->second].m_rewinder = rewinder;
+        m_all_rewinder[it->second].m_expired_ticks = -1;
+        return true;
+    }
+
+    if (NetworkConfig::get()->isClient())
+    {
+        m_unbound_rewinder[uid] = rewinder;
+        return true;
+    }
+
+    uint16_t id;
+    if (!m_free_rewinder_ids.empty())
+    {
+        id = m_free_rewinder_ids.back();
+        m_free_rewinder_ids.pop_back();
+    }
+    else
+    {
+        // Highest bit of rewinder id is used when sending state
+        if (m_all_rewinder.size() == Rewinder::INVALID_REWINDER_ID)
+            return false;
+        id = (uint16_t)m_all_rewinder.size();
+        m_all_rewinder.emplace_back();
+    }
+    RewinderEntry& re = m_all_rewinder[id];
+    re.m_rewinder = rewinder;
+    re.m_uid = uid;
+    re.m_added_ticks = World::getWorld() ?
+        World::getWorld()->getTicksSinceStart() : 0;
+    re.m_expired_ticks = -1;
+    m_rewinder_ids[uid] = id;
+    m_new_rewinder_ids.push_back(id);
+    rewinder->setRewinderID(id);
     return true;
 }   // addRewinder
 
+// ----------------------------------------------------------------------------
+/** Client only: binds the rewinder id received from server to the unique
+ *  identity, if the rewinder was already created locally it can be found
+ *  by the rewinder id in game states now.
+ *  \param id Rewinder id assigned by server.
+ *  \param uid The unique identity of the rewinder.
+ */
+void RewindManager::bindRewinderID(uint16_t id, const std::string& uid)
+{
+    if (id >= Rewinder::INVALID_REWINDER_ID)
+        return;
+    if (id >= m_all_rewinder.size())
+    {
+        RewinderEntry re;
+        re.m_added_ticks = 0;
+        re.m_expired_ticks = -1;
+        m_all_rewinder.resize(id + 1, re);
+    }
+    RewinderEntry& re = m_all_rewinder[id];
+    if (re.m_uid == uid)
+        return;
+
+    // The server reuses the rewinder ids of destroyed rewinders, a rewinder
+    // still alive locally with the old unique identity becomes unbound
+    if (!re.m_uid.empty())
+    {
+        auto old_id = m_rewinder_ids.find(re.m_uid);
+        if (old_id != m_rewinder_ids.end() && old_id->second == id)
+            m_rewinder_ids.erase(old_id);
+        if (auto r = re.m_rewinder.lock())
+        {
+            r->setRewinderID(Rewinder::INVALID_REWINDER_ID);
+            m_unbound_rewinder[re.m_uid] = r;
+        }
+        re.m_rewinder.reset();
+    }
+    re.m_uid = uid;
+
+    // The same unique identity can get a new rewinder id if the server
+    // re-created it after its old rewinder id was freed
+    auto it_id = m_rewinder_ids.find(uid);
+    if (it_id != m_rewinder_ids.end())
+    {
+        RewinderEntry& old_re = m_all_rewinder[it_id->second];
+        if (auto r = old_re.m_rewinder.lock())
+            m_unbound_rewinder[uid] = r;
+        old_re.m_rewinder.reset();
+        old_re.m_uid.clear();
+    }
+    m_rewinder_ids[uid] = id;
+
+    auto it = m_unbound_rewinder.find(uid);
+    if (it != m_unbound_rewinder.end())
+    {
+        if (auto r = it->second.lock())
+        {
+            r->setRewinderID(id);
+            re.m_rewinder = r;
+        }
+        m_unbound_rewinder.erase(it);
+    }
+}   // bindRewinderID
+
+// ----------------------------------------------------------------------------
+/** Binds all rewinder ids received by network thread. */
+void RewindManager::mergeRewinderIDs()
+{
+    m_pending_rewinder_ids.lock();
+    for (auto& p : m_pending_rewinder_ids.getData())
+        bindRewinderID(p.first, p.second);
+    m_pending_rewinder_ids.getData().clear();
+    m_pending_rewinder_ids.unlock();
+}   // mergeRewinderIDs
+
+// ----------------------------------------------------------------------------
+/** Server only: writes the given rewinder ids and their unique identity.
+ *  \param ns The network string to write to.
+ *  \param ids List of rewinder ids.
+ */
+void RewindManager::encodeRewinderIDs(BareNetworkString* ns,
+                                      const std::vector<uint16_t>& ids) const
+{
+    ns->addUInt16((uint16_t)ids.size());
+    for (uint16_t id : ids)
+        ns->addUInt16(id).encodeString(m_all_rewinder[id].m_uid);
+}   // encodeRewinderIDs
+
+// ----------------------------------------------------------------------------
+/** Server only: writes a rewinder id in a state. The unique identity is
+ *  included (with the highest bit of the id set) if the rewinder was added
+ *  recently, because the state may arrive earlier than the reliable
+ *  message with the rewinder ids.
+ *  \param ns The network string to write to.
+ *  \param id The rewinder id.
+ *  \param ticks Time of the state.
+ */
+void RewindManager::encodeRewinderID(BareNetworkString* ns, uint16_t id,
+                                     int ticks) const
+{
+    if (isRecentRewinderID(id, ticks))
+        ns->addUInt16(id | 0x8000).encodeString(m_all_rewinder[id].m_uid);
+    else
+        ns->addUInt16(id);
+}   // encodeRewinderID
+
+// ----------------------------------------------------------------------------
+/** Reads a rewinder id written by encodeRewinderID.
+ *  \param ns The network string to read from.
+ *  \param uid Set to the unique identity if it was included, or cleared.
+ *  \return The rewinder id.
+ */
+uint16_t RewindManager::decodeRewinderID(const BareNetworkString* ns,
+                                         std::string* uid)
+{
+    uint16_t id = ns->getUInt16();
+    uid->clear();
+    if ((id & 0x8000) == 0)
+        return id;
+    ns->decodeString(uid);
+    return id & 0x7fff;
+}   // decodeRewinderID
+
+// ----------------------------------------------------------------------------
+/** Server only: writes all rewinder ids currently in use, used for peers
+ *  live joining the game.
+ *  \param ns The network string to write to.
+ */
+void RewindManager::encodeAllRewinderIDs(BareNetworkString* ns) const
+{
+    std::vector<uint16_t> ids;
+    for (unsigned i = 0; i < m_all_rewinder.size(); i++)
+    {
+        if (!m_all_rewinder[i].m_rewinder.expired())
+            ids.push_back((uint16_t)i);
+    }
+    encodeRewinderIDs(ns, ids);
+}   // encodeAllRewinderIDs
+
+// ----------------------------------------------------------------------------
+/** Client only: finds the rewinders which can keep their current state when
+ *  rewinding to the confirmed state at the given ticks. Rewinders with a
+ *  position need to be rewound if their confirmed state differs from the
+ *  locally predicted state, if they are changed by an event received from
+ *  server which was not replayed yet, or if they are close to another
+ *  rewinder which is rewound (since they could collide while replaying).
+ *  Rewinders without position are always rewound.
+ *  \param rewind_ticks Time of the confirmed state.
+ *  \param now_ticks Current world time.
+ *  \param frozen Set to the rewinders keeping their current state.
+ *  \return False if all rewinders need to be rewound.
+ */
+bool RewindManager::findFrozenRewinders(int rewind_ticks, int now_ticks,
+                              std::vector<std::shared_ptr<Rewinder> >* frozen)
+{
+    auto predicted = m_predicted_state.find(rewind_ticks);
+    if (predicted == m_predicted_state.end())
+        return false;
+    RewindInfoState* state = NULL;
+    for (RewindInfo* ri : m_rewind_queue.getRewindInfo(rewind_ticks))
+    {
+        if (!ri->isState() || !ri->isConfirmed())
+            continue;
+        // States split into several ones are not handled
+        if (state)
+            return false;
+        state = static_cast<RewindInfoState*>(ri);
+    }
+    if (!state)
+        return false;
+
+    // The rewinders in the confirmed state (including the ones left out by
+    // server) and the rewinders which need to be rewound, by rewinder id
+    std::vector<bool> in_state(m_all_rewinder.size(), false);
+    std::vector<bool> rewound(m_all_rewinder.size(), false);
+    Vec3 xyz;
+    BareNetworkString* buffer = state->getBuffer();
+    try
+    {
+        buffer->reset();
+        buffer->skip(state->getStartOffset());
+        const unsigned deferred_count = buffer->getUInt16();
+        for (unsigned i = 0; i < deferred_count; i++)
+        {
+            const uint16_t id = buffer->getUInt16();
+            if (id < in_state.size())
+                in_state[id] = true;
+        }
+        const unsigned count = buffer->getUInt16();
+        std::string uid;
+        for (unsigned i = 0; i < count; i++)
+        {
+            const uint16_t id = decodeRewinderID(buffer, &uid);
+            const uint16_t data_size = buffer->getUInt16();
+            std::shared_ptr<Rewinder> r = getRewinder(id);
+            // A rewinder which is not (yet) known locally, for example a
+            // flyable which needs to be created
+            if (!r || (!uid.empty() && getRewinderUID(id) != uid))
+                return false;
+            in_state[id] = true;
+            if (r->getInterestPosition(&xyz))
+            {
+                unsigned offset;
+                uint16_t size;
+                rewound[id] =
+                    !findPredictedState(predicted->second, id, &offset,
+                    &size) || size != data_size ||
+                    memcmp(predicted->second.data() + offset,
+                    buffer->getCurrentData(), size) != 0;
+            }
+            buffer->skip(data_size);
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::error("RewindManager", "Wrong state at %d: %s", rewind_ticks,
+            e.what());
+        return false;
+    }
+
+    // A rewinder predicted locally but removed in the confirmed state
+    for (unsigned i = 0; i < m_all_rewinder.size(); i++)
+    {
+        unsigned offset;
+        uint16_t size;
+        if (!in_state[i] && findPredictedState(predicted->second,
+            (uint16_t)i, &offset, &size))
+            rewound[i] = true;
+    }
+
+    // Events received from server after the confirmed state
+    std::vector<uint16_t> ids;
+    for (int ticks = rewind_ticks; ticks < now_ticks; ticks++)
+    {
+        for (RewindInfo* ri : m_rewind_queue.getRewindInfo(ticks))
+        {
+            if (!ri->isEvent() || ri->isReplayed())
+                continue;
+            if (!ri->getChangedRewinders(&ids))
+                return false;
+        }
+    }
+    for (uint16_t id : ids)
+    {
+        if (id < rewound.size())
+            rewound[id] = true;
+    }
+
+    // Rewinders with position, the ones not rewound yet are after the
+    // rewound ones. Rewinders not bound to a rewinder id are always rewound.
+    std::vector<std::pair<std::shared_ptr<Rewinder>, Vec3> > all;
+    unsigned num_rewound = 0;
+    for (auto& r : getAllRewinders())
+    {
+        if (!r->getInterestPosition(&xyz))
+            continue;
+        const uint16_t id = r->getRewinderID();
+        all.emplace_back(r, xyz);
+        if (id >= rewound.size() || rewound[id])
+            std::swap(all[num_rewound++], all.back());
+    }
+
+    // Two objects moving towards each other can get closer by this distance
+    // while replaying, and kart to kart collisions start at about a kart
+    // length
+    const float distance = 5.0f + 2.0f * MAX_REWINDER_SPEED *
+        stk_config->ticks2Time(now_ticks - rewind_ticks);
+    const float distance2 = distance * distance;
+    for (unsigned i = 0; i < num_rewound; i++)
+    {
+        for (unsigned j = num_rewound; j < all.size(); j++)
+        {
+            if ((all[j].second - all[i].second).length2() < distance2)
+                std::swap(all[num_rewound++], all[j]);
+        }
+    }
+    if (num_rewound == all.size())
+        return false;
+
+    frozen->clear();
+    for (unsigned i = num_rewound; i < all.size(); i++)
+        frozen->push_back(all[i].first);
+    return true;
+}   // findFrozenRewinders
+
 // ----------------------------------------------------------------------------
 /** Rewinds to the specified time, then goes forward till the current
  *  World::getTime() is reached again: it will replay everything before
@@ -290,17 +854,43 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
                              bool fast_forward)
 {
     assert(!m_is_rewinding);
+    const double start_time = StkTime::getRealTime();
     bool is_history = history->replayHistory();
     history->setReplayHistory(false);
 
     // First save all current transforms so that the error
     // can be computed between the transforms before and after
     // the rewind.
-    for (auto& p : m_all_rewinder)
+    std::vector<std::shared_ptr<Rewinder> > all_rewinder = getAllRewinders();
+    for (auto& r : all_rewinder)
+        r->saveTransform();
+
+    // In a partial rewind the current state of frozen rewinders is restored
+    // after replaying, since events (like kart control) can still change them
+    std::vector<std::shared_ptr<Rewinder> > frozen;
+    BareNetworkString frozen_state;
+    if (m_partial_rewind && !fast_forward &&
+        findFrozenRewinders(rewind_ticks, now_ticks, &frozen))
     {
-        if (auto r = p.second.lock())
-            r->saveTransform();
+        for (unsigned i = 0; i < frozen.size(); i++)
+        {
+            const unsigned entry_start = frozen_state.getTotalSize();
+            frozen_state.addUInt16((uint16_t)i).addUInt16(0);
+            if (!frozen[i]->saveState(&frozen_state))
+            {
+                frozen_state.truncate(entry_start);
+                continue;
+            }
+            frozen_state.setUInt16(entry_start + 2,
+                (uint16_t)(frozen_state.getTotalSize() - entry_start - 4));
+        }
+        for (auto& r : frozen)
+            r->setFrozen(true);
+        m_is_partial_rewinding = true;
+        m_partial_rewinds++;
     }
+    else
+        m_full_rewinds++;
 
     // Then undo the rewind infos going backwards in time
     // --------------------------------------------------
@@ -331,8 +921,15 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
     {
         for (auto& restore_local_state : it->second)
         {
-            if (restore_local_state)
-                restore_local_state();
+            if (!restore_local_state.second)
+                continue;
+            if (m_is_partial_rewinding)
+            {
+                auto r = restore_local_state.first.lock();
+                if (!r || r->isFrozen())
+                    continue;
+            }
+            restore_local_state.second();
         }
         for (auto it = m_local_state.begin(); it != m_local_state.end();)
         {
@@ -356,6 +953,15 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
         m_rewind_queue.next();
         current = m_rewind_queue.getCurrent();
     }
+    // Older predicted states are no longer needed, the current one is saved
+    // again when replaying
+    for (auto it = m_predicted_state.begin(); it != m_predicted_state.end();)
+    {
+        if (it->first < exact_rewind_ticks)
+            it = m_predicted_state.erase(it);
+        else
+            break;
+    }
 
     // Update check line, so the cannon animation can be replayed correctly
     Track::getCurrentTrack()->getCheckManager()->resetAfterRewind();
@@ -390,18 +996,106 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
 
     }   // while (world->getTicks() < current_ticks)
 
-    // Now compute the errors which need to be visually smoothed
-    for (auto& p : m_all_rewinder)
+    if (m_is_partial_rewinding)
     {
-        if (auto r = p.second.lock())
-            r->computeError();
+        try
+        {
+            while (frozen_state.size() > 0)
+            {
+                const uint16_t i = frozen_state.getUInt16();
+                const uint16_t data_size = frozen_state.getUInt16();
+                frozen[i]->restoreState(&frozen_state, data_size);
+            }
+        }
+        catch (std::exception& e)
+        {
+            Log::error("RewindManager", "Restore frozen state error: %s",
+                e.what());
+        }
+        for (auto& r : frozen)
+            r->setFrozen(false);
+        m_is_partial_rewinding = false;
     }
 
+    // Now compute the errors which need to be visually smoothed, including
+    // rewinders created during the rewind
+    all_rewinder = getAllRewinders();
+    for (auto& r : all_rewinder)
+        r->computeError();
+
     history->setReplayHistory(is_history);
     m_is_rewinding = false;
     mergeRewindInfoEventFunction();
+
+    m_rewind_depths[now_ticks - exact_rewind_ticks]++;
+    m_rewound_ticks += now_ticks - exact_rewind_ticks;
+    const double rewind_time = StkTime::getRealTime() - start_time;
+    m_rewind_time += rewind_time;
+    m_max_rewind_time = std::max(m_max_rewind_time, rewind_time);
 }   // rewindTo
 
+// ----------------------------------------------------------------------------
+/** Writes the statistics of rewinds and states since the last reset, and
+ *  the amount of data sent to and received from each peer, as xml file (see
+ *  setStatisticsFile). Nothing is done if no file is set.
+ */
+void RewindManager::writeStatistics() const
+{
+    if (m_statistics_file.empty())
+        return;
+    std::ofstream f(FileUtils::getPortableWritingPath(m_statistics_file));
+    if (!f.is_open())
+    {
+        Log::error("RewindManager", "Cannot open '%s' for statistics.",
+            m_statistics_file.c_str());
+        return;
+    }
+
+    const double duration =
+        std::max(StkTime::getRealTime() - m_statistics_start_time, 0.001);
+    const int ticks = World::getWorld() ?
+        World::getWorld()->getTicksSinceStart() : 0;
+    const unsigned rewinds = m_full_rewinds + m_partial_rewinds;
+    f << "<?xml version=\"1.0\"?>\n";
+    f << "<rewind-statistics server=\""
+      << (NetworkConfig::get()->isServer() ? "true" : "false")
+      << "\" ticks=\"" << ticks << "\" time=\"" << duration << "\">\n";
+    f << "  <rewinds count=\"" << rewinds << "\" full=\"" << m_full_rewinds
+      << "\" partial=\"" << m_partial_rewinds << "\" per-second=\""
+      << rewinds / duration << "\" rewound-ticks=\"" << m_rewound_ticks
+      << "\" total-ms=\"" << m_rewind_time * 1000.0 << "\" average-ms=\""
+      << (rewinds > 0 ? m_rewind_time * 1000.0 / rewinds : 0.0)
+      << "\" max-ms=\"" << m_max_rewind_time * 1000.0 << "\">\n";
+    for (auto& depth : m_rewind_depths)
+    {
+        f << "    <depth ticks=\"" << depth.first << "\" count=\""
+          << depth.second << "\"/>\n";
+    }
+    f << "  </rewinds>\n";
+    const uint64_t state_bytes = m_state_bytes.load();
+    f << "  <states count=\"" << m_state_count.load() << "\" bytes=\""
+      << state_bytes << "\" bytes-per-second=\"" << state_bytes / duration
+      << "\" max-size=\"" << m_max_state_size << "\"/>\n";
+    if (STKHost::existHost())
+    {
+        for (auto& peer : STKHost::get()->getPeers())
+        {
+            f << "  <peer address=\"" << peer->getAddress().toString()
+              << "\" ping=\"" << peer->getAveragePing()
+              << "\" packet-loss=\"" << peer->getPacketLoss()
+              << "\" sent-bytes=\"" << peer->getSentBytes()
+              << "\" received-bytes=\"" << peer->getReceivedBytes()
+              << "\" sent-bytes-per-second=\""
+              << peer->getSentBytes() / duration
+              << "\" received-bytes-per-second=\""
+              << peer->getReceivedBytes() / duration << "\"/>\n";
+        }
+    }
+    f << "</rewind-statistics>\n";
+    Log::info("RewindManager", "Statistics written to '%s'.",
+        m_statistics_file.c_str());
+}   // writeStatistics
+
 // ----------------------------------------------------------------------------
 bool RewindManager::useLocalEvent() const
 {
@@ -413,7 +1107,11 @@ bool RewindManager::useLocalEvent() const
 void RewindManager::mergeRewindInfoEventFunction()
 {
     for (RewindInfoEventFunction* rief : m_pending_rief)
+    {
+        // The function was already called when it was added
+        rief->setReplayed();
         m_rewind_queue.insertRewindInfo(rief);
+    }
     m_pending_rief.clear();
 }   // mergeRewindInfoEventFunction
 
@@ -423,13 +1121,118 @@ void RewindManager::mergeRewindInfoEventFunction()
  */
 void RewindManager::resetSmoothNetworkBody()
 {
-    for (auto& p : m_all_rewinder)
+    for (auto& r : getAllRewinders())
+    {
+        auto snb = std::dynamic_pointer_cast<SmoothNetworkBody>(r);
+        if (snb)
+            snb->reset();
+    }
+}   // resetSmoothNetworkBody
+
+// ============================================================================
+namespace
+{
+/** A rewinder used in benchmark which writes the same amount of data as a
+ *  kart or flyable. */
+class BenchmarkRewinder : public Rewinder
+{
+private:
+    unsigned m_floats;
+    float m_value;
+public:
+    BenchmarkRewinder(const std::string& uid, unsigned floats)
+        : Rewinder(uid), m_floats(floats), m_value(0.0f) {}
+    // ------------------------------------------------------------------------
+    virtual bool saveState(BareNetworkString* buffer) OVERRIDE
+    {
+        m_value += 0.1f;
+        buffer->addUInt16((uint16_t)m_floats).addUInt8(0);
+        for (unsigned i = 0; i < m_floats; i++)
+            buffer->addFloat(m_value * (float)i);
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    virtual void saveTransform() OVERRIDE {}
+    virtual void computeError() OVERRIDE {}
+    virtual void undoEvent(BareNetworkString *buffer) OVERRIDE {}
+    virtual void rewindToEvent(BareNetworkString *buffer) OVERRIDE {}
+    virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE
+                                                        { buffer->skip(count); }
+    virtual void undoState(BareNetworkString *buffer) OVERRIDE {}
+};   // class BenchmarkRewinder
+
+}   // anonymous namespace
+
+// ----------------------------------------------------------------------------
+/** Measures the time to save a game state with 16 karts and 200 flyables,
+ *  compared with allocating a buffer for each rewinder and inserting the
+ *  rewinder list at the front afterwards as it was done before.
+ */
+void RewindManager::benchmark()
+{
+    const unsigned KARTS = 16;
+    const unsigned FLYABLES = 200;
+    const int ITERATIONS = 5000;
+
+    RewindManager* rwm = new RewindManager();
+    std::vector<std::shared_ptr<Rewinder> > rewinders;
+    for (unsigned i = 0; i < KARTS + FLYABLES; i++)
     {
-        if (auto r = p.second.lock())
+        std::string uid = StringUtils::toString(i);
+        // Kart state is about 70 bytes, flyables about 30 bytes
+        rewinders.push_back(std::make_shared<BenchmarkRewinder>(uid,
+            i < KARTS ? 17 : 7));
+        RewinderEntry re;
+        re.m_rewinder = rewinders.back();
+        re.m_uid = uid;
+        re.m_added_ticks = 0;
+        re.m_expired_ticks = -1;
+        rwm->m_rewinder_ids[uid] = (uint16_t)rwm->m_all_rewinder.size();
+        rwm->m_all_rewinder.push_back(re);
+    }
+    const int ticks = rwm->m_recent_rewinder_ticks;
+
+    NetworkString state(PROTOCOL_CONTROLLER_EVENTS);
+    double start = StkTime::getRealTime();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        state.clear();
+        state.addUInt8(0).addUInt32(i).addUInt16(0);
+        uint16_t count = rwm->saveRewinderStates(&state, ticks);
+        state.setUInt16(6, count);
+    }
+    double arena_time = StkTime::getRealTime() - start;
+    const unsigned state_size = state.getTotalSize();
+
+    start = StkTime::getRealTime();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        state.clear();
+        state.addUInt8(0).addUInt32(i);
+        std::vector<uint16_t> rewinder_using;
+        for (unsigned j = 0; j < rwm->m_all_rewinder.size(); j++)
         {
-            auto snb = std::dynamic_pointer_cast<SmoothNetworkBody>(r);
-            if (snb)
-                snb->reset();
+            BareNetworkString* buffer = new BareNetworkString();
+            rewinders[j]->saveState(buffer);
+            rewinder_using.push_back((uint16_t)j);
+            state.addUInt16(buffer->size());
+            state += *buffer;
+            delete buffer;
         }
+        BareNetworkString ids;
+        ids.addUInt16((uint16_t)rewinder_using.size());
+        for (uint16_t id : rewinder_using)
+            ids.addUInt16(id);
+        auto& buffer = state.getBuffer();
+        buffer.insert(buffer.begin() + 6, ids.getBuffer().begin(),
+            ids.getBuffer().end());
     }
-}   // resetSmoothNetworkBody
+    double allocate_time = StkTime::getRealTime() - start;
+    delete rwm;
+
+    Log::info("RewindManager", "saveState with %d karts and %d flyables "
+        "(%d bytes): %f ms with reused buffer, %f ms with buffer per "
+        "rewinder.", KARTS, FLYABLES, state_size,
+        arena_time * 1000.0 / ITERATIONS,
+        allocate_time * 1000.0 / ITERATIONS);
+}   // benchmark
@@ -32,6 +32,7 @@
 #include <string>
 #include <vector>
 
+class BareNetworkString;
 class Rewinder;
 class RewindInfo;
 class RewindInfoEventFunction;
@@ -80,6 +81,11 @@ class EventRewinder;
  *        - `rewindToEvent()` if the RewindInfo is an event
  *     3. Do one step of world simulation, using the updated (confirmed)
  *        states and newly set events (e.g. kart input).
+ *  If partial rewinds are enabled in a client, rewinders with a position
+ *  whose confirmed state is the same as the locally predicted state, and
+ *  which are far enough from all rewinders which need to be rewound, are
+ *  frozen: they keep their current state and are not updated while
+ *  replaying (see findFrozenRewinders()).
  */
 
 class RewindManager
@@ -92,10 +98,91 @@ private:
      *  rewind data in case of local races only. */
     static bool           m_enable_rewind_manager;
 
-    std::map<int, std::vector<std::function<void()> > > m_local_state;
+    /** If not empty, statistics are written to this file at the end of a
+     *  race. */
+    static std::string    m_statistics_file;
 
-    /** A list of all objects that can be rewound. */
-    std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
+    /** Client only: the functions to restore the local state of each
+     *  rewinder at each state ticks. */
+    std::map<int, std::vector<std::pair<std::weak_ptr<Rewinder>,
+        std::function<void()> > > > m_local_state;
+
+    /** Client only: the locally predicted state of rewinders with position
+     *  at each state ticks, used for rewinders left out by the server in a
+     *  state. Each record is rewinder id, data size and data. */
+    std::map<int, std::vector<uint8_t> > m_predicted_state;
+
+    /** Client only: true if the server can leave out rewinders in states
+     *  or partial rewinds are enabled, so predicted states need to be
+     *  saved. */
+    bool m_save_predicted_state;
+
+    /** Client only: true if only the rewinders whose state differs from the
+     *  predicted state (and rewinders close to them) are rewound. */
+    bool m_partial_rewind;
+
+    /** Number of rewinds in which all rewinders were rewound, and in which
+     *  some rewinders kept their current state. */
+    unsigned m_full_rewinds;
+    unsigned m_partial_rewinds;
+
+    /** Number of rewinds for each number of rewound ticks. */
+    std::map<int, unsigned> m_rewind_depths;
+
+    /** Total number of ticks simulated again in all rewinds. */
+    uint64_t m_rewound_ticks;
+
+    /** Total and maximum time spent in rewindTo (in seconds). */
+    double m_rewind_time;
+    double m_max_rewind_time;
+
+    /** Number and total size of states saved (server) or received
+     *  (client), the client receives them in the network thread. */
+    std::atomic<unsigned> m_state_count;
+    std::atomic<uint64_t> m_state_bytes;
+
+    /** Server only: the largest state saved. */
+    unsigned int m_max_state_size;
+
+    /** Real time when the statistics were reset. */
+    double m_statistics_start_time;
+
+    /** Information of each rewinder id, with the rewinder id as index. */
+    struct RewinderEntry
+    {
+        /** The rewinder, can be expired if it's not (yet) created locally. */
+        std::weak_ptr<Rewinder> m_rewinder;
+        /** The unique identity of the rewinder, empty if unused in client. */
+        std::string m_uid;
+        /** Server only: world ticks when the rewinder id was assigned. */
+        int m_added_ticks;
+        /** Server only: world ticks when the rewinder was found destroyed,
+         *  or -1 if it is still alive. */
+        int m_expired_ticks;
+    };
+
+    /** A list of all objects that can be rewound, indexed by rewinder id. */
+    std::vector<RewinderEntry> m_all_rewinder;
+
+    /** Maps the unique identity of a rewinder to its rewinder id. It is
+     *  sorted by unique identity, which is the order of restoring states. */
+    std::map<std::string, uint16_t> m_rewinder_ids;
+
+    /** Server only: rewinder ids of destroyed rewinders which can be used
+     *  again for new rewinders. */
+    std::vector<uint16_t> m_free_rewinder_ids;
+
+    /** Client only: rewinders created locally, for which the rewinder id
+     *  is not received from server yet. */
+    std::map<std::string, std::weak_ptr<Rewinder> > m_unbound_rewinder;
+
+    /** Server only: rewinder ids which are not yet sent to clients. */
+    std::vector<uint16_t> m_new_rewinder_ids;
+
+    /** Client only: rewinder ids received from server in network thread,
+     *  which will be bound in main thread. */
+    Synchronised<std::vector<std::pair<uint16_t, std::string> > >
+        m_pending_rewinder_ids;
 
     /** The queue that stores all rewind infos. */
     RewindQueue m_rewind_queue;
@@ -106,9 +193,21 @@ private:
     /** Indicates if currently a rewind is happening. */
     bool m_is_rewinding;
 
+    /** Indicates if the current rewind is a partial rewind, i.e. some
+     *  rewinders are frozen. */
+    bool m_is_partial_rewinding;
+
     /** How much time between consecutive state saves. */
     int m_state_frequency;
 
+    /** For how many ticks after adding a rewinder its unique identity is
+     *  sent with its state. */
+    int m_recent_rewinder_ticks;
+
+    /** Server only: for how many ticks the rewinder id of a destroyed
+     *  rewinder is kept before it can be used again. */
+    int m_free_rewinder_ticks;
+
     /** This stores the original World time in ticks during a rewind. It is
      *  used to detect if a client's local time need adjustment to reduce
      *  rewinds. */
@@ -121,18 +220,56 @@ private:
     // ------------------------------------------------------------------------
     void clearExpiredRewinder()
     {
-        for (auto it = m_all_rewinder.begin(); it != m_all_rewinder.end();)
+        for (auto it = m_unbound_rewinder.begin();
+             it != m_unbound_rewinder.end();)
         {
             if (it->second.expired())
             {
-                it = m_all_rewinder.erase(it);
+                it = m_unbound_rewinder.erase(it);
                 continue;
             }
             it++;
         }
     }
     // ------------------------------------------------------------------------
+    /** Returns all rewinders currently alive (bound or not), sorted by
+     *  unique identity. */
+    std::vector<std::shared_ptr<Rewinder> > getAllRewinders() const
+    {
+        std::vector<std::shared_ptr<Rewinder> > ret;
+        auto bound = m_rewinder_ids.begin();
+        auto unbound = m_unbound_rewinder.begin();
+        while (bound != m_rewinder_ids.end() ||
+               unbound != m_unbound_rewinder.end())
+        {
+            std::shared_ptr<Rewinder> r;
+            if (unbound == m_unbound_rewinder.end() ||
+                (bound != m_rewinder_ids.end() &&
+                bound->first < unbound->first))
+                r = m_all_rewinder[(bound++)->second].m_rewinder.lock();
+            else
+                r = (unbound++)->second.lock();
+            if (r)
+                ret.push_back(r);
+        }
+        return ret;
+    }
+    // ------------------------------------------------------------------------
     void mergeRewindInfoEventFunction();
+    // ------------------------------------------------------------------------
+    void mergeRewinderIDs();
+    // ------------------------------------------------------------------------
+    void freeExpiredRewinderIDs(int ticks);
+    // ------------------------------------------------------------------------
+    uint16_t saveRewinderStates(BareNetworkString* buffer, int ticks);
+    // ------------------------------------------------------------------------
+    void savePredictedState(int ticks);
+    // ------------------------------------------------------------------------
+    bool findFrozenRewinders(int rewind_ticks, int now_ticks,
+                             std::vector<std::shared_ptr<Rewinder> >* frozen);
+    // ------------------------------------------------------------------------
+    static bool findPredictedState(std::vector<uint8_t>& state, uint16_t id,
+                                   unsigned* offset, uint16_t* size);
 
 public:
     // First static functions to manage rewinding.
@@ -146,6 +283,14 @@ public:
     /** Returns if rewinding is enabled or not. */
     static bool isEnabled() { return m_enable_rewind_manager; }
     // ------------------------------------------------------------------------
+    /** Sets the file to write statistics to at the end of a race. */
+    static void setStatisticsFile(const std::string& file)
+                                                 { m_statistics_file = file; }
+    // ------------------------------------------------------------------------
+    static const std::string& getStatisticsFile() { return m_statistics_file; }
+    // ------------------------------------------------------------------------
+    static void benchmark();
+    // ------------------------------------------------------------------------
     /** Returns the singleton. This function will not automatically create
      *  the singleton. */
     static RewindManager *get()
@@ -166,22 +311,76 @@ public:
                          BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
     void saveState();
+    void writeStatistics() const;
     // ------------------------------------------------------------------------
-    std::shared_ptr<Rewinder> getRewinder(const std::string& name)
+    /** Returns the rewinder with the given rewinder id, or nullptr if it
+     *  doesn't exist locally. */
+    std::shared_ptr<Rewinder> getRewinder(uint16_t id) const
     {
-        auto it = m_all_rewinder.find(name);
-        if (it != m_all_rewinder.end())
-        {
-            if (auto r = it->second.lock())
-                return r;
-        }
+        if (id < m_all_rewinder.size())
+            return m_all_rewinder[id].m_rewinder.lock();
         return nullptr;
     }
     // ------------------------------------------------------------------------
+    /** Returns the unique identity of the rewinder id, or an empty string if
+     *  it's unknown. */
+    const std::string& getRewinderUID(uint16_t id) const
+    {
+        static const std::string empty;
+        if (id < m_all_rewinder.size())
+            return m_all_rewinder[id].m_uid;
+        return empty;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns true if the unique identity of rewinder id needs to be sent
+     *  together with its state, because clients may not have received
+     *  the rewinder id yet. */
+    bool isRecentRewinderID(uint16_t id, int ticks) const
+    {
+        return id < m_all_rewinder.size() &&
+            ticks - m_all_rewinder[id].m_added_ticks < m_recent_rewinder_ticks;
+    }
+    // ------------------------------------------------------------------------
     bool addRewinder(std::shared_ptr<Rewinder> rewinder);
     // ------------------------------------------------------------------------
+    void bindRewinderID(uint16_t id, const std::string& uid);
+    // ------------------------------------------------------------------------
+    void restorePredictedState(int ticks, uint16_t id);
+    // ------------------------------------------------------------------------
+    /** Called by the network thread when rewinder ids are received from
+     *  server. */
+    void addNetworkRewinderIDs(
+                       std::vector<std::pair<uint16_t, std::string> >& ids)
+    {
+        m_pending_rewinder_ids.lock();
+        auto& pending = m_pending_rewinder_ids.getData();
+        pending.insert(pending.end(), ids.begin(), ids.end());
+        m_pending_rewinder_ids.unlock();
+    }
+    // ------------------------------------------------------------------------
+    void encodeRewinderIDs(BareNetworkString* ns,
+                           const std::vector<uint16_t>& ids) const;
+    // ------------------------------------------------------------------------
+    void encodeAllRewinderIDs(BareNetworkString* ns) const;
+    // ------------------------------------------------------------------------
+    void encodeRewinderID(BareNetworkString* ns, uint16_t id, int ticks) const;
+    // ------------------------------------------------------------------------
+    static uint16_t decodeRewinderID(const BareNetworkString* ns,
+                                     std::string* uid);
+    // ------------------------------------------------------------------------
     /** Returns true if currently a rewind is happening. */
     bool isRewinding() const { return m_is_rewinding; }
+    // ------------------------------------------------------------------------
+    /** Returns true if currently a rewind is happening in which frozen
+     *  rewinders must not be updated. */
+    bool isPartialRewinding() const { return m_is_partial_rewinding; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of rewinds in which all rewinders were rewound. */
+    unsigned getFullRewinds() const { return m_full_rewinds; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of rewinds in which some rewinders kept their
+     *  current state. */
+    unsigned getPartialRewinds() const { return m_partial_rewinds; }
 
     // ------------------------------------------------------------------------
     int getNotRewoundWorldTicks() const
@@ -26,25 +26,30 @@
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
 
-/** The RewindQueue stores one TimeStepInfo for each time step done.
- *  The TimeStepInfo stores all states and events to be used at the
- *  given timestep. 
+/** Initial number of time steps in the ring buffer, it is increased if
+ *  rewind infos over a longer time need to be stored. */
+static const unsigned INITIAL_TIME_STEPS = 512;
+
+/** The RewindQueue stores all states and events in a ring buffer of
+ *  TimeStep, indexed by the time step (ticks) they are used at.
  *  All network events (i.e. new states or client events) are stored in a
  *  separate list m_network_events. At the very start of a new time step
- *  a new TimeStepInfo object is added. Then all network events that are
- *  supposed to happen between t and t+dt are added to this newly added
- *  TimeStep (see mergeNetworkData), and are then being executed.
- *  In case of a rewind the RewindQueue finds the last TimeStepInfo with
+ *  all network events that are supposed to happen between t and t+dt are
+ *  added to the TimeStep of their time (see mergeNetworkData), and are then
+ *  being executed.
+ *  In case of a rewind the RewindQueue finds the last TimeStep with
  *  a confirmed server state (undoing the events, see undoUntil). Then
- *  the state is restored from the TimeStepInfo object (see replayAllStates)
- *  then the rewind manager re-executes the time steps (using the events
- *  stored at each timestep).
+ *  the state is restored from the TimeStep, and the rewind manager
+ *  re-executes the time steps (using the events stored at each timestep).
  */
 RewindQueue::RewindQueue()
 {
+    m_num_rewind_info = 0;
     reset();
 }   // RewindQueue
 
@@ -74,43 +79,108 @@ void RewindQueue::reset()
     m_network_events.getData().clear();
     m_network_events.unlock();
 
-    AllRewindInfo::const_iterator i;
-    for (i = m_all_rewind_info.begin(); i != m_all_rewind_info.end(); ++i)
-        delete *i;
+    if (m_time_steps.empty())
+        m_time_steps.resize(INITIAL_TIME_STEPS);
+    for (int ticks = m_first_ticks;
+         m_num_rewind_info > 0 && ticks <= m_last_ticks; ticks++)
+    {
+        std::vector<RewindInfo*>& all_ri = getTimeStep(ticks).m_rewind_info;
+        for (RewindInfo* ri : all_ri)
+            delete ri;
+        all_ri.clear();
+    }
 
-    m_all_rewind_info.clear();
-    m_current = m_all_rewind_info.end();
+    m_num_rewind_info = 0;
+    m_first_ticks = m_last_ticks = 0;
+    m_current_ticks = 1;
+    m_current_index = 0;
     m_latest_confirmed_state_time = -1;
 }   // reset
 
 // ----------------------------------------------------------------------------
-/** Inserts a RewindInfo object in the list of all events at the correct time.
- *  If there are several RewindInfo at the exact same time, state RewindInfo
- *  will be insert at the front, and event info at the end of the RewindInfo
- *  with the same time.
+/** Changes the number of time steps in the ring buffer, moving the existing
+ *  rewind infos to the time steps of the new size.
+ *  \param size New number of time steps, must be a power of 2 and large
+ *         enough to store all time steps from m_first_ticks to m_last_ticks.
+ */
+void RewindQueue::setTimeStepsSize(unsigned size)
+{
+    assert((size & (size - 1)) == 0);
+    std::vector<TimeStep> time_steps(size);
+    for (int ticks = m_first_ticks;
+         m_num_rewind_info > 0 && ticks <= m_last_ticks; ticks++)
+    {
+        std::swap(time_steps[(unsigned)ticks & (size - 1)].m_rewind_info,
+            getTimeStep(ticks).m_rewind_info);
+    }
+    std::swap(m_time_steps, time_steps);
+}   // setTimeStepsSize
+
+// ----------------------------------------------------------------------------
+/** Sets the current rewind info to the first one at or after the given
+ *  time, or after the last rewind info if there is none.
+ *  \param ticks Time to start searching from.
+ */
+void RewindQueue::findNextCurrent(int ticks)
+{
+    m_current_ticks = ticks;
+    m_current_index = 0;
+    while (m_current_ticks <= m_last_ticks &&
+        getTimeStep(m_current_ticks).m_rewind_info.empty())
+        m_current_ticks++;
+}   // findNextCurrent
+
+// ----------------------------------------------------------------------------
+/** Inserts a RewindInfo object in the time step of its time. If there are
+ *  several RewindInfo at the exact same time, state RewindInfo will be
+ *  insert at the front, and event info at the end of the RewindInfo with
+ *  the same time.
+ *  If there is no more RewindInfo to be handled, the current RewindInfo is
+ *  set to the new one.
  *  \param ri The RewindInfo object to insert.
- *  \param update_current If set, the current pointer will be updated if
- *         necessary to point to the new event
  */
 void RewindQueue::insertRewindInfo(RewindInfo *ri)
 {
-    AllRewindInfo::iterator i = m_all_rewind_info.end();
+    const int ticks = ri->getTicks();
+    const bool at_end = !hasMoreRewindInfo();
+    if (m_num_rewind_info == 0)
+    {
+        m_first_ticks = m_last_ticks = ticks;
+    }
+    else
+    {
+        const int first_ticks = std::min(m_first_ticks, ticks);
+        const int last_ticks = std::max(m_last_ticks, ticks);
+        unsigned size = (unsigned)m_time_steps.size();
+        while ((unsigned)(last_ticks - first_ticks) >= size)
+            size *= 2;
+        if (size != m_time_steps.size())
+            setTimeStepsSize(size);
+        m_first_ticks = first_ticks;
+        m_last_ticks = last_ticks;
+    }
 
-    while (i != m_all_rewind_info.begin())
+    std::vector<RewindInfo*>& all_ri = getTimeStep(ticks).m_rewind_info;
+    unsigned index = 0;
+    if (ri->isEvent())
     {
-        AllRewindInfo::iterator i_prev = i;
-        i_prev--;
-        // Now test if 'ri' needs to be inserted after the
-        // previous element, i.e. before the current element:
-        if ((*i_prev)->getTicks() < ri->getTicks()) break;
-        if ((*i_prev)->getTicks() == ri->getTicks() &&
-            ri->isEvent()                              ) break;
-        i = i_prev;
+        index = (unsigned)all_ri.size();
+        all_ri.push_back(ri);
     }
-    if(m_current == m_all_rewind_info.end())
-        m_current = m_all_rewind_info.insert(i, ri);
     else
-        m_all_rewind_info.insert(i, ri);  
+        all_ri.insert(all_ri.begin(), ri);
+    m_num_rewind_info++;
+
+    if (at_end)
+    {
+        m_current_ticks = ticks;
+        m_current_index = index;
+    }
+    else if (m_current_ticks == ticks && index <= m_current_index)
+    {
+        // Keep the current pointing to the same rewind info
+        m_current_index++;
+    }
 }   // insertRewindInfo
 
 // ----------------------------------------------------------------------------
@@ -125,6 +195,8 @@ void RewindQueue::addLocalEvent(EventRewinder *event_rewinder,
 {
     RewindInfo *ri = new RewindInfoEvent(ticks, event_rewinder,
                                          buffer, confirmed);
+    // Local events are already applied when they are added
+    ri->setReplayed();
     insertRewindInfo(ri);
 }   // addLocalEvent
 
@@ -322,40 +394,36 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
 }   // mergeNetworkData
 
 // ----------------------------------------------------------------------------
-/** Deletes all states and event before the given time.
+/** Deletes all states and event before the given time. If the current
+ *  rewind info is deleted, the current will be the first one left.
  *  \param ticks Time (in ticks).
  */
 void RewindQueue::cleanupOldRewindInfo(int ticks)
 {
-    auto i = m_all_rewind_info.begin();
+    if (m_num_rewind_info == 0)
+        return;
 
-    while (!m_all_rewind_info.empty() &&
-        (*i)->getTicks() < ticks)
+    const bool current_removed = hasMoreRewindInfo() &&
+        m_current_ticks < ticks;
+    int t = m_first_ticks;
+    for (; t <= m_last_ticks && t < ticks; t++)
     {
-        if (m_current == i) next();
-        delete *i;
-        i = m_all_rewind_info.erase(i);
+        std::vector<RewindInfo*>& all_ri = getTimeStep(t).m_rewind_info;
+        for (RewindInfo* ri : all_ri)
+            delete ri;
+        m_num_rewind_info -= (unsigned)all_ri.size();
+        all_ri.clear();
     }
+    if (m_num_rewind_info == 0)
+        return;
 
-    if (m_all_rewind_info.empty())
-        m_current = m_all_rewind_info.end();
-
+    while (getTimeStep(t).m_rewind_info.empty())
+        t++;
+    m_first_ticks = t;
+    if (current_removed)
+        findNextCurrent(m_first_ticks);
 }   // cleanupOldRewindInfo
 
-// ----------------------------------------------------------------------------
-bool RewindQueue::isEmpty() const
-{
-    return m_current == m_all_rewind_info.end();
-}   // isEmpty
-
-// ----------------------------------------------------------------------------
-/** Returns true if there is at least one more RewindInfo available.
- */
-bool RewindQueue::hasMoreRewindInfo() const
-{
-    return m_current != m_all_rewind_info.end();
-}   // hasMoreRewindInfo
-
 // ----------------------------------------------------------------------------
 /** Rewinds the rewind queue and undos all events/states stored. It stops
  *  when the first confirmed state is reached that was recorded before the
@@ -367,27 +435,29 @@ int RewindQueue::undoUntil(int undo_ticks)
 {
     // A rewind is done after a state in the past is inserted. This function
     // makes sure that m_current is not end()
-    //assert(m_current != m_all_rewind_info.end());
-    assert(!m_all_rewind_info.empty());
-    m_current = m_all_rewind_info.end();
-    m_current--;
-    while((*m_current)->getTicks() > undo_ticks ||
-        (*m_current)->isEvent() || !(*m_current)->isConfirmed())
+    assert(m_num_rewind_info > 0);
+    for (m_current_ticks = m_last_ticks; m_current_ticks >= m_first_ticks;
+         m_current_ticks--)
     {
-        // Undo all events and states from the current time
-        (*m_current)->undo();
-        if(m_current == m_all_rewind_info.begin())
+        std::vector<RewindInfo*>& all_ri =
+            getTimeStep(m_current_ticks).m_rewind_info;
+        for (m_current_index = (unsigned)all_ri.size(); m_current_index > 0;)
         {
-            // This shouldn't happen, but add some debug info just in case
-            Log::error("undoUntil",
-                       "At %d rewinding to %d current = %d = begin",
-                       World::getWorld()->getTicksSinceStart(), undo_ticks, 
-                       (*m_current)->getTicks());
+            RewindInfo* current = all_ri[--m_current_index];
+            if (current->getTicks() <= undo_ticks &&
+                !current->isEvent() && current->isConfirmed())
+                return m_current_ticks;
+            // Undo all events and states from the current time
+            current->undo();
         }
-        m_current--;
     }
 
-    return (*m_current)->getTicks();
+    // This shouldn't happen, but add some debug info just in case
+    Log::error("undoUntil", "At %d rewinding to %d current = %d = begin",
+               World::getWorld()->getTicksSinceStart(), undo_ticks,
+               m_first_ticks);
+    findNextCurrent(m_first_ticks);
+    return m_current_ticks;
 }   // undoUntil
 
 // ----------------------------------------------------------------------------
@@ -396,16 +466,36 @@ int RewindQueue::undoUntil(int undo_ticks)
  */
 void RewindQueue::replayAllEvents(int ticks)
 {
+    if (!hasMoreRewindInfo() || m_current_ticks != ticks)
+        return;
+
     // Replay all events that happened at the current time step
-    while ( hasMoreRewindInfo() && (*m_current)->getTicks() == ticks )
+    std::vector<RewindInfo*>& all_ri = getTimeStep(ticks).m_rewind_info;
+    for (; m_current_index < all_ri.size(); m_current_index++)
     {
-        if ((*m_current)->isEvent())
-            (*m_current)->replay();
-        m_current++;
-    }   // while current->getTIcks == ticks
+        if (all_ri[m_current_index]->isEvent())
+        {
+            all_ri[m_current_index]->replay();
+            all_ri[m_current_index]->setReplayed();
+        }
+    }   // for all rewind info at ticks
+    findNextCurrent(ticks + 1);
 
 }   // replayAllEvents
 
+// ----------------------------------------------------------------------------
+/** Returns all RewindInfo at the given ticks, with states before events.
+ *  \param ticks Time of the RewindInfo.
+ */
+const std::vector<RewindInfo*>& RewindQueue::getRewindInfo(int ticks) const
+{
+    static const std::vector<RewindInfo*> empty;
+    if (m_num_rewind_info == 0 || ticks < m_first_ticks ||
+        ticks > m_last_ticks)
+        return empty;
+    return getTimeStep(ticks).m_rewind_info;
+}   // getRewindInfo
+
 // ----------------------------------------------------------------------------
 /** Unit tests for RewindQueue. It tests:
  *  - Sorting order of RewindInfos at the same time (i.e. state before time
@@ -413,6 +503,7 @@ void RewindQueue::replayAllEvents(int ticks)
  *  - Sorting order of RewindInfos with different timestamps (and a mixture
  *    of types).
  *  - Special cases that triggered incorrect behaviour previously.
+ *  - Growing and reusing the ring buffer of time steps.
  */
 void RewindQueue::unitTesting()
 {
@@ -420,6 +511,21 @@ void RewindQueue::unitTesting()
     RewindManager::create();
     auto dummy_rewinder = std::make_shared<DummyRewinder>();
 
+    // Returns all RewindInfo of a queue in order
+    auto get_all_rewind_info = [](const RewindQueue& q)
+    {
+        std::vector<RewindInfo*> all;
+        for (int ticks = q.m_first_ticks;
+             q.m_num_rewind_info > 0 && ticks <= q.m_last_ticks; ticks++)
+        {
+            const std::vector<RewindInfo*>& ri =
+                q.getTimeStep(ticks).m_rewind_info;
+            all.insert(all.end(), ri.begin(), ri.end());
+        }
+        assert(all.size() == q.m_num_rewind_info);
+        return all;
+    };
+
     // First tests: add a state first, then an event, and make
     // sure the state stays first
     RewindQueue q0;
@@ -427,57 +533,51 @@ void RewindQueue::unitTesting()
     assert(!q0.hasMoreRewindInfo());
 
     q0.addLocalState(NULL, /*confirmed*/true, 0);
-    assert(q0.m_all_rewind_info.front()->isState());
-    assert(!q0.m_all_rewind_info.front()->isEvent());
+    assert(get_all_rewind_info(q0).front()->isState());
+    assert(!get_all_rewind_info(q0).front()->isEvent());
     assert(q0.hasMoreRewindInfo());
     assert(q0.undoUntil(0) == 0);
 
     q0.addNetworkEvent(dummy_rewinder.get(), NULL, 0);
     // Network events are not immediately merged
-    assert(q0.m_all_rewind_info.size() == 1);
+    assert(q0.m_num_rewind_info == 1);
 
     bool needs_rewind;
     int rewind_ticks;
     int world_ticks = 0;
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
     assert(q0.hasMoreRewindInfo());
-    assert(q0.m_all_rewind_info.size() == 2);
-    AllRewindInfo::iterator rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    std::vector<RewindInfo*> all_ri = get_all_rewind_info(q0);
+    assert(all_ri.size() == 2);
+    assert(all_ri[0]->isState());
+    assert(all_ri[1]->isEvent());
 
     // Another state must be sorted before the event:
     q0.addNetworkState(NULL, 0);
     assert(q0.hasMoreRewindInfo());
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
-    assert(q0.m_all_rewind_info.size() == 3);
-    rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    all_ri = get_all_rewind_info(q0);
+    assert(all_ri.size() == 3);
+    assert(all_ri[0]->isState());
+    assert(all_ri[1]->isState());
+    assert(all_ri[2]->isEvent());
 
     // Test time base comparisons: adding an event to the end
     q0.addLocalEvent(dummy_rewinder.get(), NULL, true, 4);
     // Then adding an earlier event
     q0.addLocalEvent(dummy_rewinder.get(), NULL, false, 1);
-    // rii points to the 3rd element, the ones added just now
-    // should be elements4 and 5:
-    rii++;
-    assert((*rii)->getTicks()==1);
-    rii++;
-    assert((*rii)->getTicks()==4);
+    // The ones added just now should be elements 4 and 5:
+    all_ri = get_all_rewind_info(q0);
+    assert(all_ri[3]->getTicks()==1);
+    assert(all_ri[4]->getTicks()==4);
 
     // Now test inserting an event first, then the state
     RewindQueue q1;
     q1.addLocalEvent(NULL, NULL, true, 5);
     q1.addLocalState(NULL, true, 5);
-    rii = q1.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    all_ri = get_all_rewind_info(q1);
+    assert(all_ri[0]->isState());
+    assert(all_ri[1]->isEvent());
 
     // Bugs seen before
     // ----------------
@@ -496,11 +596,11 @@ void RewindQueue::unitTesting()
     //    event, that m_current pooints to the first event, otherwise
     //    events with same time stamp will not be handled correctly.
     //    At this stage current points to the event at time 2 from above
-    AllRewindInfo::iterator current_old = b1.m_current;
+    RewindInfo* current_old = b1.getCurrent();
     b1.addLocalEvent(NULL, NULL, true, 2);
     // Make sure that current was not modified, i.e. the new event at time
     // 2 was added at the end of the list:
-    if (current_old != b1.m_current)
+    if (current_old != b1.getCurrent())
         Log::fatal("RewindQueue", "current_old != b1.m_current");
 
     // This should not trigger an exception, now current points to the
@@ -509,7 +609,7 @@ void RewindQueue::unitTesting()
     assert(ri->getTicks() == 2);
     assert(ri->isEvent());
     b1.next();
-    assert(b1.m_current == b1.m_all_rewind_info.end());
+    assert(!b1.hasMoreRewindInfo());
 
     // 3) Test that if cleanupOldRewindInfo is called, it will if necessary
     //    adjust m_current to point to the latest confirmed state.
@@ -518,7 +618,117 @@ void RewindQueue::unitTesting()
     b2.addNetworkState(NULL, 2);
     b2.addNetworkState(NULL, 3);
     b2.mergeNetworkData(4, &needs_rewind, &rewind_ticks);
-    assert((*b2.m_current)->getTicks() == 3);
+    assert(b2.getCurrent()->getTicks() == 3);
+
+    // Ring buffer of time steps
+    // -------------------------
+    // 1) Storing more time steps than the initial size increases the
+    //    buffer and keeps the order
+    RewindQueue r1;
+    const int many_ticks = INITIAL_TIME_STEPS * 2 + 10;
+    for (int ticks = 0; ticks < many_ticks; ticks++)
+    {
+        r1.addLocalEvent(dummy_rewinder.get(), new BareNetworkString(), true,
+            ticks);
+        if (ticks % 10 == 0)
+            r1.insertRewindInfo(new RewindInfoState(ticks, NULL, true));
+    }
+    assert(r1.m_time_steps.size() == INITIAL_TIME_STEPS * 4);
+    all_ri = get_all_rewind_info(r1);
+    assert(all_ri.size() == many_ticks + many_ticks / 10 + 1);
+    for (unsigned i = 1; i < all_ri.size(); i++)
+    {
+        assert(all_ri[i - 1]->getTicks() <= all_ri[i]->getTicks());
+        assert(all_ri[i - 1]->getTicks() < all_ri[i]->getTicks() ||
+            all_ri[i - 1]->isState() || all_ri[i]->isEvent());
+    }
+    const int last_state_ticks = (many_ticks - 1) / 10 * 10;
+    if (r1.undoUntil(last_state_ticks + 1) != last_state_ticks)
+        Log::fatal("RewindQueue", "Wrong state found in undoUntil");
+    assert(r1.getCurrent()->isState());
+
+    // 2) Time steps are reused if old ones are removed, so the buffer size
+    //    doesn't change
+    RewindQueue r2;
+    for (int ticks = 0; ticks < many_ticks; ticks++)
+    {
+        if (ticks % 10 == 0)
+            r2.addLocalState(NULL, true, ticks);
+        r2.addLocalEvent(NULL, NULL, true, ticks);
+    }
+    assert(r2.m_time_steps.size() == INITIAL_TIME_STEPS);
+    assert(r2.m_first_ticks == last_state_ticks);
+    assert(r2.m_num_rewind_info ==
+        (unsigned)(many_ticks - last_state_ticks + 1));
+
+    // 3) Empty time steps are skipped when undoing and replaying
+    RewindQueue r3;
+    r3.addLocalState(NULL, true, 10);
+    r3.addLocalEvent(dummy_rewinder.get(), new BareNetworkString(), true, 12);
+    r3.addLocalEvent(dummy_rewinder.get(), new BareNetworkString(), true, 30);
+    assert(r3.undoUntil(20) == 10);
+    assert(r3.getCurrent()->isState());
+    r3.next();
+    assert(r3.getCurrent()->getTicks() == 12);
+    r3.next();
+    assert(r3.getCurrent()->getTicks() == 30);
+    r3.next();
+    assert(!r3.hasMoreRewindInfo());
+
+    // 4) Memory of deleted RewindInfo is reused
+    RewindInfo* ri_1 = new RewindInfoEventFunction(0);
+    const void* ri_1_address = ri_1;
+    delete ri_1;
+    RewindInfo* ri_2 = new RewindInfoState(0, NULL, true);
+    if (ri_1_address != ri_2)
+        Log::fatal("RewindQueue", "RewindInfo memory is not reused");
+    delete ri_2;
+}   // unitTesting
 
+// ----------------------------------------------------------------------------
+/** Measures the time to add the events of 8 karts and rewind 60 ticks, as
+ *  it happens in a client.
+ */
+void RewindQueue::benchmark()
+{
+    const int KARTS = 8;
+    const int REWIND_TICKS = 60;
+    const int ITERATIONS = 2000;
+
+    DummyRewinder dummy_rewinder;
+    RewindQueue q;
+    double add_time = 0.0;
+    double rewind_time = 0.0;
+    int ticks = 0;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        double start = StkTime::getRealTime();
+        // This removes the rewind infos of the previous iteration
+        q.addLocalState(NULL, /*confirmed*/true, ticks);
+        for (int t = ticks; t < ticks + REWIND_TICKS; t++)
+        {
+            for (int k = 0; k < KARTS; k++)
+            {
+                BareNetworkString* buffer = new BareNetworkString(8);
+                buffer->addUInt8(k).addUInt8(0).addUInt16(0).addUInt16(0)
+                    .addUInt16(0);
+                q.addLocalEvent(&dummy_rewinder, buffer, true, t);
+            }
+        }
+        add_time += StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        int rewind_ticks = q.undoUntil(ticks + REWIND_TICKS - 1);
+        assert(rewind_ticks == ticks);
+        q.next();
+        for (int t = rewind_ticks; t < ticks + REWIND_TICKS; t++)
+            q.replayAllEvents(t);
+        rewind_time += StkTime::getRealTime() - start;
+        ticks += REWIND_TICKS;
+    }
 
-}   // unitTesting
+    Log::info("RewindQueue", "Rewinding %d ticks with %d karts: %f ms, "
+        "adding %d events: %f ms.", REWIND_TICKS, KARTS,
+        rewind_time * 1000.0 / ITERATIONS, REWIND_TICKS * KARTS,
+        add_time * 1000.0 / ITERATIONS);
+}   // benchmark
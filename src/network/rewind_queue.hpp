@@ -22,7 +22,6 @@
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
-#include <list>
 #include <vector>
 
 class BareNetworkString;
@@ -36,10 +35,26 @@ class TimeStepInfo;
 class RewindQueue
 {
 private:
+    /** All RewindInfo at the same time, states are stored before events. */
+    struct TimeStep
+    {
+        std::vector<RewindInfo*> m_rewind_info;
+    };   // struct TimeStep
+
+    /** Ring buffer of time steps indexed by ticks, the size is a power of 2
+     *  and is increased if more ticks need to be stored. Only the time steps
+     *  from m_first_ticks to m_last_ticks can be non-empty. The vector in
+     *  each time step keeps its capacity, so in general no memory is
+     *  allocated when adding a RewindInfo. */
+    std::vector<TimeStep> m_time_steps;
 
-    typedef std::list<RewindInfo*> AllRewindInfo;
+    /** Time of the first and last RewindInfo, only valid if
+     *  m_num_rewind_info is not 0. */
+    int m_first_ticks;
+    int m_last_ticks;
 
-    AllRewindInfo m_all_rewind_info;
+    /** Number of RewindInfo in all time steps. */
+    unsigned m_num_rewind_info;
 
     /** The list of all events received from the network. They are stored
      *  in a separate thread (so this data structure is thread-save), and
@@ -49,17 +64,33 @@ private:
     typedef std::vector<RewindInfo*> AllNetworkRewindInfo;
     Synchronised<AllNetworkRewindInfo> m_network_events;
 
-    /** Iterator to the curren time step info to be handled. */
-    AllRewindInfo::iterator m_current;
+    /** Time and index in the time step of the current RewindInfo to be
+     *  handled. If m_current_ticks is after m_last_ticks, there is no more
+     *  RewindInfo to be handled. */
+    int m_current_ticks;
+    unsigned m_current_index;
 
     /** Time at which the latest confirmed state is at. */
     int m_latest_confirmed_state_time;
 
-
     void cleanupOldRewindInfo(int ticks);
+    void setTimeStepsSize(unsigned size);
+    void findNextCurrent(int ticks);
+    // ------------------------------------------------------------------------
+    /** Returns the time step used for the given ticks. */
+    TimeStep& getTimeStep(int ticks)
+    {
+        return m_time_steps[(unsigned)ticks & (m_time_steps.size() - 1)];
+    }   // getTimeStep
+    // ------------------------------------------------------------------------
+    const TimeStep& getTimeStep(int ticks) const
+    {
+        return m_time_steps[(unsigned)ticks & (m_time_steps.size() - 1)];
+    }   // getTimeStep
 
 public:
         static void unitTesting();
+        static void benchmark();
 
          RewindQueue();
         ~RewindQueue();
@@ -79,10 +110,9 @@ public:
     void mergeNetworkData(int world_ticks,  bool *needs_rewind, 
                           int *rewind_ticks);
     void replayAllEvents(int ticks);
-    bool isEmpty() const;
-    bool hasMoreRewindInfo() const;
     int  undoUntil(int undo_ticks);
     void insertRewindInfo(RewindInfo *ri);
+    const std::vector<RewindInfo*>& getRewindInfo(int ticks) const;
 
     // ------------------------------------------------------------------------
     /** Returns the time of the latest confirmed state. */
@@ -91,13 +121,23 @@ public:
         return m_latest_confirmed_state_time;
     }
     // ------------------------------------------------------------------------
+    /** Returns true if there is at least one more RewindInfo available. */
+    bool hasMoreRewindInfo() const
+    {
+        return m_num_rewind_info > 0 && m_current_ticks <= m_last_ticks;
+    }   // hasMoreRewindInfo
+    // ------------------------------------------------------------------------
+    bool isEmpty() const { return !hasMoreRewindInfo(); }
+    // ------------------------------------------------------------------------
     /** Sets the current element to be the next one and returns the next
      *  RewindInfo element. */
     void next()
     {
-        assert(m_current != m_all_rewind_info.end());
-        m_current++;
-        return;
+        assert(hasMoreRewindInfo());
+        m_current_index++;
+        if (m_current_index >= getTimeStep(m_current_ticks)
+                                                       .m_rewind_info.size())
+            findNextCurrent(m_current_ticks + 1);
     }   // operator++
 
     // ------------------------------------------------------------------------
@@ -105,11 +145,11 @@ public:
      *  least one more RewindInfo (see hasMoreRewindInfo()). */
     RewindInfo* getCurrent()
     {
-        return (m_current != m_all_rewind_info.end() ) ? *m_current : NULL;
+        return hasMoreRewindInfo() ?
+            getTimeStep(m_current_ticks).m_rewind_info[m_current_index] : NULL;
     }   // getNext
 
 };   // RewindQueue
 
 
 #endif
-
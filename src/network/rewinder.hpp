@@ -20,12 +20,14 @@
 #define HEADER_REWINDER_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <memory>
 #include <vector>
 
 class BareNetworkString;
+class Vec3;
 
 enum RewinderName : char
 {
@@ -48,16 +50,37 @@ private:
     /** Currently it has 2 usages:
      *  1. Create the required flyable if the firing event missed using this
      *     uid. (see RewindInfoState::restore)
-     *  2. Determine the order of restoring state for each rewinder, this is
-     *     used as a key in std::string, Rewinder map, which is less than.
-     *     So uid of "0x01" (item manager) is restored before "0x02, x" (which
-     *     kart id x) and 0x03 / 0x04 (the red / blue flag) is restored after
-     *     karts, because the restoreState in CTFFlag read kart transformation.
+     *  2. Sent (once) together with the rewinder id by server, so clients
+     *     can find the rewinder of each rewinder id in game states.
+     *  It also determines the order of restoring state for each rewinder,
+     *  game states are sorted by this uid (less than comparison of string),
+     *  which starts with the RewinderName. So uid of "0x01" (item manager)
+     *  is restored before "0x02, x" (which kart id x) and 0x03 / 0x04 (the
+     *  red / blue flag) is restored after karts, because the restoreState in
+     *  CTFFlag read kart transformation.
     */
     std::string m_unique_identity;
 
+    /** Compact id assigned by the server when this rewinder is added to the
+     *  rewind manager, which is used instead of the unique identity in game
+     *  states. The clients bind it once the id of the unique identity is
+     *  received from server. */
+    uint16_t m_rewinder_id;
+
+    /** True if this object is not rewound in a partial rewind, so it keeps
+     *  its current state and is not updated while replaying. */
+    bool m_frozen;
+
 public:
-    Rewinder(const std::string& ui = "")             { m_unique_identity = ui; }
+    /** Id used for a rewinder which is not (yet) known by the server. */
+    static const uint16_t INVALID_REWINDER_ID = 0x7fff;
+    // -------------------------------------------------------------------------
+    Rewinder(const std::string& ui = "")
+    {
+        m_unique_identity = ui;
+        m_rewinder_id = INVALID_REWINDER_ID;
+        m_frozen = false;
+    }
 
     virtual ~Rewinder() {}
 
@@ -70,12 +93,13 @@ public:
      *  caused by the rewind (which is then visually smoothed over time). */
     virtual void computeError() = 0;
 
-    /** Provides a copy of the state of the object in one memory buffer.
-     *  The memory is managed by the RewindManager.
-     *  \param[out] ru The unique identity of rewinder writing to.
-     *  \return The address of the memory buffer with the state.
+    /** Appends the state of the object to the buffer, which is reused for
+     *  all states so no memory needs to be allocated.
+     *  \param buffer The buffer to write the state to.
+     *  \return False if no state needs to be saved for this object, anything
+     *          written to buffer is discarded then.
      */
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru) = 0;
+    virtual bool saveState(BareNetworkString* buffer) = 0;
 
     /** Called when an event needs to be undone. This is called while going
      *  backwards for rewinding - all stored events will get an 'undo' call.
@@ -106,12 +130,29 @@ public:
     virtual std::function<void()> getLocalStateRestoreFunction()
                                                              { return nullptr; }
     // -------------------------------------------------------------------------
+    /** Returns the position used by the server to decide if the state of
+     *  this object is relevant to each client (see InterestManager). Objects
+     *  without position are always sent. In client it also means that the
+     *  predicted state is saved for this object. */
+    virtual bool getInterestPosition(Vec3* xyz) const        { return false; }
+    // -------------------------------------------------------------------------
+    /** Called by the rewind manager before and after a partial rewind in
+     *  which this object is not rewound. Objects with a physical body
+     *  remove it from the simulation while being frozen. */
+    virtual void setFrozen(bool frozen)                   { m_frozen = frozen; }
+    // -------------------------------------------------------------------------
+    bool isFrozen() const                                   { return m_frozen; }
+    // -------------------------------------------------------------------------
     const std::string& getUniqueIdentity() const
     {
         assert(!m_unique_identity.empty() && m_unique_identity.size() < 255);
         return m_unique_identity;
     }
     // -------------------------------------------------------------------------
+    void setRewinderID(uint16_t id)                       { m_rewinder_id = id; }
+    // -------------------------------------------------------------------------
+    uint16_t getRewinderID() const                       { return m_rewinder_id; }
+    // -------------------------------------------------------------------------
     bool rewinderAdd();
     // -------------------------------------------------------------------------
     template<typename T> std::shared_ptr<T> getShared()
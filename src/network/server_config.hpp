@@ -341,6 +341,47 @@ namespace ServerConfig
         "more rewind, which clients with slow device may have problem playing "
         "this server, use the default value is recommended."));
 
+    SERVER_CFG_PREFIX BoolServerConfigParam m_delta_state
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "delta-state",
+        "If true, the server will send game states as difference to the "
+        "last state acknowledged by each client (if supported by the "
+        "client), which reduces upload bandwidth with many players."));
+
+    SERVER_CFG_PREFIX BoolServerConfigParam m_interest_state
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "interest-state",
+        "If true, the server will send the state of karts and items far away "
+        "from the karts of each client (if supported by the client) less "
+        "often, which reduces upload bandwidth in big arenas. Clients use "
+        "their own prediction for objects not sent. Delta state is not used "
+        "for clients which support this."));
+
+    SERVER_CFG_PREFIX FloatServerConfigParam m_interest_near_distance
+        SERVER_CFG_DEFAULT(FloatServerConfigParam(50.0f,
+        "interest-near-distance",
+        "Distance (along the track or arena graph) within which the state "
+        "of objects is sent in every state if interest-state is enabled."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_interest_far_interval
+        SERVER_CFG_DEFAULT(IntServerConfigParam(3,
+        "interest-far-interval",
+        "Number of states after which the state of objects further than "
+        "interest-near-distance is sent again if interest-state is "
+        "enabled."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_interest_state_budget
+        SERVER_CFG_DEFAULT(IntServerConfigParam(0,
+        "interest-state-budget",
+        "Maximum size in bytes of each state sent to a client if "
+        "interest-state is enabled, the nearest objects are sent first. The "
+        "karts of the client and objects without position are always sent. "
+        "0 to disable."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_encryption_threads
+        SERVER_CFG_DEFAULT(IntServerConfigParam(-1, "encryption-threads",
+        "Number of additional threads used to encrypt the same message for "
+        "many clients, -1 to use one less than the number of cores, 0 to "
+        "encrypt in the sending thread only."));
+
     SERVER_CFG_PREFIX BoolServerConfigParam m_sql_management
         SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
         "sql-management",
@@ -430,7 +471,7 @@ namespace ServerConfig
 
     // ========================================================================
     /** Server version, will be advanced if there are protocol changes. */
-    static const uint32_t m_server_version = 6;
+    static const uint32_t m_server_version = 7;
     // ========================================================================
     /** Server database version, will be advanced if there are protocol
      *  changes. */
@@ -22,6 +22,7 @@
 #ifndef STK_HOST_HPP
 #define STK_HOST_HPP
 
+#include "utils/mpsc_queue.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/time.hpp"
 
@@ -57,6 +58,7 @@ class ServerLobby;
 class SeparateProcess;
 class SocketAddress;
 class STKPeer;
+class ThreadPool;
 
 using namespace irr;
 
@@ -67,6 +69,11 @@ enum ENetCommandType : unsigned int
     ECT_RESET = 2
 };
 
+/** Unreliable messages up to this size are combined with other messages to
+ *  the same peer (see EVENT_CHANNEL_COALESCED), up to the packet size. */
+const uint32_t MAX_COALESCED_MESSAGE_SIZE = 400;
+const uint32_t MAX_COALESCED_PACKET_SIZE = 1200;
+
 class STKHost
 {
 public:
@@ -96,14 +103,15 @@ private:
     /** Make sure the removing or adding a peer is thread-safe. */
     mutable std::mutex m_peers_mutex;
 
-    /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
-     *  thread. */
-    std::list<std::tuple</*peer receive*/ENetPeer*,
+    typedef std::tuple</*peer receive*/ENetPeer*,
         /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
-        ENetCommandType> > m_enet_cmd;
+        ENetCommandType> ENetCommand;
 
-    /** Protect \ref m_enet_cmd from multiple threads usage. */
-    std::mutex m_enet_cmd_mutex;
+    /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
+     *  thread. Each ECT_SEND_PACKET command holds one reference of the
+     *  packet (ENetPacket::referenceCount), which has to be set before it is
+     *  added, so a packet can be shared by several peers. */
+    MPSCQueue<ENetCommand> m_enet_cmd;
 
     /** The list of peers connected to this instance. */
     std::map<ENetPeer*, std::shared_ptr<STKPeer> > m_peers;
@@ -164,6 +172,9 @@ private:
 
     std::unique_ptr<NetworkTimerSynchronizer> m_nts;
 
+    /** Server only: threads to encrypt a message for many peers at once. */
+    std::unique_ptr<ThreadPool> m_encryption_pool;
+
     // ------------------------------------------------------------------------
     STKHost(bool server);
     // ------------------------------------------------------------------------
@@ -195,6 +206,8 @@ public:
         return m_stk_host;
     }   // get
     // ------------------------------------------------------------------------
+    static void benchmark();
+    // ------------------------------------------------------------------------
     static void destroy()
     {
         assert(m_stk_host != NULL);
@@ -268,6 +281,9 @@ public:
     void sendPacketExcept(STKPeer* peer, NetworkString *data,
                           bool reliable = true);
     // ------------------------------------------------------------------------
+    void sendPacketToPeers(const std::vector<STKPeer*>& peers,
+                           NetworkString* data, bool reliable = true);
+    // ------------------------------------------------------------------------
     void setupClient(int peer_count, int channel_limit,
                      uint32_t max_incoming_bandwidth,
                      uint32_t max_outgoing_bandwidth);
@@ -287,8 +303,7 @@ public:
     void addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
                         ENetCommandType ect)
     {
-        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-        m_enet_cmd.emplace_back(peer, packet, i, ect);
+        m_enet_cmd.emplace(peer, packet, i, ect);
     }
     // ------------------------------------------------------------------------
     /** Returns the last error (or "" if no error has happened). */
@@ -64,6 +64,9 @@ STKPeer::STKPeer(ENetPeer *enet_peer, STKHost* host, uint32_t host_id)
     m_validated.store(false);
     m_average_ping.store(0);
     m_packet_loss.store(0);
+    m_sent_bytes.store(0);
+    m_received_bytes.store(0);
+    m_coalesce_packets.store(false);
     m_waiting_for_game.store(true);
     m_spectator.store(false);
     m_disconnected.store(false);
@@ -121,6 +124,20 @@ void STKPeer::reset()
     m_host->addEnetCommand(m_enet_peer, NULL, 0, ECT_RESET);
 }   // reset
 
+//-----------------------------------------------------------------------------
+/** Returns true if packets can be sent to this peer now.
+ */
+bool STKPeer::canSendPacket() const
+{
+    if (m_disconnected.load())
+        return false;
+    // Enet will reuse a disconnected peer so we check here to avoid sending
+    // to wrong peer
+    return m_enet_peer->state == ENET_PEER_STATE_CONNECTED &&
+        (m_enet_peer->address.host == m_address.host ||
+        m_enet_peer->address.port == m_address.port);
+}   // canSendPacket
+
 //-----------------------------------------------------------------------------
 /** Sends a packet to this host.
  *  \param data The data to send.
@@ -129,42 +146,63 @@ void STKPeer::reset()
  */
 void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
 {
-    if (m_disconnected.load())
-        return;
-    // Enet will reuse a disconnected peer so we check here to avoid sending
-    // to wrong peer
-    if (m_enet_peer->state != ENET_PEER_STATE_CONNECTED ||
-        (m_enet_peer->address.host != m_address.host &&
-        m_enet_peer->address.port != m_address.port))
+    if (!canSendPacket())
         return;
 
-    ENetPacket* packet = NULL;
-    if (m_crypto && encrypted)
-    {
-        packet = m_crypto->encryptSend(*data, reliable);
-    }
-    else
+    ENetPacket* packet = createPacket(data, reliable, encrypted);
+    if (packet)
     {
-        packet = enet_packet_create(data->getData(),
-            data->getTotalSize(), (reliable ?
-            ENET_PACKET_FLAG_RELIABLE :
-            (ENET_PACKET_FLAG_UNSEQUENCED |
-            ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
+        packet->referenceCount = 1;
+        queuePacket(packet, encrypted);
     }
+}   // sendPacket
 
-    if (packet)
+//-----------------------------------------------------------------------------
+/** Creates the packet with the data for this peer, which is encrypted if
+ *  this peer uses encryption. It can be called from any thread (see
+ *  STKHost::sendPacketToPeers).
+ *  \param data The data to send.
+ *  \param reliable If the data is sent reliable or not.
+ *  \param encrypted If the data is sent encrypted or not.
+ */
+ENetPacket* STKPeer::createPacket(NetworkString *data, bool reliable,
+                                  bool encrypted)
+{
+    if (m_crypto && encrypted)
+        return m_crypto->encryptSend(*data, reliable);
+    return enet_packet_create(data->getData(), data->getTotalSize(),
+        (reliable ? ENET_PACKET_FLAG_RELIABLE :
+        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
+}   // createPacket
+
+//-----------------------------------------------------------------------------
+/** Adds an already created packet to the send queue of the listening
+ *  thread. The reference of this peer must be included in the reference
+ *  count of the packet already, which allows sharing it with other peers
+ *  (see STKHost::sendPacketToPeers).
+ *  \param packet The packet to send.
+ *  \param encrypted If the packet is sent in the normal channel (which is
+ *         encrypted if supported) or in the unencrypted channel.
+ */
+void STKPeer::queuePacket(ENetPacket* packet, bool encrypted)
+{
+    m_sent_bytes.fetch_add(packet->dataLength);
+    if (Network::m_connection_debug)
     {
-        if (Network::m_connection_debug)
-        {
-            Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
-                packet->dataLength, getAddress().toString().c_str(),
-                StkTime::getRealTime());
-        }
-        m_host->addEnetCommand(m_enet_peer, packet,
-                encrypted ? EVENT_CHANNEL_NORMAL : EVENT_CHANNEL_UNENCRYPTED,
-                ECT_SEND_PACKET);
+        Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
+            packet->dataLength, getAddress().toString().c_str(),
+            StkTime::getRealTime());
     }
-}   // sendPacket
+    uint32_t channel = encrypted ? EVENT_CHANNEL_NORMAL :
+        EVENT_CHANNEL_UNENCRYPTED;
+    // The listening thread combines small unreliable messages to the same
+    // peer into one packet
+    if (encrypted && m_coalesce_packets.load() &&
+        (packet->flags & ENET_PACKET_FLAG_RELIABLE) == 0 &&
+        packet->dataLength <= MAX_COALESCED_MESSAGE_SIZE)
+        channel = EVENT_CHANNEL_COALESCED;
+    m_host->addEnetCommand(m_enet_peer, packet, channel, ECT_SEND_PACKET);
+}   // queuePacket
 
 //-----------------------------------------------------------------------------
 /** Returns if the peer is connected or not.
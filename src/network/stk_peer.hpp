@@ -113,6 +113,14 @@ protected:
 
     std::atomic<int> m_packet_loss;
 
+    /** Total size of packets sent to and received from this peer. */
+    std::atomic<uint64_t> m_sent_bytes;
+    std::atomic<uint64_t> m_received_bytes;
+
+    /** True if small unreliable messages to this peer can be combined in
+     *  one packet (see EVENT_CHANNEL_COALESCED). */
+    std::atomic_bool m_coalesce_packets;
+
     std::set<unsigned> m_available_kart_ids;
 
     std::string m_user_version;
@@ -132,6 +140,13 @@ public:
     void sendPacket(NetworkString *data, bool reliable = true,
                     bool encrypted = true);
     // ------------------------------------------------------------------------
+    bool canSendPacket() const;
+    // ------------------------------------------------------------------------
+    ENetPacket* createPacket(NetworkString *data, bool reliable,
+                             bool encrypted = true);
+    // ------------------------------------------------------------------------
+    void queuePacket(ENetPacket* packet, bool encrypted = true);
+    // ------------------------------------------------------------------------
     void disconnect();
     // ------------------------------------------------------------------------
     void kick();
@@ -270,6 +285,16 @@ public:
     // ------------------------------------------------------------------------
     int getPacketLoss() const                  { return m_packet_loss.load(); }
     // ------------------------------------------------------------------------
+    void addReceivedBytes(uint64_t b)        { m_received_bytes.fetch_add(b); }
+    // ------------------------------------------------------------------------
+    uint64_t getSentBytes() const               { return m_sent_bytes.load(); }
+    // ------------------------------------------------------------------------
+    uint64_t getReceivedBytes() const       { return m_received_bytes.load(); }
+    // ------------------------------------------------------------------------
+    void setCoalescePackets(bool val)        { m_coalesce_packets.store(val); }
+    // ------------------------------------------------------------------------
+    bool coalescePackets() const          { return m_coalesce_packets.load(); }
+    // ------------------------------------------------------------------------
     const std::array<int, AS_TOTAL>& getAddonsScores() const
                                                     { return m_addons_scores; }
     // ------------------------------------------------------------------------
@@ -44,6 +44,10 @@
 #include "tracks/track_object.hpp"
 #include "utils/profiler.hpp"
 
+#include <chrono>
+
+std::string Physics::m_broadphase_override;
+
 // ----------------------------------------------------------------------------
 /** Initialise physics.
  *  Create the bullet dynamics world.
@@ -57,14 +61,20 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 //-----------------------------------------------------------------------------
 /** The actual initialisation of the physics, which is called after the track
  *  model is loaded. This allows the physics to use the actual track dimension
- *  for the axis sweep.
+ *  for the broadphase.
  */
 void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
 {
     m_physics_loop_active = false;
-    m_axis_sweep          = new btAxisSweep3(world_min, world_max);
+    m_broadphase_name     = m_broadphase_override.empty()
+                          ? Track::getCurrentTrack()->getBroadphase()
+                          : m_broadphase_override;
+    m_broadphase          = createBroadphase(m_broadphase_name,
+                                             world_min, world_max);
+    m_update_time         = 0.0;
+    m_update_count        = 0;
     m_dynamics_world      = new STKDynamicsWorld(m_dispatcher,
-                                                 m_axis_sweep,
+                                                 m_broadphase,
                                                  this,
                                                  m_collision_conf);
     m_karts_to_delete.clear();
@@ -87,12 +97,44 @@ void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
                       | stk_config->m_solver_set_flags;
 }   // init
 
+//-----------------------------------------------------------------------------
+/** Creates the broadphase with the given name:
+ *  - axis-sweep: bullet's sweep and prune, with 16 bit integer coordinates
+ *    (the default).
+ *  - axis-sweep-32: the same with 32 bit coordinates, which is more precise
+ *    on big tracks and supports more objects.
+ *  - dbvt: two dynamic bounding volume trees, one for static and one for
+ *    moving objects. It does not depend on the size of the world, and is
+ *    usually faster if many objects are moving (e.g. physical track objects
+ *    and flyables).
+ *  Note that the broadphase affects the order in which collisions are
+ *  handled, so all clients in a networked game must use the same one.
+ *  \param name Name of the broadphase.
+ *  \param world_min, world_max The bounding box of the world (only used by
+ *         the sweep and prune broadphases).
+ */
+btBroadphaseInterface* Physics::createBroadphase(const std::string &name,
+                                                 const Vec3 &world_min,
+                                                 const Vec3 &world_max)
+{
+    if (name == "dbvt")
+        return new btDbvtBroadphase();
+    if (name == "axis-sweep-32")
+        return new bt32BitAxisSweep3(world_min, world_max);
+    if (name != "axis-sweep")
+    {
+        Log::warn("Physics", "Unknown broadphase '%s', using axis-sweep.",
+                  name.c_str());
+    }
+    return new btAxisSweep3(world_min, world_max);
+}   // createBroadphase
+
 //-----------------------------------------------------------------------------
 Physics::~Physics()
 {
     delete m_debug_drawer;
     delete m_dynamics_world;
-    delete m_axis_sweep;
+    delete m_broadphase;
     delete m_dispatcher;
     delete m_collision_conf;
 }   // ~Physics
@@ -152,6 +194,7 @@ void Physics::removeKart(const AbstractKart *kart)
 void Physics::update(int ticks)
 {
     PROFILER_PUSH_CPU_MARKER("Physics", 0, 0, 0);
+    const auto update_start = std::chrono::steady_clock::now();
 
     m_physics_loop_active = true;
     // Bullet can report the same collision more than once (up to 4
@@ -387,6 +430,9 @@ void Physics::update(int ticks)
         removeKart(m_karts_to_delete[i]);
     m_karts_to_delete.clear();
 
+    m_update_time += std::chrono::duration<double>
+        (std::chrono::steady_clock::now() - update_start).count();
+    m_update_count++;
     PROFILER_POP_CPU_MARKER();
 }   // update
 
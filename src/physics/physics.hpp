@@ -25,6 +25,7 @@
   */
 
 #include <set>
+#include <string>
 #include <vector>
 
 #include "btBulletDynamicsCommon.h"
@@ -145,10 +146,21 @@ private:
     IrrDebugDrawer                  *m_debug_drawer;
 
     btCollisionDispatcher           *m_dispatcher;
-    btBroadphaseInterface           *m_axis_sweep;
+    btBroadphaseInterface           *m_broadphase;
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    /** Name of the broadphase used, see createBroadphase(). */
+    std::string                      m_broadphase_name;
+
+    /** Wall clock time in seconds spent in update() since init(), and the
+     *  number of calls. Used to compare broadphases in profile mode. */
+    double                           m_update_time;
+    unsigned int                     m_update_count;
+
+    /** If not empty, the broadphase to use for all tracks. */
+    static std::string               m_broadphase_override;
+
     /** Singleton. */
     static Physics                  *m_physics;
 
@@ -177,6 +189,26 @@ public:
     /** Returns true if the debug drawer is enabled. */
     bool  isDebug() const     {return m_debug_drawer->debugEnabled(); }
     IrrDebugDrawer* getDebugDrawer() { return m_debug_drawer; }
+    static btBroadphaseInterface*
+          createBroadphase (const std::string &name,
+                            const Vec3 &min_world, const Vec3 &max_world);
+    // ------------------------------------------------------------------------
+    /** Sets a broadphase to use instead of the one selected by the track
+     *  and stk_config.xml (e.g. for benchmarking). */
+    static void setBroadphaseOverride(const std::string &name)
+    {
+        m_broadphase_override = name;
+    }   // setBroadphaseOverride
+    // ------------------------------------------------------------------------
+    /** Returns the name of the broadphase used. */
+    const std::string& getBroadphaseName() const { return m_broadphase_name; }
+    // ------------------------------------------------------------------------
+    /** Returns the wall clock time in seconds spent in update(). */
+    double getUpdateTime() const { return m_update_time; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of calls to update(). */
+    unsigned int getUpdateCount() const { return m_update_count; }
+    // ------------------------------------------------------------------------
     virtual btScalar solveGroup(btCollisionObject** bodies, int numBodies,
                                 btPersistentManifold** manifold,int numManifolds,
                                 btTypedConstraint** constraints,int numConstraints,
@@ -19,14 +19,38 @@
 #include "physics/triangle_mesh.hpp"
 
 #include "config/stk_config.hpp"
+#include "io/file_manager.hpp"
 #include "main_loop.hpp"
+#include "network/crypto.hpp"
 #include "physics/physics.hpp"
 #include "utils/constants.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/random_generator.hpp"
+#include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 
 #include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
 
-#include <fstream>
+#include <cstring>
+
+#ifdef WIN32
+#  include <process.h>
+#else
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/** Increase if the cache file format changes, so old BVH cache files are not
+ *  used anymore. */
+static const uint32_t BVH_CACHE_VERSION = 1;
+/** Version, number of triangles, size of the BVH (plus 4 unused bytes) and
+ *  sha256 hash of the triangles. The size is a multiple of 16, since bullet
+ *  needs the BVH to be aligned. */
+static const unsigned int BVH_CACHE_HEADER_SIZE = 48;
+
+bool TriangleMesh::m_use_bvh_cache = true;
 
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
@@ -44,6 +68,9 @@ TriangleMesh::TriangleMesh(bool can_be_transformed) : m_mesh()
     // (and m_mesh->m_weldingThreshold at m_normals
     m_collision_shape  = NULL;
     m_collision_object = NULL;
+    m_cached_bvh       = NULL;
+    m_cached_bvh_size  = 0;
+    m_bvh_from_cache   = false;
     m_user_pointer.set(this);
 }   // TriangleMesh
 
@@ -89,11 +116,15 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
 // -----------------------------------------------------------------------------
 /** Creates a collision body only, which can be used for raycasting, but
  *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+ *  \param create_collision_object If a collision object should be created.
+ *  \param use_bvh_cache If true, the BVH is loaded from the cache if it
+ *         was built for the same triangles before. Otherwise it is built,
+ *         and then saved in the cache.
  */
-void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
+void TriangleMesh::createCollisionShape(bool create_collision_object,
+                                        bool use_bvh_cache)
 {
+    m_bvh_from_cache = false;
     if(m_triangleIndex2Material.size()==0)
     {
         m_collision_shape  = NULL;
@@ -105,53 +136,31 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
     // Now convert the triangle mesh into a static rigid body
     btBvhTriangleMeshShape* bhv_triangle_mesh;
 
-    if (serialized_bhv != NULL)
+    std::string hash, cache_file;
+    if (use_bvh_cache && m_use_bvh_cache)
     {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
-
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
-
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
-        {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-        }
-        else
-        {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
-        }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
+        hash = getBvhHash();
+        cache_file = getBvhCacheFile(hash);
+    }
+    btOptimizedBvh* bvh = NULL;
+    if (!cache_file.empty())
+        bvh = loadBvhCache(cache_file, hash);
 
+    if (bvh)
+    {
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+            false /* useQuantizedAabbCompression */, false /* buildBvh */);
+        bhv_triangle_mesh->setOptimizedBvh(bvh);
+        m_bvh_from_cache = true;
     }
     else
     {
         bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
-
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
-
-        btAlignedFree(buffer);
-         */
+        if (!cache_file.empty())
+        {
+            saveBvhCache(cache_file, hash,
+                         bhv_triangle_mesh->getOptimizedBvh());
+        }
     }
 
     m_collision_shape = bhv_triangle_mesh;
@@ -178,16 +187,15 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  for height of terrain detection).
  *  \param friction Friction to be used for this TriangleMesh.
  *  \param flags Additional collision flags (default 0).
- *  \param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
+ *  \param use_bvh_cache If the BVH cache should be used (default false).
  */
 void TriangleMesh::createPhysicalBody(float friction,
                                       btCollisionObject::CollisionFlags flags,
-                                      const char* serializedBhv)
+                                      bool use_bvh_cache)
 {
     // We need the collision shape, but not the collision object (since
     // this will be created when the dynamics body is anyway).
-    createCollisionShape(/*create_collision_object*/false, serializedBhv);
+    createCollisionShape(/*create_collision_object*/false, use_bvh_cache);
     main_loop->renderGUI(5583);
 
     btTransform startTransform;
@@ -232,8 +240,201 @@ void TriangleMesh::removeAll()
     }
     delete m_collision_shape;
     m_collision_shape = NULL;
+    // The BVH was used by the collision shape, so it can only be freed now
+    freeCachedBvh();
 }   // removeAll
 
+// ----------------------------------------------------------------------------
+/** Returns the sha256 hash of all triangles, which identifies the cache file
+ *  of the BVH. The sizes of the bullet structures are included, since they
+ *  are stored as they are in memory.
+ */
+std::string TriangleMesh::getBvhHash() const
+{
+    std::string content;
+    const uint32_t sizes[4] = { (uint32_t)sizeof(btQuantizedBvh),
+                                (uint32_t)sizeof(btOptimizedBvhNode),
+                                (uint32_t)sizeof(btBvhSubtreeInfo),
+                                (uint32_t)sizeof(btScalar)          };
+    content.append((const char*)sizes, sizeof(sizes));
+    const IndexedMeshArray &meshes = m_mesh.getIndexedMeshArray();
+    for (int i = 0; i < meshes.size(); i++)
+    {
+        const btIndexedMesh &m = meshes[i];
+        content.append((const char*)m.m_vertexBase,
+                       m.m_numVertices * m.m_vertexStride);
+        content.append((const char*)m.m_triangleIndexBase,
+                       m.m_numTriangles * m.m_triangleIndexStride);
+    }
+    std::array<uint8_t, 32> hash = Crypto::sha256(content);
+    return std::string((const char*)hash.data(), hash.size());
+}   // getBvhHash
+
+// ----------------------------------------------------------------------------
+/** Returns the name of the cache file for a BVH with the given hash.
+ */
+std::string TriangleMesh::getBvhCacheFile(const std::string &hash)
+{
+    std::string cache_file = file_manager->getCachedDataDir() + "bvh-";
+    for (unsigned int i = 0; i < hash.size(); i++)
+    {
+        char hex[3];
+        snprintf(hex, 3, "%02x", (uint8_t)hash[i]);
+        cache_file += hex;
+    }
+    return cache_file + ".cache";
+}   // getBvhCacheFile
+
+// ----------------------------------------------------------------------------
+/** Tries to load the BVH from a cache file. The file contains the cache
+ *  version, the number of triangles, the size of the serialized BVH and the
+ *  hash of the triangles, followed by the BVH. Except on windows the file is
+ *  memory mapped (copy on write, since bullet fixes the pointers of the
+ *  loaded BVH), so the nodes are loaded on demand and shared between
+ *  processes.
+ *  \param cache_file Name of the cache file.
+ *  \param hash The hash of the triangles.
+ *  \return The BVH, or NULL if the cache file was not valid.
+ */
+btOptimizedBvh* TriangleMesh::loadBvhCache(const std::string &cache_file,
+                                           const std::string &hash)
+{
+    // The collision shape using the previous BVH must be removed first
+    assert(!m_cached_bvh);
+    if (m_cached_bvh)
+        return NULL;
+    FILE* fp = FileUtils::fopenU8Path(cache_file, "rb");
+    if (!fp)
+        return NULL;
+
+    uint8_t header[BVH_CACHE_HEADER_SIZE];
+    bool valid = fread(header, 1, BVH_CACHE_HEADER_SIZE, fp) ==
+                 BVH_CACHE_HEADER_SIZE;
+    uint32_t version = 0, num_triangles = 0, bvh_size = 0;
+    if (valid)
+    {
+        memcpy(&version, header, 4);
+        memcpy(&num_triangles, header + 4, 4);
+        memcpy(&bvh_size, header + 8, 4);
+        valid = version == BVH_CACHE_VERSION &&
+                num_triangles == m_triangleIndex2Material.size() &&
+                memcmp(header + 16, hash.data(), 32) == 0 &&
+                fseek(fp, 0, SEEK_END) == 0 &&
+                (size_t)ftell(fp) == BVH_CACHE_HEADER_SIZE + bvh_size;
+    }
+    if (!valid)
+    {
+        fclose(fp);
+        Log::info("TriangleMesh", "Ignoring outdated cache file '%s'.",
+                  cache_file.c_str());
+        return NULL;
+    }
+
+    const size_t size = BVH_CACHE_HEADER_SIZE + bvh_size;
+#ifdef WIN32
+    void* memory = btAlignedAlloc(bvh_size, 16);
+    fseek(fp, BVH_CACHE_HEADER_SIZE, SEEK_SET);
+    valid = fread(memory, 1, bvh_size, fp) == bvh_size;
+    fclose(fp);
+    if (!valid)
+    {
+        btAlignedFree(memory);
+        return NULL;
+    }
+    m_cached_bvh = memory;
+    m_cached_bvh_size = bvh_size;
+    uint8_t* data = (uint8_t*)memory;
+#else
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                        fileno(fp), 0);
+    fclose(fp);
+    if (memory == MAP_FAILED)
+        return NULL;
+    m_cached_bvh = memory;
+    m_cached_bvh_size = size;
+    uint8_t* data = (uint8_t*)memory + BVH_CACHE_HEADER_SIZE;
+#endif
+    btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(data, bvh_size,
+                                                     !IS_LITTLE_ENDIAN);
+    if (!bvh)
+    {
+        Log::warn("TriangleMesh", "Failed to load serialized BVH '%s'.",
+                  cache_file.c_str());
+        freeCachedBvh();
+    }
+    return bvh;
+}   // loadBvhCache
+
+// ----------------------------------------------------------------------------
+/** Saves the BVH to a cache file. A temporary file is renamed at the end, so
+ *  other processes never see a partial file.
+ *  \param cache_file Name of the cache file.
+ *  \param hash The hash of the triangles.
+ *  \param bvh The BVH to save.
+ */
+void TriangleMesh::saveBvhCache(const std::string &cache_file,
+                                const std::string &hash,
+                                const btOptimizedBvh *bvh) const
+{
+    const uint32_t bvh_size = bvh->calculateSerializeBufferSize();
+    void* buffer = btAlignedAlloc(bvh_size, 16);
+    if (!bvh->serializeInPlace(buffer, bvh_size, !IS_LITTLE_ENDIAN))
+    {
+        btAlignedFree(buffer);
+        return;
+    }
+
+    // Several processes (e.g. server rooms) might write the same file
+#ifdef WIN32
+    const int pid = _getpid();
+#else
+    const int pid = getpid();
+#endif
+    const std::string tmp_file = cache_file + "." +
+                                 StringUtils::toString(pid) + ".tmp";
+    FILE* fp = FileUtils::fopenU8Path(tmp_file, "wb");
+    if (!fp)
+    {
+        btAlignedFree(buffer);
+        Log::warn("TriangleMesh", "Can not write cache file '%s'.",
+                  tmp_file.c_str());
+        return;
+    }
+    uint8_t header[BVH_CACHE_HEADER_SIZE] = {};
+    const uint32_t num_triangles = (uint32_t)m_triangleIndex2Material.size();
+    memcpy(header, &BVH_CACHE_VERSION, 4);
+    memcpy(header + 4, &num_triangles, 4);
+    memcpy(header + 8, &bvh_size, 4);
+    memcpy(header + 16, hash.data(), 32);
+    bool ok = fwrite(header, 1, BVH_CACHE_HEADER_SIZE, fp) ==
+              BVH_CACHE_HEADER_SIZE &&
+              fwrite(buffer, 1, bvh_size, fp) == bvh_size;
+    ok = fclose(fp) == 0 && ok;
+    btAlignedFree(buffer);
+    if (!ok || FileUtils::renameU8Path(tmp_file, cache_file) != 0)
+    {
+        Log::warn("TriangleMesh", "Can not write cache file '%s'.",
+                  cache_file.c_str());
+        file_manager->removeFile(tmp_file);
+    }
+}   // saveBvhCache
+
+// ----------------------------------------------------------------------------
+/** Frees the memory of a BVH loaded from the cache.
+ */
+void TriangleMesh::freeCachedBvh()
+{
+    if (!m_cached_bvh)
+        return;
+#ifdef WIN32
+    btAlignedFree(m_cached_bvh);
+#else
+    munmap(m_cached_bvh, m_cached_bvh_size);
+#endif
+    m_cached_bvh      = NULL;
+    m_cached_bvh_size = 0;
+}   // freeCachedBvh
+
 // -----------------------------------------------------------------------------
 /** Interpolates the normal at the given position for the triangle with
  *  a given index. The position must be inside of the given triangle.
@@ -407,3 +608,136 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     return ray_callback.hasHit();
 
 }   // castRay
+
+// ============================================================================
+/** Unit testing for the BVH cache: casts random rays against a random mesh
+ *  with a BVH built as usual and with a BVH loaded from the cache, and checks
+ *  that the results are identical.
+ */
+void TriangleMesh::unitTesting()
+{
+    RandomGenerator random;
+    random.seed(4321);
+    auto random_float = [&random](float min, float max)
+    {
+        return min + random.get(10001) * 0.0001f * (max - min);
+    };
+
+    TriangleMesh mesh(/*can_be_transformed*/false);
+    // A bumpy ground, and some random triangles above it
+    const int size = 40;
+    const float cell = 2.5f;
+    std::vector<float> height((size + 1) * (size + 1));
+    for (float &h : height)
+        h = random_float(-1.0f, 1.0f);
+    const btVector3 up(0, 1, 0);
+    for (int z = 0; z < size; z++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            btVector3 p[4];
+            for (int i = 0; i < 4; i++)
+            {
+                const int px = x + (i == 1 || i == 2), pz = z + (i >= 2);
+                p[i] = btVector3(px * cell, height[pz * (size + 1) + px],
+                                 pz * cell);
+            }
+            mesh.addTriangle(p[0], p[2], p[1], up, up, up, NULL);
+            mesh.addTriangle(p[0], p[3], p[2], up, up, up, NULL);
+        }
+    }
+    const float max_xz = size * cell;
+    for (int i = 0; i < 500; i++)
+    {
+        btVector3 c(random_float(0, max_xz), random_float(1.0f, 8.0f),
+                    random_float(0, max_xz));
+        btVector3 p[3];
+        for (int j = 0; j < 3; j++)
+        {
+            p[j] = c + btVector3(random_float(-3, 3), random_float(-1, 1),
+                                 random_float(-3, 3));
+        }
+        mesh.addTriangle(p[0], p[1], p[2], up, up, up, NULL);
+    }
+    mesh.createCollisionShape();
+
+    int error_count = 0;
+
+    // A copy of the mesh, which first saves its BVH in the cache, and then
+    // loads it from the cache.
+    TriangleMesh cached_mesh(/*can_be_transformed*/false);
+    for (unsigned int i = 0; i < mesh.m_triangleIndex2Material.size(); i++)
+    {
+        btVector3 p[3];
+        mesh.getTriangle(i, &p[0], &p[1], &p[2]);
+        cached_mesh.addTriangle(p[0], p[1], p[2], up, up, up, NULL);
+    }
+    // Write the cache file into a temporary directory, so that the test
+    // does not leave any files in the cache of the user.
+    const std::string cached_data_dir = file_manager->getCachedDataDir();
+    const std::string temp_dir =
+        file_manager->createTempDirectory("stk-bvh-cache");
+    assert(!temp_dir.empty());
+    file_manager->setCachedDataDir(temp_dir);
+    const bool use_bvh_cache = m_use_bvh_cache;
+    m_use_bvh_cache = true;
+    const std::string cache_file = getBvhCacheFile(cached_mesh.getBvhHash());
+    cached_mesh.createCollisionShape(/*create_collision_object*/true,
+                                     /*use_bvh_cache*/true);
+    cached_mesh.removeAll();
+    cached_mesh.createCollisionShape(/*create_collision_object*/true,
+                                     /*use_bvh_cache*/true);
+    m_use_bvh_cache = use_bvh_cache;
+    if (!cached_mesh.isBvhFromCache())
+    {
+        Log::error("TriangleMesh", "BVH cache file '%s' was not used.",
+                   cache_file.c_str());
+        error_count++;
+    }
+
+    AlignedArray<btVector3> from, to;
+    for (int i = 0; i < 3000; i++)
+    {
+        btVector3 start(random_float(-5, max_xz + 5), random_float(-3, 12),
+                        random_float(-5, max_xz + 5));
+        from.push_back(start);
+        switch (i % 3)
+        {
+        // Long ray downwards as used in TerrainInfo
+        case 0: to.push_back(start - btVector3(0, 10000.0f, 0)); break;
+        // Short ray as used for the suspension of the karts
+        case 1: to.push_back(start - btVector3(0, 1.5f, 0));     break;
+        default:
+            to.push_back(start + btVector3(random_float(-20, 20),
+                                           random_float(-20, 20),
+                                           random_float(-20, 20)));
+        }
+    }
+
+    for (unsigned int i = 0; i < from.size(); i++)
+    {
+        btVector3 xyz, normal, cached_xyz, cached_normal;
+        const Material *material, *cached_material;
+        bool has_hit = mesh.castRay(from[i], to[i], &xyz, &material,
+                                    &normal);
+        bool cached_hit = cached_mesh.castRay(from[i], to[i], &cached_xyz,
+                                              &cached_material,
+                                              &cached_normal);
+        // Only compare x, y and z, since w is not set by the raycast
+        if (has_hit != cached_hit ||
+            (has_hit && (xyz.getX() != cached_xyz.getX() ||
+                         xyz.getY() != cached_xyz.getY() ||
+                         xyz.getZ() != cached_xyz.getZ() ||
+                         normal.getX() != cached_normal.getX() ||
+                         normal.getY() != cached_normal.getY() ||
+                         normal.getZ() != cached_normal.getZ())))
+        {
+            Log::error("TriangleMesh", "Ray %d differs with the cached BVH.",
+                       i);
+            error_count++;
+        }
+    }
+    file_manager->setCachedDataDir(cached_data_dir);
+    file_manager->removeDirectory(temp_dir);
+    assert(error_count == 0);
+}   // unitTesting
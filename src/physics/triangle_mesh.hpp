@@ -19,12 +19,14 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <string>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
 #include "physics/user_pointer.hpp"
 #include "utils/aligned_array.hpp"
 
+class btOptimizedBvh;
 class Material;
 
 /**
@@ -57,6 +59,29 @@ private:
      *  to the current transform of the body. */
     bool m_can_be_transformed;
 
+    /** Memory holding the BVH if it was loaded from the cache. It must only
+     *  be freed after the collision shape using the BVH is deleted. */
+    void                        *m_cached_bvh;
+
+    /** Size of m_cached_bvh (which is memory mapped except on windows). */
+    size_t                       m_cached_bvh_size;
+
+    /** True if the BVH of the collision shape was loaded from the cache. */
+    bool                         m_bvh_from_cache;
+
+    /** Can be used to disable the BVH cache, e.g. to compare loading
+     *  times. */
+    static bool                  m_use_bvh_cache;
+
+    std::string     getBvhHash() const;
+    static std::string getBvhCacheFile(const std::string &hash);
+    btOptimizedBvh* loadBvhCache(const std::string &cache_file,
+                                 const std::string &hash);
+    void            saveBvhCache(const std::string &cache_file,
+                                 const std::string &hash,
+                                 const btOptimizedBvh *bvh) const;
+    void            freeCachedBvh();
+
 public:
     class RigidBodyTriangleMesh : public btRigidBody
     {
@@ -76,11 +101,12 @@ public:
                      const btVector3 &t3, const btVector3 &n1,
                      const btVector3 &n2, const btVector3 &n3,
                      const Material* m);
-    void createCollisionShape(bool create_collision_object=true, const char* serialized_bhv=NULL);
+    void createCollisionShape(bool create_collision_object=true,
+                              bool use_bvh_cache=false);
     void createPhysicalBody(float friction,
                             btCollisionObject::CollisionFlags flags=
                                (btCollisionObject::CollisionFlags)0,
-                            const char* serializedBhv = NULL);
+                            bool use_bvh_cache=false);
     void removeAll();
     void removeCollisionObject();
     btVector3 getInterpolatedNormal(unsigned int index,
@@ -112,6 +138,14 @@ public:
     bool castRay(const btVector3 &from, const btVector3 &to,
                  btVector3 *xyz, const Material **material,
                  btVector3 *normal=NULL, bool interpolate_normal=false) const;
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Enables or disables the BVH cache for all meshes. */
+    static void setUseBvhCache(bool use_cache) { m_use_bvh_cache = use_cache; }
+    // ------------------------------------------------------------------------
+    /** Returns true if the BVH of the collision shape was loaded from the
+     *  cache, and not built. */
+    bool isBvhFromCache() const { return m_bvh_from_cache; }
     // ------------------------------------------------------------------------
     /** Returns the points of the 'indx' triangle.
      *  \param indx Index of the triangle to get.
@@ -86,10 +86,10 @@ void KartColorSliderDialog::beforeAddingWidgets()
 
     const KartProperties* props =
         kart_properties_manager->getKart(UserConfigParams::m_default_kart);
-    if (props == NULL)
+    if (props == NULL || !props->loadModels())
     {
-        Log::warn("KartColorSliderDialog", "Unknown kart %s, fallback to tux",
-            UserConfigParams::m_default_kart.c_str());
+        Log::warn("KartColorSliderDialog", "Cannot use kart %s, fallback "
+            "to tux", UserConfigParams::m_default_kart.c_str());
         props = kart_properties_manager->getKart(std::string("tux"));
     }
     const KartModel& kart_model = props->getMasterKartModel();
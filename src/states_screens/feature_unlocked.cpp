@@ -367,6 +367,9 @@ void FeatureUnlockedCutScene::init()
         }
         else if (m_unlocked_stuff[n].m_unlocked_kart != NULL)
         {
+            // Nothing is shown if the model of the kart can not be loaded
+            if (!m_unlocked_stuff[n].m_unlocked_kart->loadModels())
+                continue;
             KartModel *kart_model =
                 m_unlocked_stuff[n].m_unlocked_kart->getKartModelCopy();
             m_all_kart_models.push_back(kart_model);
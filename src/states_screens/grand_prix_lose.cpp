@@ -182,7 +182,7 @@ void GrandPrixLose::setKarts(std::vector<std::pair<std::string, float> > ident_a
     for (int n=0; n<count; n++)
     {
         const KartProperties* kart = kart_properties_manager->getKart(ident_arg[n].first);
-        if (kart != NULL)
+        if (kart != NULL && kart->loadModels())
         {
             KartModel* kart_model = kart->getKartModelCopy(std::make_shared<RenderInfo>(ident_arg[n].second));
             m_all_kart_models.push_back(kart_model);
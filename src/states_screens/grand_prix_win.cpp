@@ -342,7 +342,7 @@ void GrandPrixWin::setKarts(const std::pair<std::string, float> idents_arg[3])
     for (int i = 0; i < 3; i++)
     {
         const KartProperties* kp = kart_properties_manager->getKart(idents[i].first);
-        if (kp == NULL) continue;
+        if (kp == NULL || !kp->loadModels()) continue;
 
         KartModel* kart_model = kp->getKartModelCopy(std::make_shared<RenderInfo>(idents[i].second));
         m_all_kart_models.push_back(kart_model);
@@ -919,7 +919,7 @@ void KartSelectionScreen::updateKartWidgetModel(int widget_id,
     {
         const KartProperties *kp =
             kart_properties_manager->getKart(selection);
-        if (kp != NULL)
+        if (kp != NULL && kp->loadModels())
         {
             const KartModel &kart_model = kp->getMasterKartModel();
 
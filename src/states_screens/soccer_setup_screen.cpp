@@ -116,6 +116,9 @@ void SoccerSetupScreen::beforeAddingWidget()
         const std::string&      kart_name   = kart_info.getKartName();
 
         const KartProperties*   props       = kart_properties_manager->getKart(kart_name);
+        // The race uses tux if the model can not be loaded (see AbstractKart)
+        if (!props->loadModels())
+            props = kart_properties_manager->getKart(std::string("tux"));
         const KartModel&        kart_model  = props->getMasterKartModel();
 
         // Add the view
@@ -21,24 +21,73 @@
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "network/crypto.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/arena_node.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
-#include <queue>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#ifdef WIN32
+#  include <process.h>
+#else
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+/** Increase if the cache file format or the shortest path computation
+ *  changes, so old cache files are not used anymore. */
+static const uint32_t CACHE_VERSION = 3;
+/** Version, number of nodes and sha256 hash of the navmesh. The size is a
+ *  multiple of 8, so the matrices in the memory mapped file are aligned. */
+static const unsigned int CACHE_HEADER_SIZE = 40;
 
 // -----------------------------------------------------------------------------
 ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
           : Graph()
 {
+    m_distances          = NULL;
+    m_parents            = NULL;
+    m_cache_mapping      = NULL;
+    m_cache_mapping_size = 0;
+
     loadNavmesh(navmesh);
-    buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+    createGrid();
+
+    // The shortest paths only depend on the navmesh, so they are cached
+    // to avoid computing them each time the arena is loaded.
+    const std::string hash = getNavmeshHash(navmesh);
+    std::string cache_file;
+    if (!hash.empty())
+    {
+        cache_file = file_manager->getCachedDataDir() + "arena-";
+        for (unsigned int i = 0; i < hash.size(); i++)
+        {
+            char hex[3];
+            snprintf(hex, 3, "%02x", (uint8_t)hash[i]);
+            cache_file += hex;
+        }
+        cache_file += ".cache";
+    }
+    if (cache_file.empty() || !loadCache(cache_file, hash))
+    {
+        buildGraph();
+        // Compute shortest distance from all nodes
+        computeAllShortestPaths(ThreadPool::getShared());
+        m_distances = m_distance_matrix.data();
+        m_parents   = m_parent_node.data();
+        if (!cache_file.empty())
+            saveCache(cache_file, hash);
+    }
 
     setNearbyNodesOfAllNodes();
     if (node && race_manager->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
@@ -48,6 +97,145 @@ ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
 
 }   // ArenaGraph
 
+// -----------------------------------------------------------------------------
+ArenaGraph::~ArenaGraph()
+{
+#ifndef WIN32
+    if (m_cache_mapping)
+        munmap(m_cache_mapping, m_cache_mapping_size);
+#endif
+}   // ~ArenaGraph
+
+// -----------------------------------------------------------------------------
+/** Returns the sha256 hash of the navmesh file, which identifies the cache
+ *  file of the shortest paths. Returns an empty string if the file can not
+ *  be read or has no nodes.
+ */
+std::string ArenaGraph::getNavmeshHash(const std::string &navmesh) const
+{
+    if (getNumNodes() == 0)
+        return "";
+    FILE* fp = FileUtils::fopenU8Path(navmesh, "rb");
+    if (!fp)
+        return "";
+    std::string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        content.append(buffer, n);
+    fclose(fp);
+    std::array<uint8_t, 32> hash = Crypto::sha256(content);
+    return std::string((const char*)hash.data(), hash.size());
+}   // getNavmeshHash
+
+// -----------------------------------------------------------------------------
+/** Tries to use the shortest paths from a cache file. The file contains the
+ *  cache version, the number of nodes and the hash of the navmesh, followed
+ *  by the distance and parent matrices. Except on windows the file is memory
+ *  mapped, so it is loaded on demand and shared between processes.
+ *  \param cache_file Name of the cache file.
+ *  \param hash The hash of the navmesh file.
+ *  \return True if the cache was valid and is used.
+ */
+bool ArenaGraph::loadCache(const std::string &cache_file,
+                           const std::string &hash)
+{
+    const uint32_t n = getNumNodes();
+    const size_t size = CACHE_HEADER_SIZE +
+                        n * n * (sizeof(float) + sizeof(int16_t));
+    FILE* fp = FileUtils::fopenU8Path(cache_file, "rb");
+    if (!fp)
+        return false;
+
+    uint8_t header[CACHE_HEADER_SIZE];
+    bool valid = fread(header, 1, CACHE_HEADER_SIZE, fp) == CACHE_HEADER_SIZE;
+    uint32_t version = 0, num_nodes = 0;
+    if (valid)
+    {
+        memcpy(&version, header, 4);
+        memcpy(&num_nodes, header + 4, 4);
+        valid = version == CACHE_VERSION && num_nodes == n &&
+                memcmp(header + 8, hash.data(), 32) == 0 &&
+                fseek(fp, 0, SEEK_END) == 0 && (size_t)ftell(fp) == size;
+    }
+    if (!valid)
+    {
+        fclose(fp);
+        Log::info("ArenaGraph", "Ignoring outdated cache file '%s'.",
+                  cache_file.c_str());
+        return false;
+    }
+
+#ifdef WIN32
+    m_distance_matrix.resize(n * n);
+    m_parent_node.resize(n * n);
+    fseek(fp, CACHE_HEADER_SIZE, SEEK_SET);
+    valid = fread(m_distance_matrix.data(), sizeof(float), n * n, fp) == n * n
+         && fread(m_parent_node.data(), sizeof(int16_t), n * n, fp) == n * n;
+    fclose(fp);
+    if (!valid)
+        return false;
+    m_distances = m_distance_matrix.data();
+    m_parents   = m_parent_node.data();
+#else
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+    fclose(fp);
+    if (mapping == MAP_FAILED)
+        return false;
+    if (m_cache_mapping)
+        munmap(m_cache_mapping, m_cache_mapping_size);
+    m_cache_mapping      = mapping;
+    m_cache_mapping_size = size;
+    const uint8_t* data = (const uint8_t*)mapping + CACHE_HEADER_SIZE;
+    m_distances = (const float*)data;
+    m_parents   = (const int16_t*)(data + n * n * sizeof(float));
+#endif
+    return true;
+}   // loadCache
+
+// -----------------------------------------------------------------------------
+/** Saves the computed shortest paths to a cache file. A temporary file is
+ *  renamed at the end, so other processes never see a partial file.
+ *  \param cache_file Name of the cache file.
+ *  \param hash The hash of the navmesh file.
+ */
+void ArenaGraph::saveCache(const std::string &cache_file,
+                           const std::string &hash) const
+{
+    const uint32_t n = getNumNodes();
+    assert(m_distance_matrix.size() == n * n);
+    assert(m_parent_node.size() == n * n);
+    // Several processes (e.g. server rooms) might write the same file
+#ifdef WIN32
+    const int pid = _getpid();
+#else
+    const int pid = getpid();
+#endif
+    const std::string tmp_file = cache_file + "." +
+                                 StringUtils::toString(pid) + ".tmp";
+    FILE* fp = FileUtils::fopenU8Path(tmp_file, "wb");
+    if (!fp)
+    {
+        Log::warn("ArenaGraph", "Can not write cache file '%s'.",
+                  tmp_file.c_str());
+        return;
+    }
+    uint8_t header[CACHE_HEADER_SIZE];
+    memcpy(header, &CACHE_VERSION, 4);
+    memcpy(header + 4, &n, 4);
+    memcpy(header + 8, hash.data(), 32);
+    bool ok = fwrite(header, 1, CACHE_HEADER_SIZE, fp) == CACHE_HEADER_SIZE &&
+        fwrite(m_distance_matrix.data(), sizeof(float), n * n, fp) == n * n &&
+        fwrite(m_parent_node.data(), sizeof(int16_t), n * n, fp) == n * n;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || FileUtils::renameU8Path(tmp_file, cache_file) != 0)
+    {
+        Log::warn("ArenaGraph", "Can not write cache file '%s'.",
+                  cache_file.c_str());
+        file_manager->removeFile(tmp_file);
+    }
+}   // saveCache
+
 // -----------------------------------------------------------------------------
 ArenaNode* ArenaGraph::getNode(unsigned int i) const
 {
@@ -179,8 +367,8 @@ void ArenaGraph::buildGraph()
 {
     const unsigned int n_nodes = getNumNodes();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
+    m_distance_matrix.clear();
+    m_distance_matrix.resize(n_nodes * n_nodes, 9999.9f);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         ArenaNode* cur_node = getNode(i);
@@ -188,27 +376,60 @@ void ArenaGraph::buildGraph()
         {
             Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
             float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            m_distance_matrix[i * n_nodes + adjacent] = distance;
         }
-        m_distance_matrix[i][i] = 0.0f;
+        m_distance_matrix[i * n_nodes + i] = 0.0f;
     }
 
     // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
+    m_parent_node.clear();
+    m_parent_node.resize(n_nodes * n_nodes, Graph::UNKNOWN_SECTOR);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            if (i == j || m_distance_matrix[i * n_nodes + j] >= 9899.9f)
+                m_parent_node[i * n_nodes + j] = -1;
             else
-                m_parent_node[i][j] = i;
+                m_parent_node[i * n_nodes + j] = i;
         }   // for j
     }   // for i
 
 }   // buildGraph
 
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths between all nodes by running Dijkstra for
+ *  each node. Each source node is independent, so they are computed in
+ *  parallel. buildGraph must be called first.
+ *  \param pool The thread pool to use.
+ */
+void ArenaGraph::computeAllShortestPaths(ThreadPool* pool)
+{
+    const unsigned int n = getNumNodes();
+    // computeDijkstra overwrites the rows of the distance matrix, so the
+    // length of the edges is saved before.
+    std::vector<std::vector<float> > edge_length(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (const int& adjacent : getNode(i)->getAdjacentNodes())
+            edge_length[i].push_back(m_distance_matrix[i * n + adjacent]);
+    }
+
+    // Give each thread several blocks of nodes to balance the load, the
+    // heap and visited flags are reused for all nodes of a block.
+    const unsigned int num_blocks =
+        std::min(n, (pool->getNumThreads() + 1) * 4);
+    pool->parallelFor(num_blocks, [this, n, num_blocks, &edge_length]
+                                  (unsigned int block)
+    {
+        std::vector<std::pair<float, int> > heap;
+        std::vector<bool> visited;
+        for (unsigned int i = block * n / num_blocks;
+             i < (block + 1) * n / num_blocks; i++)
+            computeDijkstra(i, edge_length, &heap, &visited);
+    });
+}   // computeAllShortestPaths
+
 // ----------------------------------------------------------------------------
 /** Dijkstra shortest path computation. It computes the shortest distance from
  *  the specified node 'source' to all other nodes. At the end of the
@@ -216,50 +437,60 @@ void ArenaGraph::buildGraph()
  *  source to j and m_parent_node[source][j] stores the last vertex visited on
  *  the shortest path from i to j before visiting j. Suppose the shortest path
  *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  Only the row of the source node is modified, so this can be called for
+ *  different source nodes in parallel.
+ *  \param edge_length The length of the edges to all adjacent nodes.
+ *  \param heap, visited Scratch memory which is reused between calls.
  */
-void ArenaGraph::computeDijkstra(int source)
+void ArenaGraph::computeDijkstra(int source,
+                        const std::vector<std::vector<float> >& edge_length,
+                        std::vector<std::pair<float, int> >* heap,
+                        std::vector<bool>* visited)
 {
-    // Stores the distance (float) to 'source' from a specified node (int)
-    typedef std::pair<int, float> IndDistPair;
-
-    class Shortest
-    {
-    public:
-        bool operator()(const IndDistPair &p1, const IndDistPair &p2)
-        {
-            return p1.second > p2.second;
-        }
-    };
+    // Stores the distance to 'source' of a node, the closest node is
+    // at the top of the heap.
+    typedef std::pair<float, int> DistIndPair;
+    std::greater<DistIndPair> shortest;
 
-    std::priority_queue<IndDistPair, std::vector<IndDistPair>, Shortest> queue;
-    IndDistPair begin(source, 0.0f);
-    queue.push(begin);
     const unsigned int n = getNumNodes();
-    std::vector<bool> visited;
-    visited.resize(n, false);
-    while (!queue.empty())
+    float* distance = &m_distance_matrix[source * n];
+    int16_t* parent = &m_parent_node[source * n];
+    // buildGraph stores the length of the edges in the row, which would
+    // prevent the adjacent nodes from being improved (and added to the
+    // heap), so the row is reset.
+    std::fill(distance, distance + n, 9999.9f);
+    std::fill(parent, parent + n, -1);
+    distance[source] = 0.0f;
+    heap->clear();
+    heap->emplace_back(0.0f, source);
+    visited->assign(n, false);
+    while (!heap->empty())
     {
         // Get element with shortest path
-        IndDistPair current = queue.top();
-        queue.pop();
-        int cur_index = current.first;
-        if (visited[cur_index]) continue;
-        visited[cur_index] = true;
-
-        for (const int& adjacent : getNode(cur_index)->getAdjacentNodes())
+        std::pop_heap(heap->begin(), heap->end(), shortest);
+        const DistIndPair current = heap->back();
+        heap->pop_back();
+        int cur_index = current.second;
+        if ((*visited)[cur_index]) continue;
+        (*visited)[cur_index] = true;
+
+        const std::vector<int>& adjacent_nodes =
+            getNode(cur_index)->getAdjacentNodes();
+        for (unsigned int i = 0; i < adjacent_nodes.size(); i++)
         {
+            const int adjacent = adjacent_nodes[i];
             // Distance already computed, can be ignored
-            if (visited[adjacent]) continue;
+            if ((*visited)[adjacent]) continue;
 
-            float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+            float new_dist = current.first + edge_length[cur_index][i];
+            // Only add a node again if its distance was improved
+            if (new_dist < distance[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                distance[adjacent] = new_dist;
+                parent[adjacent] = cur_index;
+                heap->emplace_back(new_dist, adjacent);
+                std::push_heap(heap->begin(), heap->end(), shortest);
             }
-            IndDistPair pair(adjacent, new_dist);
-            queue.push(pair);
         }
     }
 }   // computeDijkstra
@@ -284,12 +515,12 @@ void ArenaGraph::computeFloydWarshall()
         {
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                const float d = m_distance_matrix[i * n + k] +
+                                m_distance_matrix[k * n + j];
+                if (d < m_distance_matrix[i * n + j])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    m_distance_matrix[i * n + j] = d;
+                    m_parent_node[i * n + j] = m_parent_node[k * n + j];
                 }
             }
         }
@@ -346,7 +577,8 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        std::vector<float> dist(m_distances + i * getNumNodes(),
+                                m_distances + (i + 1) * getNumNodes());
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -368,38 +600,120 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
  *  std::vector (in reverse order). Used only for unit testing.
  */
 std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+                                const std::vector<int16_t>& parent_node) const
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = parent_node[from * getNumNodes() + to];
         path.push_back(to);
     }
     return path;
 }   // getPathFromTo
 
+// ============================================================================
+/** Compares the time needed to compute the shortest paths of all arenas with
+ *  one thread, with all threads, and with Floyd-Warshall.
+ */
+void ArenaGraph::benchmark()
+{
+    ThreadPool serial(0, "ArenaGraph");
+    ThreadPool* parallel = ThreadPool::getShared();
+    for (unsigned int t = 0; t < track_manager->getNumberOfTracks(); t++)
+    {
+        const Track* track = track_manager->getTrack(t);
+        if (!(track->isArena() || track->isSoccer()) || !track->hasNavMesh())
+            continue;
+        ArenaGraph* ag = new ArenaGraph(track->getTrackFile("navmesh.xml"));
+
+        double start = StkTime::getRealTime();
+        ag->buildGraph();
+        ag->computeAllShortestPaths(&serial);
+        const double serial_time = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        ag->buildGraph();
+        ag->computeAllShortestPaths(parallel);
+        const double parallel_time = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        ag->buildGraph();
+        ag->computeFloydWarshall();
+        const double floyd_time = StkTime::getRealTime() - start;
+
+        Log::info("ArenaGraph", "%s (%d nodes): Dijkstra %.2f ms in one "
+            "thread, %.2f ms with %d threads, Floyd-Warshall %.2f ms.",
+            track->getIdent().c_str(), ag->getNumNodes(),
+            serial_time * 1000.0, parallel_time * 1000.0,
+            parallel->getNumThreads() + 1, floyd_time * 1000.0);
+        delete ag;
+    }
+}   // benchmark
+
 // ============================================================================
 /** Unit testing for arena graph distance and parent node computation.
  *  Instead of using hand-tuned test cases we use the tested, verified and
  *  easier to understand Floyd-Warshall algorithm to compute the distances,
  *  and check if the (significanty faster) Dijkstra algorithm gives the same
- *  results. For now we use the cave mesh as test case.
+ *  results. It also checks that the cache file contains the same results.
+ *  For now we use the cave mesh as test case.
  */
 void ArenaGraph::unitTesting()
 {
+    // Write all cache files into a temporary directory, so that the test
+    // does not leave any files in the cache of the user.
+    const std::string cached_data_dir = file_manager->getCachedDataDir();
+    const std::string temp_dir =
+        file_manager->createTempDirectory("stk-arena-graph");
+    assert(!temp_dir.empty());
+    file_manager->setCachedDataDir(temp_dir);
+
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
-    double s = StkTime::getRealTime();
     ArenaGraph* ag = new ArenaGraph(navmesh_file_name);
+    const unsigned int n = ag->getNumNodes();
+    // The results might have been loaded from the cache file, so save
+    // them to compare them with the computed results.
+    std::vector<float> loaded_distance(ag->m_distances,
+                                       ag->m_distances + n * n);
+    std::vector<int16_t> loaded_parent(ag->m_parents, ag->m_parents + n * n);
+
+    double s = StkTime::getRealTime();
+    ag->buildGraph();
+    ag->computeAllShortestPaths(ThreadPool::getShared());
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
+    assert(ag->m_distance_matrix == loaded_distance);
+    assert(ag->m_parent_node == loaded_parent);
+
+    // Check that writing and reading a cache file gives the same results
+    const std::string hash = ag->getNavmeshHash(navmesh_file_name);
+    const std::string cache_file = file_manager->getCachedDataDir() +
+                                   "unit-test-arena.cache";
+    ag->saveCache(cache_file, hash);
+    if (!ag->loadCache(cache_file, hash))
+    {
+        Log::error("ArenaGraph", "Cache file '%s' could not be loaded.",
+                   cache_file.c_str());
+        assert(false);
+    }
+    assert(std::equal(loaded_distance.begin(), loaded_distance.end(),
+                      ag->m_distances));
+    assert(std::equal(loaded_parent.begin(), loaded_parent.end(),
+                      ag->m_parents));
+    // A different navmesh must not use this cache file
+    if (ag->loadCache(cache_file, std::string(32, 'x')))
+    {
+        Log::error("ArenaGraph", "Cache file used for wrong navmesh.");
+        assert(false);
+    }
+    file_manager->removeFile(cache_file);
 
     // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
+    std::vector<float> distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> parent_node = ag->m_parent_node;
     ag->buildGraph();
 
     // Now compute results with Floyd-Warshall
@@ -409,15 +723,16 @@ void ArenaGraph::unitTesting()
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
     int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            const unsigned int ij = i * n + j;
+            if(fabsf(ag->m_distance_matrix[ij] - distance_matrix[ij]) > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, distance_matrix[ij], ag->m_distance_matrix[ij]);
                 error_count++;
             }    // if distance is too different
 
@@ -429,16 +744,18 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(ag->m_parent_node[ij] != parent_node[ij])
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path =
+                    ag->getPathFromTo(i, j, parent_node);
+                std::vector<int16_t> floyd_path =
+                    ag->getPathFromTo(i, j, ag->m_parent_node);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, parent_node[ij], ag->m_parent_node[ij]);
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
@@ -458,4 +775,6 @@ void ArenaGraph::unitTesting()
 
     delete ag;
 
+    file_manager->setCachedDataDir(cached_data_dir);
+    file_manager->removeDirectory(temp_dir);
 }   // unitTesting
@@ -25,6 +25,7 @@
 #include <set>
 
 class ArenaNode;
+class ThreadPool;
 class XMLNode;
 
 /**
@@ -34,11 +35,24 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
+    /** The actual graph data structure, it is an adjacency matrix. After
+     *  computeDijkstra it contains the shortest distance between all nodes.
+     *  The n x n matrix is stored row by row in one array. It is empty if
+     *  the matrix is loaded from the cache file. */
+    std::vector<float> m_distance_matrix;
 
-    /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    /** The matrix that is used to store computed shortest paths (n x n,
+     *  row by row, empty if the cache file is used). */
+    std::vector<int16_t> m_parent_node;
+
+    /** The distance and parent matrices used, either the data of the vectors
+     *  above or the memory mapped cache file. */
+    const float*   m_distances;
+    const int16_t* m_parents;
+
+    /** The memory mapped cache file, or NULL if not used. */
+    void*  m_cache_mapping;
+    size_t m_cache_mapping_size;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -54,12 +68,24 @@ private:
     // ------------------------------------------------------------------------
     void setNearbyNodesOfAllNodes();
     // ------------------------------------------------------------------------
-    void computeDijkstra(int n);
+    void computeAllShortestPaths(ThreadPool* pool);
+    // ------------------------------------------------------------------------
+    void computeDijkstra(int source,
+                         const std::vector<std::vector<float> >& edge_length,
+                         std::vector<std::pair<float, int> >* heap,
+                         std::vector<bool>* visited);
     // ------------------------------------------------------------------------
     void computeFloydWarshall();
     // ------------------------------------------------------------------------
-    static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+    std::string getNavmeshHash(const std::string &navmesh) const;
+    // ------------------------------------------------------------------------
+    bool loadCache(const std::string &cache_file, const std::string &hash);
+    // ------------------------------------------------------------------------
+    void saveCache(const std::string &cache_file,
+                   const std::string &hash) const;
+    // ------------------------------------------------------------------------
+    std::vector<int16_t> getPathFromTo(int from, int to,
+                                const std::vector<int16_t>& parent_node) const;
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
@@ -70,9 +96,11 @@ public:
     // ------------------------------------------------------------------------
     static void unitTesting();
     // ------------------------------------------------------------------------
+    static void benchmark();
+    // ------------------------------------------------------------------------
     ArenaGraph(const std::string &navmesh, const XMLNode *node = NULL);
     // ------------------------------------------------------------------------
-    virtual ~ArenaGraph() {}
+    virtual ~ArenaGraph();
     // ------------------------------------------------------------------------
     ArenaNode* getNode(unsigned int i) const;
     // ------------------------------------------------------------------------
@@ -84,7 +112,7 @@ public:
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return (int)(m_parents[j * getNumNodes() + i]);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -92,7 +120,7 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        return m_distances[from * getNumNodes() + to];
     }
 
 };   // ArenaGraph
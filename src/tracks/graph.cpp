@@ -26,12 +26,20 @@
 #include "graphics/sp/sp_mesh.hpp"
 #include "graphics/sp/sp_mesh_buffer.hpp"
 #include "guiengine/engine.hpp"
+#include "io/file_manager.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/arena_graph.hpp"
 #include "tracks/arena_node_3d.hpp"
+#include "tracks/drive_graph.hpp"
 #include "tracks/drive_node_2d.hpp"
 #include "tracks/drive_node_3d.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
+#include "utils/random_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 const int Graph::UNKNOWN_SECTOR = -1;
 const float Graph::MIN_HEIGHT_TESTING = -1.0f;
@@ -48,6 +56,12 @@ Graph::Graph()
     m_bb_min      = Vec3( 99999,  99999,  99999);
     m_bb_max      = Vec3(-99999, -99999, -99999);
     memset(m_bb_nodes, 0, 4 * sizeof(int));
+    m_grid_min_x     = 0.0f;
+    m_grid_min_z     = 0.0f;
+    m_grid_cell_size = 1.0f;
+    m_grid_width     = 0;
+    m_grid_height    = 0;
+    m_use_grid       = true;
 }  // Graph
 
 // -----------------------------------------------------------------------------
@@ -615,6 +629,12 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
         return;
     }   // if still on same quad
 
+    if (m_use_grid && !m_grid_cells.empty() && !all_sectors)
+    {
+        findRoadSectorInGrid(xyz, sector, ignore_vertical);
+        return;
+    }
+
     // Now we search through all quads, starting with
     // the current one
     int indx       = *sector;
@@ -681,6 +701,9 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
                                std::vector<int> *all_sectors,
                                bool ignore_vertical) const
 {
+    if (m_use_grid && !m_grid_cells.empty() && !all_sectors)
+        return findOutOfRoadSectorInGrid(xyz, curr_sector, ignore_vertical);
+
     int count = (all_sectors!=NULL) ? (int)all_sectors->size() : getNumNodes();
     int current_sector = 0;
     if(curr_sector != UNKNOWN_SECTOR && !all_sectors)
@@ -772,3 +795,345 @@ void Graph::loadBoundingBoxNodes()
     m_bb_nodes[3] = findOutOfRoadSector(Vec3(m_bb_max.x(), 0, m_bb_max.z()),
         -1/*curr_sector*/, NULL/*all_sectors*/, true/*ignore_vertical*/);
 }   // loadBoundingBoxNodes
+
+//-----------------------------------------------------------------------------
+/** Creates a uniform 2d grid over the bounding boxes (in x/z) of all quads,
+ *  which is used to only test quads close to a point in findRoadSector and
+ *  findOutOfRoadSector. Must be called after all quads are created.
+ */
+void Graph::createGrid()
+{
+    m_grid_cells.clear();
+    m_grid_width  = 0;
+    m_grid_height = 0;
+    if (m_all_nodes.empty())
+        return;
+
+    // Bounding box (min x, min z, max x, max z) of each quad. The box of a
+    // 3d quad used in pointInside extends up to 5 units along the normal,
+    // and a small epsilon avoids problems with rounding errors.
+    std::vector<float> bb(m_all_nodes.size() * 4);
+    m_grid_min_x = m_grid_min_z = 999999.0f;
+    float max_x = -999999.0f, max_z = -999999.0f;
+    for (unsigned int i = 0; i < m_all_nodes.size(); i++)
+    {
+        const Quad* q = m_all_nodes[i];
+        float *b = &bb[i * 4];
+        b[0] = b[2] = (*q)[0].getX();
+        b[1] = b[3] = (*q)[0].getZ();
+        for (int j = 1; j < 4; j++)
+        {
+            b[0] = std::min(b[0], (*q)[j].getX());
+            b[1] = std::min(b[1], (*q)[j].getZ());
+            b[2] = std::max(b[2], (*q)[j].getX());
+            b[3] = std::max(b[3], (*q)[j].getZ());
+        }
+        const float margin = q->is3DQuad() ? 5.01f : 0.01f;
+        b[0] -= margin; b[1] -= margin;
+        b[2] += margin; b[3] += margin;
+        m_grid_min_x = std::min(m_grid_min_x, b[0]);
+        m_grid_min_z = std::min(m_grid_min_z, b[1]);
+        max_x        = std::max(max_x, b[2]);
+        max_z        = std::max(max_z, b[3]);
+    }
+
+    // Aim for about one quad per cell, but limit the number of cells
+    // for very big or unevenly distributed tracks.
+    const int MAX_CELLS = 512;
+    const float dx = max_x - m_grid_min_x;
+    const float dz = max_z - m_grid_min_z;
+    m_grid_cell_size = sqrtf(dx * dz / m_all_nodes.size());
+    m_grid_cell_size = std::max(m_grid_cell_size, 1.0f);
+    m_grid_cell_size = std::max(m_grid_cell_size, dx / MAX_CELLS);
+    m_grid_cell_size = std::max(m_grid_cell_size, dz / MAX_CELLS);
+    m_grid_width  = (int)(dx / m_grid_cell_size) + 1;
+    m_grid_height = (int)(dz / m_grid_cell_size) + 1;
+    m_grid_cells.resize(m_grid_width * m_grid_height);
+
+    for (unsigned int i = 0; i < m_all_nodes.size(); i++)
+    {
+        int x0, z0, x1, z1;
+        getGridCell(Vec3(bb[i * 4    ], 0, bb[i * 4 + 1]), &x0, &z0);
+        getGridCell(Vec3(bb[i * 4 + 2], 0, bb[i * 4 + 3]), &x1, &z1);
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int x = x0; x <= x1; x++)
+                m_grid_cells[z * m_grid_width + x].push_back(i);
+        }
+    }
+}   // createGrid
+
+//-----------------------------------------------------------------------------
+/** Returns the grid cell a point is in. Points outside of the grid are
+ *  mapped to the closest cell.
+ */
+void Graph::getGridCell(const Vec3& xyz, int *x, int *z) const
+{
+    float fx = (xyz.getX() - m_grid_min_x) / m_grid_cell_size;
+    float fz = (xyz.getZ() - m_grid_min_z) / m_grid_cell_size;
+    // Clamp as float first to avoid overflows when converting to int
+    fx = std::max(0.0f, std::min(fx, (float)(m_grid_width  - 1)));
+    fz = std::max(0.0f, std::min(fz, (float)(m_grid_height - 1)));
+    *x = (int)fx;
+    *z = (int)fz;
+}   // getGridCell
+
+//-----------------------------------------------------------------------------
+/** Same as the linear search in findRoadSector (without all_sectors), but
+ *  only tests the quads in the grid cell of the point. If the point is
+ *  inside more than one quad, the one that the linear search would have
+ *  tested first (starting after the previous sector) is returned.
+ */
+void Graph::findRoadSectorInGrid(const Vec3& xyz, int *sector,
+                                 bool ignore_vertical) const
+{
+    const int n     = getNumNodes();
+    const int first = *sector + 1;
+    *sector = UNKNOWN_SECTOR;
+
+    const float fx = (xyz.getX() - m_grid_min_x) / m_grid_cell_size;
+    const float fz = (xyz.getZ() - m_grid_min_z) / m_grid_cell_size;
+    // No quad can contain a point outside of the grid (this also
+    // handles NAN).
+    if (!(fx >= 0.0f && fx < m_grid_width && fz >= 0.0f &&
+          fz < m_grid_height))
+        return;
+
+    int x, z;
+    getGridCell(xyz, &x, &z);
+    int best_order = n;
+    for (int i : m_grid_cells[z * m_grid_width + x])
+    {
+        const int order = (i - first + n) % n;
+        if (order < best_order && getQuad(i)->pointInside(xyz,
+                                                          ignore_vertical))
+        {
+            best_order = order;
+            *sector    = i;
+        }
+    }
+}   // findRoadSectorInGrid
+
+//-----------------------------------------------------------------------------
+/** Same as the linear search in findOutOfRoadSector (without all_sectors),
+ *  but tests the grid cells in rings around the point, and stops as soon as
+ *  no untested quad can be closer than the closest quad found so far. Ties
+ *  are resolved in the order the linear search would test the quads.
+ */
+int Graph::findOutOfRoadSectorInGrid(const Vec3& xyz, const int curr_sector,
+                                     bool ignore_vertical) const
+{
+    const int n = getNumNodes();
+    // The linear search starts after quad 0, or 10 quads before the
+    // current sector.
+    int first = curr_sector == UNKNOWN_SECTOR ? 1 : curr_sector - 9;
+    first = (first % n + n) % n;
+
+    // Index 0: closest quad fulfilling the height condition, index 1:
+    // closest quad independent of height (only used if there is no quad
+    // with the height condition, same as phase 1 of the linear search).
+    float min_dist_2[2] = { 999999.0f*999999.0f, 999999.0f*999999.0f };
+    int   min_order[2]  = { n, n };
+    int   min_sector[2] = { UNKNOWN_SECTOR, UNKNOWN_SECTOR };
+
+    auto test_cell = [&](int x, int z)
+    {
+        for (int i : m_grid_cells[z * m_grid_width + x])
+        {
+            const Quad* q = getQuad(i);
+            if (q->isIgnored())
+                continue;
+            const float dist_2 = q->getDistance2FromPoint(xyz);
+            const int order = (i - first + n) % n;
+            const float dist = xyz.getY() - q->getMinHeight();
+            const bool height_ok = (dist < 5.0f && dist > -1.0f) ||
+                                   q->is3DQuad() || ignore_vertical;
+            for (int phase = height_ok ? 0 : 1; phase < 2; phase++)
+            {
+                if (dist_2 < min_dist_2[phase] ||
+                    (dist_2 == min_dist_2[phase] && order < min_order[phase]))
+                {
+                    min_dist_2[phase] = dist_2;
+                    min_order[phase]  = order;
+                    min_sector[phase] = i;
+                }
+            }
+        }
+    };   // test_cell
+
+    int cx, cz;
+    getGridCell(xyz, &cx, &cz);
+    for (int r = 0; ; r++)
+    {
+        // Test all cells with a distance of r cells to the center cell
+        for (int z = cz - r; z <= cz + r; z++)
+        {
+            if (z < 0 || z >= m_grid_height)
+                continue;
+            const int step = (r == 0 || z == cz - r || z == cz + r) ? 1
+                                                                    : 2 * r;
+            for (int x = cx - r; x <= cx + r; x += step)
+            {
+                if (x >= 0 && x < m_grid_width)
+                    test_cell(x, z);
+            }
+        }
+        if (cx - r <= 0 && cz - r <= 0 && cx + r >= m_grid_width  - 1 &&
+                                           cz + r >= m_grid_height - 1)
+            break;
+        if (min_sector[0] == UNKNOWN_SECTOR)
+            continue;
+
+        // Any quad not tested yet is outside of the tested cells, so its
+        // distance is at least the distance from the point to the border
+        // of the tested cells (ignoring borders of the grid).
+        float bound = 999999.0f;
+        if (cx - r > 0)
+        {
+            bound = std::min(bound, xyz.getX() - m_grid_min_x
+                                    - (cx - r) * m_grid_cell_size);
+        }
+        if (cx + r < m_grid_width - 1)
+        {
+            bound = std::min(bound, m_grid_min_x
+                         + (cx + r + 1) * m_grid_cell_size - xyz.getX());
+        }
+        if (cz - r > 0)
+        {
+            bound = std::min(bound, xyz.getZ() - m_grid_min_z
+                                    - (cz - r) * m_grid_cell_size);
+        }
+        if (cz + r < m_grid_height - 1)
+        {
+            bound = std::min(bound, m_grid_min_z
+                         + (cz + r + 1) * m_grid_cell_size - xyz.getZ());
+        }
+        // Allow for rounding errors in the distance computation
+        bound -= 0.01f;
+        if (bound > 0.0f && bound * bound > min_dist_2[0])
+            break;
+    }   // for r
+
+    if (min_sector[0] != UNKNOWN_SECTOR)
+        return min_sector[0];
+    if (min_sector[1] != UNKNOWN_SECTOR)
+        return min_sector[1];
+
+    Log::warn("Graph", "unknown sector found.");
+    return 0;
+}   // findOutOfRoadSectorInGrid
+
+// ============================================================================
+/** Unit testing for the grid used in findRoadSector and findOutOfRoadSector:
+ *  for the graphs of all tracks the results are compared with the linear
+ *  search over all quads, using points on, above, below and next to the
+ *  quads, and random points around the track.
+ */
+void Graph::unitTesting()
+{
+    RandomGenerator random;
+    random.seed(1234);
+    int error_count = 0;
+    for (unsigned int t = 0; t < track_manager->getNumberOfTracks(); t++)
+    {
+        const Track* track = track_manager->getTrack(t);
+        Graph* graph = NULL;
+        if (track->isArena() || track->isSoccer())
+        {
+            if (track->hasNavMesh())
+                graph = new ArenaGraph(track->getTrackFile("navmesh.xml"));
+        }
+        else if (file_manager->fileExists(track->getTrackFile("quads.xml")))
+        {
+            // The DriveGraph constructor sets the graph, which is needed
+            // when the drive nodes are created.
+            graph = new DriveGraph(track->getTrackFile("quads.xml"),
+                                   track->getTrackFile("graph.xml"),
+                                   /*reverse*/false);
+        }
+        if (!graph || graph->getNumNodes() == 0)
+        {
+            if (graph == Graph::get())
+                Graph::destroy();
+            else
+                delete graph;
+            continue;
+        }
+
+        std::vector<Vec3> points;
+        const int n = graph->getNumNodes();
+        for (int i = 0; i < n; i++)
+        {
+            const Quad* q = graph->getQuad(i);
+            const Vec3& c = q->getCenter();
+            for (float dy : { 0.5f, 3.0f, -2.0f, 10.0f })
+                points.push_back(c + q->getNormal() * dy);
+            for (int j = 0; j < 4; j++)
+            {
+                points.push_back((*q)[j]);
+                points.push_back(c + ((*q)[j] - c) * 0.99f);
+                points.push_back(c + ((*q)[j] - c) * 1.5f);
+            }
+        }
+        const Vec3 size = graph->m_bb_max - graph->m_bb_min + Vec3(40.0f);
+        for (int i = 0; i < 4 * n; i++)
+        {
+            Vec3 p(random.get(1000) * 0.001f, random.get(1000) * 0.001f,
+                   random.get(1000) * 0.001f);
+            points.push_back(graph->m_bb_min - Vec3(20.0f) + p * size);
+        }
+
+        for (const Vec3& p : points)
+        {
+            for (bool ignore_vertical : { false, true })
+            {
+                // Test with an unknown and a random previous sector
+                for (int prev : { UNKNOWN_SECTOR, random.get(n) })
+                {
+                    int grid_sector = prev, linear_sector = prev;
+                    graph->m_use_grid = true;
+                    graph->findRoadSector(p, &grid_sector, NULL,
+                                          ignore_vertical);
+                    graph->m_use_grid = false;
+                    graph->findRoadSector(p, &linear_sector, NULL,
+                                          ignore_vertical);
+                    if (grid_sector != linear_sector)
+                    {
+                        Log::error("Graph", "%s: findRoadSector %f %f %f "
+                                   "grid %d linear %d",
+                                   track->getIdent().c_str(), p.getX(),
+                                   p.getY(), p.getZ(), grid_sector,
+                                   linear_sector);
+                        error_count++;
+                    }
+
+                    // The linear search needs at least 10 quads for a
+                    // current sector.
+                    if (prev != UNKNOWN_SECTOR && n < 10)
+                        continue;
+                    graph->m_use_grid = true;
+                    grid_sector = graph->findOutOfRoadSector(p, prev, NULL,
+                                                             ignore_vertical);
+                    graph->m_use_grid = false;
+                    linear_sector = graph->findOutOfRoadSector(p, prev, NULL,
+                                                               ignore_vertical);
+                    if (grid_sector != linear_sector)
+                    {
+                        Log::error("Graph", "%s: findOutOfRoadSector "
+                                   "%f %f %f grid %d linear %d",
+                                   track->getIdent().c_str(), p.getX(),
+                                   p.getY(), p.getZ(), grid_sector,
+                                   linear_sector);
+                        error_count++;
+                    }
+                }   // for prev
+            }   // for ignore_vertical
+        }   // for p
+
+        if (graph == Graph::get())
+            Graph::destroy();
+        else
+            delete graph;
+    }   // for t
+    assert(error_count == 0);
+}   // unitTesting
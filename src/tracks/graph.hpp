@@ -66,6 +66,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void createGrid();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -90,6 +92,25 @@ private:
     /** The render target used for drawing the minimap. */
     std::unique_ptr<RenderTarget> m_render_target;
 
+    /** A uniform 2d grid (in x/z) over the bounding boxes of all quads, used
+     *  to avoid testing every quad in findRoadSector and findOutOfRoadSector.
+     *  Each cell contains the indices of all quads whose bounding box
+     *  overlaps the cell. Empty if no grid was created. */
+    std::vector<std::vector<int> > m_grid_cells;
+
+    /** Minimum x and z coordinate of the grid. */
+    float m_grid_min_x, m_grid_min_z;
+
+    /** Size of a (square) grid cell. */
+    float m_grid_cell_size;
+
+    /** Number of grid cells in x and z direction. */
+    int m_grid_width, m_grid_height;
+
+    /** If the grid should be used. Only disabled in unit testing to compare
+     *  the results with the linear search. */
+    bool m_use_grid;
+
     // ------------------------------------------------------------------------
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
@@ -106,6 +127,14 @@ private:
     virtual bool hasLapLine() const = 0;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const = 0;
+    // ------------------------------------------------------------------------
+    void getGridCell(const Vec3& xyz, int *x, int *z) const;
+    // ------------------------------------------------------------------------
+    void findRoadSectorInGrid(const Vec3& xyz, int *sector,
+                              bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int findOutOfRoadSectorInGrid(const Vec3& xyz, const int curr_sector,
+                                  bool ignore_vertical) const;
 
 public:
     static const int UNKNOWN_SECTOR;
@@ -113,6 +142,8 @@ public:
     static const float MIN_HEIGHT_TESTING;
     static const float MAX_HEIGHT_TESTING;
     // ------------------------------------------------------------------------
+    static void unitTesting();
+    // ------------------------------------------------------------------------
     /** Returns the one instance of this object. It is possible that there
      *  is no instance created (e.g. arena without navmesh) so we don't assert
      *  that an instance exist. */
@@ -33,6 +33,7 @@ TerrainInfo::TerrainInfo()
 {
     m_last_material = NULL;
     m_material      = NULL;
+    m_prepared      = false;
 }   // TerrainInfo
 
 //-----------------------------------------------------------------------------
@@ -44,6 +45,7 @@ TerrainInfo::TerrainInfo(const Vec3 &pos)
     // initialise HoT
     m_last_material = NULL;
     m_material = NULL;
+    m_prepared = false;
     update(pos);
 }   // TerrainInfo
 
@@ -67,30 +69,74 @@ void TerrainInfo::update(const Vec3 &from)
 }   // update
 
 //-----------------------------------------------------------------------------
-/** Update the terrain information based on the latest position.
- *  \param tran The transform ov the kart
+/** Casts a ray downwards (relative to the given rotation) against the track
+ *  and all driveable track objects. If nothing is hit, hit_point is not
+ *  changed.
+ *  \param rotation The rotation of the object.
  *  \param from World coordinates from which to start the raycast.
+ *  \return True if the track or a track object was hit.
  */
-void TerrainInfo::update(const btMatrix3x3 &rotation, const Vec3 &from)
+bool TerrainInfo::castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                          Vec3 *hit_point, Vec3 *normal,
+                          const Material **material) const
 {
-    m_last_material = m_material;
-    // Save the origin for debug drawing
-    m_origin_ray    = from;
-
     // Compute the 'to' vector by rotating a long 'down' vectory by the
     // kart rotation, and adding the start point to it.
     btVector3 to(0, -10000.0f, 0);
     to = from + rotation*to;
 
     const TriangleMesh &tm = Track::getCurrentTrack()->getTriangleMesh();
-    tm.castRay(from, to, &m_hit_point, &m_material, &m_normal,
-               /*interpolate*/true);
+    bool hit = tm.castRay(from, to, hit_point, material, normal,
+                          /*interpolate*/true);
     // Now also raycast against all track objects (that are driveable). If
     // there should be a closer result (than the one against the main track 
     // mesh), its data will be returned.
-    Track::getCurrentTrack()->getTrackObjectManager()
-                            ->castRay(from, to, &m_hit_point, &m_material,
-                                      &m_normal, /*interpolate*/true);
+    hit |= Track::getCurrentTrack()->getTrackObjectManager()
+                                   ->castRay(from, to, hit_point, material,
+                                             normal, /*interpolate*/true);
+    return hit;
+}   // castRay
+
+//-----------------------------------------------------------------------------
+/** Does the raycast of update() in advance. It only reads the track, so it
+ *  can be called for many objects in parallel. The result is used by the
+ *  next call to update() if it uses exactly the same rotation and start
+ *  point, otherwise update() does the raycast again.
+ *  \param rotation The expected rotation of the object.
+ *  \param from Expected world coordinates of the start of the raycast.
+ */
+void TerrainInfo::prepareUpdate(const btMatrix3x3 &rotation, const Vec3 &from)
+{
+    m_prepared_rotation = rotation;
+    m_prepared_from     = from;
+    m_prepared_normal   = m_normal;
+    m_prepared_hit = castRay(rotation, from, &m_prepared_hit_point,
+                             &m_prepared_normal, &m_prepared_material);
+    m_prepared = true;
+}   // prepareUpdate
+
+//-----------------------------------------------------------------------------
+/** Update the terrain information based on the latest position.
+ *  \param tran The transform ov the kart
+ *  \param from World coordinates from which to start the raycast.
+ */
+void TerrainInfo::update(const btMatrix3x3 &rotation, const Vec3 &from)
+{
+    m_last_material = m_material;
+    // Save the origin for debug drawing
+    m_origin_ray    = from;
+
+    if (m_prepared && from == m_prepared_from &&
+        rotation == m_prepared_rotation)
+    {
+        m_material = m_prepared_material;
+        m_normal   = m_prepared_normal;
+        if (m_prepared_hit)
+            m_hit_point = m_prepared_hit_point;
+    }
+    else
+        castRay(rotation, from, &m_hit_point, &m_normal, &m_material);
+    m_prepared = false;
 }   // update
 //-----------------------------------------------------------------------------
 /** Update the terrain information based on the latest position.
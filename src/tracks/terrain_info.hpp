@@ -43,6 +43,22 @@ private:
     /** DEBUG only: origin of raycast. */
     Vec3 m_origin_ray;
 
+    /** True if prepareUpdate() was called since the last update. */
+    bool              m_prepared;
+    /** True if the raycast done by prepareUpdate() has hit something. */
+    bool              m_prepared_hit;
+    /** Rotation and start point of the raycast done by prepareUpdate(). */
+    btMatrix3x3       m_prepared_rotation;
+    Vec3              m_prepared_from;
+    /** Results of the raycast done by prepareUpdate(). */
+    Vec3              m_prepared_normal;
+    Vec3              m_prepared_hit_point;
+    const Material   *m_prepared_material;
+
+    bool castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                 Vec3 *hit_point, Vec3 *normal,
+                 const Material **material) const;
+
 public:
              TerrainInfo();
              TerrainInfo(const Vec3 &pos);
@@ -50,6 +66,7 @@ public:
 
     bool     getSurfaceInfo(const Vec3 &from, Vec3 *position,
                             const Material **m);
+    void         prepareUpdate(const btMatrix3x3 &rotation, const Vec3 &from);
     virtual void update(const btMatrix3x3 &rotation, const Vec3 &from);
     virtual void update(const Vec3 &from);
     virtual void update(const Vec3 &from, const Vec3 &towards);
@@ -79,6 +79,7 @@
 #include "utils/log.hpp"
 #include "utils/mini_glm.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/translation.hpp"
 
 #include <IBillboardTextSceneNode.h>
@@ -102,7 +103,12 @@ bool        Track::m_dont_load_navmesh = false;
 Track      *Track::m_current_track = NULL;
 
 // ----------------------------------------------------------------------------
-Track::Track(const std::string &filename)
+/** Creates a track and loads its track.xml file.
+ *  \param filename Name of the track.xml file.
+ *  \param root The already read content of the track.xml file, or NULL if
+ *         the file should be read here. The track takes ownership of it.
+ */
+Track::Track(const std::string &filename, XMLNode *root)
 {
 #ifdef DEBUG
     m_magic_number          = 0x17AC3802;
@@ -176,7 +182,7 @@ Track::Track(const std::string &filename)
     m_all_nodes.clear();
     m_static_physics_only_nodes.clear();
     m_all_cached_meshes.clear();
-    loadTrackInfo();
+    loadTrackInfo(root);
 }   // Track
 
 //-----------------------------------------------------------------------------
@@ -511,7 +517,11 @@ void Track::cleanup()
 }   // cleanup
 
 //-----------------------------------------------------------------------------
-void Track::loadTrackInfo()
+/** Reads the information about the track from its track.xml file.
+ *  \param root The content of the track.xml file, or NULL if the file
+ *         should be read here. It is deleted in this function.
+ */
+void Track::loadTrackInfo(XMLNode *root)
 {
     // Default values
     m_use_fog               = false;
@@ -523,6 +533,7 @@ void Track::loadTrackInfo()
     m_gravity               = 9.80665f;
     m_friction              = stk_config->m_default_track_friction;
     m_smooth_normals        = false;
+    m_broadphase            = stk_config->m_broadphase;
     m_godrays               = false;
     m_godrays_opacity       = 1.0f;
     m_godrays_color         = video::SColor(255, 255, 255, 255);
@@ -535,7 +546,8 @@ void Track::loadTrackInfo()
     irr_driver->setSSAORadius(1.);
     irr_driver->setSSAOK(1.5);
     irr_driver->setSSAOSigma(1.);
-    XMLNode *root           = file_manager->createXMLTree(m_filename);
+    if (!root)
+        root = file_manager->createXMLTree(m_filename);
 
     if(!root || root->getName()!="track")
     {
@@ -585,6 +597,7 @@ void Track::loadTrackInfo()
         m_enable_auto_rescue = false;
     root->get("auto-rescue",           &m_enable_auto_rescue);
     root->get("smooth-normals",        &m_smooth_normals);
+    root->get("broadphase",            &m_broadphase);
     // Reverse is meaningless in arena
     if(m_is_arena || m_is_soccer)
         m_reverse_available = false;
@@ -911,9 +924,18 @@ void Track::createPhysicsModel(unsigned int main_track_count)
         uploadNodeVertexBuffer(m_all_nodes[i]);
     }
     main_loop->renderGUI(5580);
-    m_track_mesh->createPhysicalBody(m_friction);
+    // Building the BVH of large tracks takes a long time, so it is cached
+    const double start = StkTime::getRealTime();
+    m_track_mesh->createPhysicalBody(m_friction,
+                                     (btCollisionObject::CollisionFlags)0,
+                                     /*use_bvh_cache*/true);
     main_loop->renderGUI(5585);
-    m_gfx_effect_mesh->createCollisionShape();
+    m_gfx_effect_mesh->createCollisionShape(/*create_collision_object*/true,
+                                            /*use_bvh_cache*/true);
+    Log::info("Track", "Collision shapes of '%s' %s in %f seconds.",
+              m_ident.c_str(), m_track_mesh->isBvhFromCache()
+                               ? "loaded from cache" : "built",
+              StkTime::getRealTime() - start);
     main_loop->renderGUI(5590);
 
 }   // createPhysicsModel
@@ -1782,6 +1804,8 @@ static void recursiveUpdatePhysics(std::vector<TrackObject*>& tos)
 void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 {
     assert(!m_current_track);
+    const double load_start = StkTime::getRealTime();
+    const uint64_t load_probes = file_manager->getFileSystemProbes();
 
     // Use m_filename to also get the path, not only the identifier
     STKTexManager::getInstance()
@@ -2263,6 +2287,10 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         easter_world->readData(dir+"/easter_eggs.xml");
     }
     main_loop->renderGUI(6100);
+    Log::info("Track", "Loaded track '%s' in %f seconds (%d file system "
+              "probes).", m_ident.c_str(),
+              StkTime::getRealTime() - load_start,
+              (int)(file_manager->getFileSystemProbes() - load_probes));
 
     STKTexManager::getInstance()->unsetTextureErrorMessage();
 #ifndef SERVER_ONLY
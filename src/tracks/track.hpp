@@ -337,6 +337,9 @@ private:
     /** True if this track supports using smoothed normals. */
     bool                m_smooth_normals;
 
+    /** The physics broadphase to use, see Physics::createBroadphase(). */
+    std::string         m_broadphase;
+
     bool                m_is_addon;
 
     float               m_fog_max;
@@ -394,7 +397,7 @@ private:
     /** The number of laps that is predefined in a track info dialog. */
     int m_actual_number_of_laps;
 
-    void loadTrackInfo();
+    void loadTrackInfo(XMLNode *root);
     void loadDriveGraph(unsigned int mode_id, const bool reverse);
     void loadArenaGraph(const XMLNode &node);
     btQuaternion getArenaStartRotation(const Vec3& xyz, float heading);
@@ -424,7 +427,8 @@ public:
 
     static const float NOHIT;
 
-                       Track             (const std::string &filename);
+                       Track             (const std::string &filename,
+                                          XMLNode *root = NULL);
                       ~Track             ();
     void               cleanup           ();
     void               removeCachedData  ();
@@ -640,6 +644,9 @@ public:
     /** Returns true if the normals of this track can be smoothed. */
     bool smoothNormals() const { return m_smooth_normals; }
     // ------------------------------------------------------------------------
+    /** Returns the name of the physics broadphase to use on this track. */
+    const std::string& getBroadphase() const { return m_broadphase; }
+    // ------------------------------------------------------------------------
     /** Returns the track object manager. */
     TrackObjectManager* getTrackObjectManager() const
     {
@@ -156,13 +156,20 @@ void TrackManager::loadTrackList()
         delete track;
     m_tracks.clear();
 
+    // First find all directories that contain a track, so that the
+    // track.xml files can be read in parallel.
+    std::vector<std::string> track_dirs;
     for(unsigned int i=0; i<m_track_search_path.size(); i++)
     {
         const std::string &dir = m_track_search_path[i];
 
         // First test if the directory itself contains a track:
         // ----------------------------------------------------
-        if(loadTrack(dir)) continue;  // track found, no more tests
+        if(file_manager->fileExists(dir+"track.xml"))
+        {
+            track_dirs.push_back(dir);
+            continue;  // track found, no more tests
+        }
 
         // Then see if a subdir of this dir contains tracks
         // ------------------------------------------------
@@ -172,27 +179,40 @@ void TrackManager::loadTrackList()
             subdir != dirs.end(); subdir++)
         {
             if(*subdir=="." || *subdir=="..") continue;
-            loadTrack(dir+*subdir+"/");
+            if(file_manager->fileExists(dir+*subdir+"/track.xml"))
+                track_dirs.push_back(dir+*subdir+"/");
         }   // for dir in dirs
     }   // for i <m_track_search_path.size()
+
+    std::vector<std::string> config_files;
+    for(unsigned int i=0; i<track_dirs.size(); i++)
+        config_files.push_back(track_dirs[i]+"track.xml");
+    std::vector<XMLNode*> roots;
+    file_manager->createXMLTrees(config_files, &roots);
+
+    // Creating the tracks loads textures, so this must be done serially
+    for(unsigned int i=0; i<track_dirs.size(); i++)
+        loadTrack(track_dirs[i], roots[i]);
 }  // loadTrackList
 
 // ----------------------------------------------------------------------------
 /** Tries to load a track from a single directory. Returns true if a track was
  *  successfully loaded.
  *  \param dirname Name of the directory to load the track from.
+ *  \param root The already read content of the track.xml file, or NULL if
+ *         it should be read here. It will be deleted.
  */
-bool TrackManager::loadTrack(const std::string& dirname)
+bool TrackManager::loadTrack(const std::string& dirname, XMLNode *root)
 {
     std::string config_file = dirname+"track.xml";
-    if(!file_manager->fileExists(config_file))
+    if(!root && !file_manager->fileExists(config_file))
         return false;
 
     Track *track;
 
     try
     {
-        track = new Track(config_file);
+        track = new Track(config_file, root);
     }
     catch (std::exception& e)
     {
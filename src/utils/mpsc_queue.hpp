@@ -0,0 +1,174 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MPSC_QUEUE_HPP
+#define HEADER_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/** A lock-free queue which can be filled by any number of threads, but only
+ *  emptied by a single thread. Producers push to the front of a singly
+ *  linked list with compare-and-swap, the consumer takes the whole list at
+ *  once and reverses it, so items are returned in the order they were pushed
+ *  by each thread.
+ *  The nodes of the list are taken from a pool which is allocated once in
+ *  the constructor, and the consumer gives them back to the pool. Only if
+ *  more items than the size of the pool are waiting in the queue, a node is
+ *  allocated on the heap.
+ */
+template<typename TYPE>
+class MPSCQueue
+{
+private:
+    /** Index of no node, used for the end of the free list and for nodes
+     *  which are not part of the pool. */
+    static const uint32_t NO_NODE = 0xffffffff;
+
+    struct Node
+    {
+        TYPE  m_data;
+        Node* m_next;
+        /** Index of the next node in the free list. */
+        std::atomic<uint32_t> m_next_free;
+        /** Index of this node in m_pool, or NO_NODE if it was allocated
+         *  on the heap. */
+        uint32_t m_index;
+    };
+
+    /** The most recently pushed item. */
+    std::atomic<Node*> m_head;
+
+    /** The preallocated nodes. */
+    std::vector<Node> m_pool;
+
+    /** Head of the list of unused nodes in m_pool: the lower 32 bits are the
+     *  index of the first node, the upper 32 bits are increased by each
+     *  change, so that a thread taking a node can not be confused by the
+     *  same node being taken and given back in between (ABA problem). */
+    std::atomic<uint64_t> m_free;
+
+    // ------------------------------------------------------------------------
+    /** Takes a node from the pool, or allocates a new one if the pool is
+     *  empty. Can be called from any thread. */
+    Node* allocateNode()
+    {
+        uint64_t head = m_free.load(std::memory_order_acquire);
+        while ((uint32_t)head != NO_NODE)
+        {
+            Node* node = &m_pool[(uint32_t)head];
+            const uint64_t next = (((head >> 32) + 1) << 32) |
+                node->m_next_free.load(std::memory_order_relaxed);
+            if (m_free.compare_exchange_weak(head, next,
+                std::memory_order_acquire, std::memory_order_acquire))
+                return node;
+        }
+        Node* node = new Node();
+        node->m_index = NO_NODE;
+        return node;
+    }   // allocateNode
+    // ------------------------------------------------------------------------
+    /** Gives a node back to the pool (or deletes it if it was not taken from
+     *  the pool). */
+    void freeNode(Node* node)
+    {
+        if (node->m_index == NO_NODE)
+        {
+            delete node;
+            return;
+        }
+        uint64_t head = m_free.load(std::memory_order_relaxed);
+        uint64_t next;
+        do
+        {
+            node->m_next_free.store((uint32_t)head,
+                                    std::memory_order_relaxed);
+            next = (((head >> 32) + 1) << 32) | node->m_index;
+        } while (!m_free.compare_exchange_weak(head, next,
+                 std::memory_order_release, std::memory_order_relaxed));
+    }   // freeNode
+
+public:
+    // ------------------------------------------------------------------------
+    /** Constructor.
+     *  \param pool_size Number of nodes to preallocate, i.e. the number of
+     *         items which can wait in the queue without memory allocations.
+     */
+    MPSCQueue(unsigned int pool_size = 1024)
+        : m_head(NULL), m_pool(pool_size)
+    {
+        for (unsigned int i = 0; i < pool_size; i++)
+        {
+            m_pool[i].m_index = i;
+            m_pool[i].m_next_free.store(i + 1 < pool_size ? i + 1 : NO_NODE);
+        }
+        m_free.store(pool_size > 0 ? 0 : NO_NODE);
+    }   // MPSCQueue
+    // ------------------------------------------------------------------------
+    ~MPSCQueue()
+    {
+        Node* node = m_head.load();
+        while (node)
+        {
+            Node* next = node->m_next;
+            if (node->m_index == NO_NODE)
+                delete node;
+            node = next;
+        }
+    }   // ~MPSCQueue
+    // ------------------------------------------------------------------------
+    /** Adds an item constructed from the arguments, can be called from any
+     *  thread. */
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        Node* node = allocateNode();
+        node->m_data = TYPE(std::forward<Args>(args)...);
+        node->m_next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(node->m_next, node,
+            std::memory_order_release, std::memory_order_relaxed));
+    }   // emplace
+    // ------------------------------------------------------------------------
+    /** Moves all items in the queue to the end of out, oldest first. Must
+     *  only be called from the consumer thread. */
+    void popAll(std::vector<TYPE>* out)
+    {
+        Node* node = m_head.exchange(NULL, std::memory_order_acquire);
+        Node* reversed = NULL;
+        while (node)
+        {
+            Node* next = node->m_next;
+            node->m_next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed)
+        {
+            Node* next = reversed->m_next;
+            out->push_back(std::move(reversed->m_data));
+            freeNode(reversed);
+            reversed = next;
+        }
+    }   // popAll
+
+};   // class MPSCQueue
+
+#endif
@@ -0,0 +1,138 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/thread_pool.hpp"
+
+#include "utils/vs.hpp"
+
+// ----------------------------------------------------------------------------
+/** Starts the worker threads.
+ *  \param num_threads Number of worker threads, if 0 parallelFor runs all
+ *         iterations in the calling thread.
+ *  \param name Name of the worker threads.
+ */
+ThreadPool::ThreadPool(unsigned num_threads, const std::string& name)
+          : m_name(name)
+{
+    m_function = NULL;
+    m_count = 0;
+    m_next_index.store(0);
+    m_active_threads = 0;
+    m_job_id = 0;
+    m_exit = false;
+    for (unsigned i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&ThreadPool::workerLoop, this);
+}   // ThreadPool
+
+// ----------------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_exit = true;
+    lock.unlock();
+    m_work_available.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}   // ~ThreadPool
+
+// ----------------------------------------------------------------------------
+/** Returns a sensible number of worker threads for this computer, which is
+ *  one less than the number of cores (as the calling thread works too).
+ */
+unsigned ThreadPool::getDefaultThreadCount()
+{
+    const unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}   // getDefaultThreadCount
+
+// ----------------------------------------------------------------------------
+/** Returns a pool with the default number of threads, which is shared by
+ *  all jobs that are only run occasionally (e.g. while loading), so that
+ *  they do not start new threads each time. The pool is created on first
+ *  use. Jobs of different threads are run one after the other.
+ */
+ThreadPool* ThreadPool::getShared()
+{
+    static ThreadPool shared(getDefaultThreadCount(), "SharedPool");
+    return &shared;
+}   // getShared
+
+// ----------------------------------------------------------------------------
+/** Calls function(i) for all i from 0 to count-1 using all threads, and
+ *  returns once all calls are finished. The order of the calls is not
+ *  defined, and the function must not throw an exception.
+ */
+void ThreadPool::parallelFor(unsigned count,
+                             const std::function<void(unsigned)>& function)
+{
+    if (m_threads.empty() || count < 2)
+    {
+        for (unsigned i = 0; i < count; i++)
+            function(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(m_run_mutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_function = &function;
+    m_count = count;
+    m_next_index.store(0);
+    m_active_threads = (unsigned)m_threads.size();
+    m_job_id++;
+    lock.unlock();
+    m_work_available.notify_all();
+
+    runIterations();
+
+    lock.lock();
+    m_work_done.wait(lock, [this]() { return m_active_threads == 0; });
+    m_function = NULL;
+}   // parallelFor
+
+// ----------------------------------------------------------------------------
+/** Runs iterations of the current job until all are taken. */
+void ThreadPool::runIterations()
+{
+    unsigned i = m_next_index.fetch_add(1);
+    while (i < m_count)
+    {
+        (*m_function)(i);
+        i = m_next_index.fetch_add(1);
+    }
+}   // runIterations
+
+// ----------------------------------------------------------------------------
+void ThreadPool::workerLoop()
+{
+    VS::setThreadName(m_name.c_str());
+    uint64_t last_job_id = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_work_available.wait(lock, [this, last_job_id]()
+            { return m_exit || m_job_id != last_job_id; });
+        if (m_exit)
+            return;
+        last_job_id = m_job_id;
+        lock.unlock();
+        runIterations();
+        lock.lock();
+        if (--m_active_threads == 0)
+            m_work_done.notify_one();
+    }
+}   // workerLoop
@@ -0,0 +1,91 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_THREAD_POOL_HPP
+#define HEADER_THREAD_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** A fixed number of worker threads which run the iterations of a loop in
+ *  parallel. The thread calling parallelFor takes part in the work and
+ *  waits until all iterations are done, so it can be used like a normal
+ *  loop.
+ */
+class ThreadPool : public NoCopy
+{
+private:
+    std::vector<std::thread> m_threads;
+
+    /** Name of the worker threads (for debugging). */
+    std::string m_name;
+
+    /** Protects the job data below, and is used for the condition
+     *  variables. */
+    std::mutex m_mutex;
+
+    /** Only one parallelFor can be run at the same time. */
+    std::mutex m_run_mutex;
+
+    std::condition_variable m_work_available;
+    std::condition_variable m_work_done;
+
+    /** The function to run for each index of the current job. */
+    const std::function<void(unsigned)>* m_function;
+
+    /** Number of iterations of the current job. */
+    unsigned m_count;
+
+    /** The next iteration to be run by any thread. */
+    std::atomic<unsigned> m_next_index;
+
+    /** Number of worker threads which have not finished the current job. */
+    unsigned m_active_threads;
+
+    /** Increased for each job, so workers know when a new one is
+     *  available. */
+    uint64_t m_job_id;
+
+    bool m_exit;
+
+    void workerLoop();
+    void runIterations();
+
+public:
+     ThreadPool(unsigned num_threads, const std::string& name);
+    ~ThreadPool();
+    void parallelFor(unsigned count,
+                     const std::function<void(unsigned)>& function);
+    static unsigned getDefaultThreadCount();
+    static ThreadPool* getShared();
+    // ------------------------------------------------------------------------
+    /** Returns the number of worker threads (not including the calling
+     *  thread). */
+    unsigned getNumThreads() const { return (unsigned)m_threads.size(); }
+
+};   // class ThreadPool
+
+#endif
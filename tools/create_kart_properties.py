@@ -30,7 +30,7 @@ import sys
 characteristics = """Suspension: stiffness, rest, travel, expSpringResponse(bool), maxForce
 Stability: rollInfluence, chassisLinearDamping, chassisAngularDamping, downwardImpulseFactor, trackConnectionAccel, angularFactor(std::vector<float>/floatVector), smoothFlyingImpulse
 Turn: radius(InterpolationArray), timeResetSteer, timeFullSteer(InterpolationArray)
-Engine: power, maxSpeed, brakeFactor, brakeTimeIncrease, maxSpeedReverseRatio
+Engine: power, maxSpeed, genericMaxSpeed, brakeFactor, brakeTimeIncrease, maxSpeedReverseRatio
 Gear: switchRatio(std::vector<float>/floatVector), powerIncrease(std::vector<float>/floatVector)
 Mass
 Wheels: dampingRelaxation, dampingCompression
@@ -47,7 +47,7 @@ Plunger: bandMaxLength, bandForce, bandDuration, bandSpeedIncrease, bandFadeOutT
 Startup: time(std::vector<float>/floatVector), boost(std::vector<float>/floatVector)
 Rescue: duration, vertOffset, height
 Explosion: duration, radius, invulnerabilityTime
-Nitro: duration, engineForce, consumption, smallContainer, bigContainer, maxSpeedIncrease, fadeOutTime, max
+Nitro: duration, engineForce, engineMult, consumption, smallContainer, bigContainer, maxSpeedIncrease, fadeOutTime, max
 Slipstream: durationFactor, baseSpeed, length, width, innerFactor, minCollectTime, maxCollectTime, addPower, minSpeed, maxSpeedIncrease, fadeOutTime
 Skid: increase, decrease, max, timeTillMax, visual, visualTime, revertVisualTime, minSpeed, timeTillBonus(std::vector<float>/floatVector), bonusSpeed(std::vector<float>/floatVector), bonusTime(std::vector<float>/floatVector), bonusForce(std::vector<float>/floatVector), physicalJumpTime, graphicalJumpTime, postSkidRotateFactor, reduceTurnMin, reduceTurnMax, enabled(bool)"""
 
@@ -182,13 +182,21 @@ def createAcGetter(groups):
 }}  // get{1}
 """.format(m.typeC, nameTitle, nameUnderscore.upper(), typeC, result))
 
+""" Returns the type that is used to return a cached value. Values that
+    are not simple types are returned as const reference, so that they are
+    not copied. """
+def getReturnType(member):
+    if member.typeC == "float" or member.typeC == "bool":
+        return member.typeC
+    return "const {0}&".format(member.typeC)
+
 def createKpDefs(groups):
     for g in groups:
         print()
         for m in g.members:
             nameTitle = joinSubName(g, m, True)
             nameUnderscore = joinSubName(g, m, False)
-            typeC = m.typeC
+            typeC = getReturnType(m)
 
             print("    {0} get{1}() const;".
                 format(typeC, nameTitle, nameUnderscore))
@@ -198,15 +206,29 @@ def createKpGetter(groups):
         for m in g.members:
             nameTitle = joinSubName(g, m, True)
             nameUnderscore = joinSubName(g, m, False)
-            typeC = m.typeC
+            typeC = getReturnType(m)
             result = "result"
 
             print("""// ----------------------------------------------------------------------------
 {1} KartProperties::get{0}() const
 {{
-    return m_cached_characteristic->get{0}();
+    return m_cached_characteristic->getValues().m_{2};
 }}  // get{0}
-""".format(nameTitle, typeC))
+""".format(nameTitle, typeC, nameUnderscore))
+
+def createCcValues(groups):
+    for g in groups:
+        print()
+        for m in g.members:
+            nameUnderscore = joinSubName(g, m, False)
+            print("        {0} m_{1};".format(m.typeC, nameUnderscore))
+
+def createCcGetValue(groups):
+    for g in groups:
+        for m in g.members:
+            nameUnderscore = joinSubName(g, m, False)
+            print("    case {0}:\n        return &values->m_{1};".
+                format(nameUnderscore.upper(), nameUnderscore))
 
 def createGetType(groups):
     for g in groups:
@@ -246,6 +268,8 @@ functions = {
     "getName":  (createGetName,  "Implement the getName function",                         "karts/abstract_characteristic.cpp"),
     "kpdefs":   (createKpDefs,   "Create the header function definitions for the getters", "karts/kart_properties.hpp"),
     "kpgetter": (createKpGetter, "Implement the getters",                                  "karts/kart_properties.cpp"),
+    "ccvalues": (createCcValues, "List the members of the cached values",                  "karts/cached_characteristic.hpp"),
+    "ccgetvalue": (createCcGetValue, "Implement the getValue function",                    "karts/cached_characteristic.cpp"),
     "loadXml":  (createLoadXml,  "Code to load the characteristics from an xml file",      "karts/xml_characteristic.cpp"),
 }
 
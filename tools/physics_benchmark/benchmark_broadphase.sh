@@ -0,0 +1,16 @@
+#!/bin/bash
+# Compares the cost of Physics::update with the different bullet broadphases
+# on all tracks. Each race is a headless profile race with AI karts only,
+# using a fixed random seed so that all broadphases run the same race.
+# Usage: benchmark_broadphase.sh path-to-supertuxkart [laps]
+
+laps=${2:-3}
+for track in abyss candela_city cocoa_temple cornfield_crossing fortmagma gran_paradiso_island greenvalley hacienda lighthouse mansion mines minigolf olivermath sandtrack scotland snowmountain snowtuxpeak stk_enterprise volcano_island xr591 zengarden; do
+    for broadphase in axis-sweep axis-sweep-32 dbvt; do
+        result=$($1 --log=0 -R --seed=1 --numkarts=12 \
+                    --track=$track --difficulty=2 --mode=0 \
+                    --broadphase=$broadphase --profile-laps=$laps \
+                    --no-graphics 2>&1 | grep "Physics broadphase")
+        echo "$track ${result#*profile: }"
+    done
+done